@@ -36,6 +36,10 @@ local settings = {
     FILES_TO_EXCLUDE = {},
 
     EXTERNAL_FILES = {},
+
+    -- archive name (in the export folder) -> {clip name -> path}, played with lovevlc.openArchive
+    -- e.g. ["videos.lvpk"] = {["intro.mp4"] = "../../videos/intro.mp4"}
+    VIDEO_ARCHIVES = {},
     LOVE_PATH = {
         WINDOWS = "D:/user/apps/love_2d",
         LINUX = "love.AppImage"
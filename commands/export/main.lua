@@ -254,4 +254,18 @@ else
     -- os.execute("cp -r ../../libs/linux/libdiscord-rpc.so" .. " " .. EXPORT_DIR .. "/libdiscord-rpc.so")
 end
 
+-- pack videos into archives next to the executable, lovevlc.openArchive plays straight out of them
+local VIDEO_ARCHIVES = EXPORT_SETTINGS.VIDEO_ARCHIVES or {}
+if next(VIDEO_ARCHIVES) then
+    print("Packing video archives...\n----------------------------------")
+    local packtools = require("tools.packtools")
+    for save, entries in pairs(VIDEO_ARCHIVES) do
+        local success, err = packtools.pack(EXPORT_DIR .. "/" .. save, entries)
+        if not success then
+            print("An error occured while packing " .. save .. ": " .. err .. "\n----------------------------------")
+            os.exit(1)
+        end
+    end
+end
+
 print("Done! Check out " .. EXPORT_DIR .. "/" .. EXECUTABLE_NAME .. "\n----------------------------------")
\ No newline at end of file
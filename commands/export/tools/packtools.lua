@@ -0,0 +1,114 @@
+--- @class lovevlc.tools.packtools
+local packtools = {}
+
+-- has to match the reader in lib/wrapper/libvlc_wrapper.cpp
+local ARCHIVE_VERSION = 1
+local HEADER_SIZE = 16
+local ALIGNMENT = 4096
+local COPY_CHUNK = 4 * 1024 * 1024
+
+-- file extension -> vlc demux module, stored as the codec hint so vlc can skip probing
+local DEMUXERS = {
+    mp4 = "mp4", m4v = "mp4", mov = "mp4",
+    mkv = "mkv", webm = "mkv",
+    ogg = "ogg", ogv = "ogg",
+    avi = "avi",
+    ts = "ts", m2ts = "ts",
+    -- vlc 3 has no flv demux of its own, it goes thru libavformat
+    flv = "avformat",
+    mpg = "ps", mpeg = "ps",
+}
+
+local function le(value, bytes)
+    local out = {}
+    for i = 1, bytes do
+        local byte = value % 256
+        out[i] = string.char(byte)
+        value = (value - byte) / 256
+    end
+    return table.concat(out)
+end
+
+local function padding(offset)
+    return (ALIGNMENT - offset % ALIGNMENT) % ALIGNMENT
+end
+
+---
+--- Packs a bunch of video files into one `.lvpk` archive that `lovevlc.openArchive` can play from.
+---
+--- @param  output   string  Where to write the archive.
+--- @param  entries  table   `name -> path`, or `name -> {path = ..., codec = ...}` to override the codec hint.
+---
+--- @return boolean success, string? error
+---
+function packtools.pack(output, entries)
+    local items = {}
+    for name, entry in pairs(entries) do
+        if type(entry) == "string" then
+            entry = {path = entry}
+        end
+        local file = io.open(entry.path, "rb")
+        if not file then
+            return false, "Couldn't open " .. entry.path
+        end
+        local size = file:seek("end")
+        file:close()
+
+        local codec = entry.codec
+        if codec == nil then
+            local ext = entry.path:match("%.([^%./\\]+)$")
+            codec = ext and DEMUXERS[ext:lower()] or ""
+        end
+        items[#items + 1] = {name = name, path = entry.path, codec = codec, size = size}
+    end
+    table.sort(items, function(a, b) return a.name < b.name end)
+
+    -- the index size doesn't depend on the offsets, so lay everything out first
+    local indexSize = 0
+    for _, item in ipairs(items) do
+        indexSize = indexSize + 2 + #item.name + 2 + #item.codec + 16
+    end
+    local offset = HEADER_SIZE + indexSize
+    for _, item in ipairs(items) do
+        offset = offset + padding(offset)
+        item.offset = offset
+        offset = offset + item.size
+    end
+
+    local index = {"LVPK", le(ARCHIVE_VERSION, 4), le(#items, 4), le(indexSize, 4)}
+    for _, item in ipairs(items) do
+        index[#index + 1] = le(#item.name, 2) .. item.name .. le(#item.codec, 2) .. item.codec
+        index[#index + 1] = le(item.offset, 8) .. le(item.size, 8)
+    end
+
+    local out = io.open(output, "wb")
+    if not out then
+        return false, "Couldn't write " .. output
+    end
+    out:write(table.concat(index))
+
+    local written = HEADER_SIZE + indexSize
+    for _, item in ipairs(items) do
+        out:write(string.rep("\0", item.offset - written))
+        local file = io.open(item.path, "rb")
+        if not file then
+            -- it was there when the sizes got read, don't leave half an archive behind
+            out:close()
+            os.remove(output)
+            return false, "Couldn't open " .. item.path
+        end
+        while true do
+            local chunk = file:read(COPY_CHUNK)
+            if not chunk then
+                break
+            end
+            out:write(chunk)
+        end
+        file:close()
+        written = item.offset + item.size
+    end
+    out:close()
+    return true
+end
+
+return packtools
@@ -70,6 +70,10 @@ if os == "Windows" or os == "OSX" then
     osm.setenv("VLC_PLUGIN_PATH", os == "Windows" and pp:gsub("/", "\\") or pp)
 end
 
+-- used to report how long loading the libraries took, see `handle.create`
+local clock = love and love.timer and love.timer.getTime or osm.clock
+local loadStart = clock()
+
 local extension = os == "Windows" and "dll" or os == "Linux" and "so" or os == "OSX" and "dylib"
 package.cpath = string.format("%s;%s/?.%s", package.cpath, libdir, extension)
 
@@ -83,6 +87,8 @@ _G.libvlcWrapper = ffi.load(assert(package.searchpath("libvlc_wrapper", package.
 -- similarly to libvlccore, variable not used, but needed to load openal
 _G.libopenal = os == "Windows" and ffi.load(assert(package.searchpath("OpenAL32", package.cpath))) or ffi.C
 
+local librariesEnd = clock()
+
 require((parent and (parent .. ".") or "") .. "libvlc_h")
 require((parent and (parent .. ".") or "") .. "al_h")
 require((parent and (parent .. ".") or "") .. "alc_h")
@@ -91,42 +97,1685 @@ ffi.cdef [[\
     void free(void* a);
     void* malloc(size_t size);
 
+    // only the fields lua touches, the rest of it is private to the wrapper
     typedef struct {
         unsigned char* pixelBuffer;
         unsigned int width;
         unsigned int height;
+        unsigned int pitch;
+        float volume;
+        float presentedArea;
+        unsigned int presentCount;
+        int wantPlaying;
+        int idleMode;
     } LuaVLC_Video;
 
+    typedef struct {
+        unsigned int frameSequence;
+        int state;
+        double time;
+        double length;
+        unsigned int width;
+        unsigned int height;
+        float buffering;
+        unsigned int droppedFrames;
+        int idle;
+    } LuaVLC_PlayerStatus;
+
     typedef struct LuaVLC_Audio LuaVLC_Audio;
 
-    LuaVLC_Video luavlc_new(void);
+    typedef struct {
+        double newMs;
+        double warmupMs;
+        double totalMs;
+        int success;
+    } LuaVLC_InitTimings;
+
+    typedef struct {
+        int64_t current[7];
+        int64_t peak[7];
+        int64_t total;
+        int64_t totalPeak;
+    } LuaVLC_MemoryStats;
+
+    LuaVLC_Video* luavlc_new_ptr(void);
+    void luavlc_free_ptr(LuaVLC_Video* video);
+    unsigned char* luavlc_new_pixel_buffer(unsigned int width, unsigned int height);
+    void luavlc_free_pixel_buffer(unsigned char* pixelBuffer);
+    void luavlc_video_attach(LuaVLC_Video* video, libvlc_media_player_t *mp, libvlc_media_t *media);
+    void luavlc_players_update(LuaVLC_Video** videos, int count, LuaVLC_PlayerStatus* out);
+    void luavlc_scheduler_configure(double idleSeconds, int idleMode, int maxActive, double keyframeInterval);
+    void luavlc_video_attach_audio(LuaVLC_Video* video, LuaVLC_Audio* audio);
+    void luavlc_memory_track(LuaVLC_Video* video, int category, int64_t delta);
+    void luavlc_memory_query(LuaVLC_Video** videos, int count, LuaVLC_MemoryStats* perVideo, LuaVLC_MemoryStats* global);
+
+    typedef struct LuaVLC_Source LuaVLC_Source;
+
+    // function pointers to PHYSFS_openRead, PHYSFS_readBytes, PHYSFS_seek, PHYSFS_fileLength and PHYSFS_close
+    typedef struct {
+        void* openRead;
+        void* readBytes;
+        void* seek;
+        void* fileLength;
+        void* close;
+    } LuaVLC_PhysFS;
+
+    libvlc_media_t* luavlc_media_new_source(LuaVLC_Source* source);
+    void luavlc_video_attach_source(LuaVLC_Video* video, LuaVLC_Source* source);
+    void luavlc_source_free(LuaVLC_Source* source);
+    void luavlc_physfs_bind(const LuaVLC_PhysFS* physfs);
+    LuaVLC_Source* luavlc_source_new_physfs(const char* path);
+    LuaVLC_Source* luavlc_source_new_mmap(const char* path);
+    void luavlc_mmap_set_limit(uint64_t bytes);
+    LuaVLC_Source* luavlc_source_new_memory(const void* data, uint64_t size);
+
+    typedef struct LuaVLC_Archive LuaVLC_Archive;
+    typedef struct {
+        const char* name;
+        const char* codec;
+        uint64_t offset;
+        uint64_t length;
+    } LuaVLC_ArchiveEntry;
+
+    LuaVLC_Archive* luavlc_archive_open(const char* path);
+    void luavlc_archive_close(LuaVLC_Archive* archive);
+    int luavlc_archive_count(LuaVLC_Archive* archive);
+    bool luavlc_archive_entry(LuaVLC_Archive* archive, int index, LuaVLC_ArchiveEntry* out);
+    bool luavlc_archive_find(LuaVLC_Archive* archive, const char* name, LuaVLC_ArchiveEntry* out);
+    LuaVLC_Source* luavlc_source_new_archive(LuaVLC_Archive* archive, const char* name);
+
+    typedef struct {
+        uint64_t hits;
+        uint64_t stalls;
+        double stallMs;
+        uint64_t fetchedBytes;
+        uint64_t droppedBytes;
+        uint64_t seeks;
+        uint64_t bufferedBytes;
+        uint64_t windowBytes;
+        double throughput;
+    } LuaVLC_PrefetchStats;
+
+    LuaVLC_Source* luavlc_source_new_file(const char* path);
+    LuaVLC_Source* luavlc_source_new_prefetch(LuaVLC_Source* inner, uint64_t windowBytes);
+    bool luavlc_source_is_network(LuaVLC_Source* source);
+    bool luavlc_video_prefetch_stats(LuaVLC_Video* video, LuaVLC_PrefetchStats* out);
+    int luavlc_prefetch_caching_ms(bool network);
+
+    LuaVLC_Source* luavlc_source_new_aes_ctr(LuaVLC_Source* inner, const unsigned char* key, int keyLength, const unsigned char* iv);
+    bool luavlc_aes_hardware(void);
+
+    typedef struct {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t downloadedBytes;
+        uint64_t cachedBytes;
+        int files;
+    } LuaVLC_UrlCacheStats;
+
+    bool luavlc_url_cache_configure(const char* directory, uint64_t maxBytes);
+    bool luavlc_url_cache_enabled(void);
+    void luavlc_url_cache_stats(LuaVLC_UrlCacheStats* out);
+    void luavlc_url_cache_clear(void);
+    LuaVLC_Source* luavlc_source_new_cached_url(const char* url);
+
+    typedef struct {
+        int type;
+        char codec[8];
+        char description[64];
+        char language[16];
+        unsigned int bitrate;
+        unsigned int width;
+        unsigned int height;
+        double fps;
+        unsigned int channels;
+        unsigned int rate;
+    } LuaVLC_ProbeTrack;
+
+    typedef struct {
+        int id;
+        int status;
+        int cached;
+        double duration;
+        unsigned int width;
+        unsigned int height;
+        double fps;
+        int trackCount;
+        LuaVLC_ProbeTrack tracks[16];
+    } LuaVLC_ProbeResult;
+
+    void luavlc_probe_configure(int workers, int timeoutMs, const char* cacheFile);
+    int luavlc_probe_request(const char* path);
+    int luavlc_probe_poll(LuaVLC_ProbeResult* out, int max);
+    int luavlc_probe_pending(void);
+
+    typedef struct {
+        int id;
+        int status;
+        int cached;
+        unsigned int width;
+        unsigned int height;
+        unsigned char* pixels;
+    } LuaVLC_ThumbnailResult;
+
+    void luavlc_thumbnail_configure(int workers, int timeoutMs, const char* cacheDirectory);
+    int luavlc_thumbnail_request(const char* path, double time, double position, unsigned int width, unsigned int height);
+    bool luavlc_thumbnail_poll(LuaVLC_ThumbnailResult* out);
+    void luavlc_thumbnail_free_pixels(unsigned char* pixels);
+
+    typedef struct {
+        unsigned int count[2];
+        double lastMs[2];
+        double totalMs[2];
+        double maxMs[2];
+        unsigned int coalesced;
+        int keyframeIndex;
+        unsigned int keyframes;
+    } LuaVLC_SeekStats;
+
+    void luavlc_keyframes_configure(const char* cacheDirectory);
+    void luavlc_video_index_keyframes(LuaVLC_Video* video, const char* path);
+    int luavlc_video_keyframes(LuaVLC_Video* video, double* out, int max);
+    void luavlc_video_seek(LuaVLC_Video* video, double timeMs, int mode);
+    double luavlc_video_scrub(LuaVLC_Video* video, double timeMs, bool released);
+    void luavlc_video_seek_stats(LuaVLC_Video* video, LuaVLC_SeekStats* out);
+
+    typedef struct {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        uint64_t captured;
+        uint64_t lookahead;
+        unsigned int frames;
+        uint64_t bytes;
+        uint64_t budget;
+        double frameMs;
+    } LuaVLC_FrameCacheStats;
+
+    void luavlc_frame_cache_configure(LuaVLC_Video* video, uint64_t budgetBytes, const char* lookaheadPath, double lookaheadMs);
+    double luavlc_frame_cache_step(LuaVLC_Video* video, int direction);
+    double luavlc_frame_cache_show(LuaVLC_Video* video, double timeMs);
+    void luavlc_frame_cache_resume(LuaVLC_Video* video);
+    bool luavlc_frame_cache_stats(LuaVLC_Video* video, LuaVLC_FrameCacheStats* out);
+
+    typedef struct {
+        int id;
+        int status;
+        unsigned int width;
+        unsigned int height;
+        unsigned int frames;
+        double fps;
+        int format;
+        size_t frameBytes;
+        unsigned char* pixels;
+    } LuaVLC_BakeResult;
+
+    typedef struct {
+        double milliseconds;
+        double megapixelsPerSecond;
+        double psnr;
+        double ratio;
+    } LuaVLC_CompressBenchmark;
+
+    void luavlc_bake_configure(int workers);
+    int luavlc_bake_request(const char* path, unsigned int width, unsigned int height, uint64_t maxBytes, double maxSeconds, int format, int quality);
+    bool luavlc_bake_poll(LuaVLC_BakeResult* out);
+    void luavlc_bake_free_pixels(unsigned char* pixels);
+
+    typedef struct {
+        uint64_t frames;
+        uint64_t identical;
+        uint64_t dirtyRows;
+        uint64_t totalRows;
+    } LuaVLC_DirtyStats;
+
+    void luavlc_dirty_configure(LuaVLC_Video* video, bool enabled);
+    int luavlc_dirty_take(LuaVLC_Video* video, unsigned int* ranges, int max);
+    bool luavlc_dirty_stats(LuaVLC_Video* video, LuaVLC_DirtyStats* out);
+
+    typedef struct LuaVLC_PboStream LuaVLC_PboStream;
+    typedef struct {
+        uint64_t copied;
+        uint64_t uploaded;
+        uint64_t dropped;
+        double copyMs;
+        double submitMs;
+    } LuaVLC_PboStats;
+
+    bool luavlc_gl_load(const char** reason);
+    unsigned int luavlc_gl_bound_texture(void);
+    LuaVLC_PboStream* luavlc_pbo_create(LuaVLC_Video* video, unsigned int texture);
+    bool luavlc_pbo_upload(LuaVLC_PboStream* stream);
+    void luavlc_pbo_destroy(LuaVLC_PboStream* stream);
+    bool luavlc_pbo_stats(LuaVLC_PboStream* stream, LuaVLC_PboStats* out);
+
+    typedef struct {
+        uint64_t frames;
+        uint64_t presents;
+        uint64_t blended;
+        uint64_t repeats;
+        uint64_t skipped;
+        uint64_t underruns;
+        uint64_t cuts;
+        double frameMs;
+        double judderMs;
+        double blendWeight;
+    } LuaVLC_FrcStats;
+    typedef struct {
+        int first;
+        int second;
+        float weight;
+        uint64_t firstSerial;
+        uint64_t secondSerial;
+    } LuaVLC_FrcPick;
+
+    void luavlc_frc_configure(LuaVLC_Video* video, unsigned char** slots);
+    bool luavlc_frc_pick(LuaVLC_Video* video, bool blend, LuaVLC_FrcPick* out);
+    bool luavlc_frc_stats(LuaVLC_Video* video, LuaVLC_FrcStats* out);
+
+    typedef struct {
+        unsigned int frameSequence;
+        float combing;
+        int interlaced;
+        int topFieldFirst;
+        float orderConfidence;
+        double frameMs;
+        double sinceFrameMs;
+    } LuaVLC_FieldInfo;
+
+    void luavlc_fields_configure(LuaVLC_Video* video, bool enabled);
+    bool luavlc_fields_info(LuaVLC_Video* video, LuaVLC_FieldInfo* out);
+    void luavlc_video_set_deinterlace(libvlc_media_player_t* mp, int state, const char* mode);
+    int luavlc_compress_header(int format, unsigned int width, unsigned int height, unsigned char* out);
+    void luavlc_compress_benchmark(int format, int quality, unsigned int width, unsigned int height, int frames, LuaVLC_CompressBenchmark* out);
 
     void luavlc_init_vlc(int argc, const char *const *argv);
+    void luavlc_init_vlc_timed(int argc, const char *const *argv, LuaVLC_InitTimings* timings);
+    bool luavlc_init_vlc_async(int argc, const char *const *argv, const char* warmupPath);
+    int luavlc_vlc_state(void);
+    void luavlc_get_init_timings(LuaVLC_InitTimings* timings);
     libvlc_instance_t* luavlc_get_vlc_instance(void);
     void luavlc_free_vlc(void);
 
-    LuaVLC_Audio luavlc_audio_new(void);
-    LuaVLC_Audio* luavlc_audio_new_ptr(void);
+    LuaVLC_Audio luavlc_audio_new(void);
+    LuaVLC_Audio* luavlc_audio_new_ptr(void);
+
+    void luavlc_audio_free_ptr(void* audio);
+    
+    void video_setup_format(libvlc_media_player_t *mp, unsigned int width, unsigned int height);
+    void video_use_unlock_callback(libvlc_media_player_t *mp, void *opaque);
+    void video_use_all_callbacks(libvlc_media_player_t *mp, void *opaque);
+    void video_setup_audio(void* video, libvlc_media_player_t *mp);
+
+    bool can_update_texture(void);
+]]
+
+--- How long (in milliseconds) requiring LoveVLC took, `handle.create` includes this in its timings
+_G.LOVEVLC_LOAD_TIMINGS = {
+    libraries = (librariesEnd - loadStart) * 1000.0,
+    cdefs = (clock() - librariesEnd) * 1000.0
+}
+
+if not love.graphics then
+    return -- this file can also be required from love threads
+end
+local lovevlc = {}
+
+local oldnewvid = love.graphics.newVideo
+local vids = {}
+
+-- player statuses get refreshed for every video at once, at the start of
+-- every frame or whenever one is needed after it got invalidated (see `updateStatuses`)
+local frameIndex = 0
+local statusFrame = -1
+local statusCapacity = 0
+local statusVideos = nil
+local statuses = nil
+
+local IDLE_MODES = {none = 0, pause = 1, keyframe = 2, audio = 3}
+
+local function idleModeValue(mode)
+    local value = IDLE_MODES[mode]
+    if value == nil then
+        error("unknown idle mode " .. tostring(mode) .. " (expected none, pause, keyframe or audio)", 3)
+    end
+    return value
+end
+
+-- same order as LUAVLC_MEM_* in the wrapper
+local MEMORY_CATEGORIES = {"frame", "texture", "audioRing", "audioBuffers", "picturePool", "source", "frameCache"}
+local MEMORY = {}
+for i = 1, #MEMORY_CATEGORIES do
+    MEMORY[MEMORY_CATEGORIES[i]] = i - 1
+end
+
+local function memoryStatsToTable(stats)
+    local result = {
+        total = tonumber(stats.total),
+        totalPeak = tonumber(stats.totalPeak),
+        current = {},
+        peak = {}
+    }
+    for i = 1, #MEMORY_CATEGORIES do
+        result.current[MEMORY_CATEGORIES[i]] = tonumber(stats.current[i - 1])
+        result.peak[MEMORY_CATEGORIES[i]] = tonumber(stats.peak[i - 1])
+    end
+    return result
+end
+
+local function updateStatuses()
+    local count = #vids
+    if count > statusCapacity then
+        statusCapacity = math.max(count, statusCapacity * 2, 16)
+        statusVideos = ffi.new("LuaVLC_Video*[?]", statusCapacity)
+        statuses = ffi.new("LuaVLC_PlayerStatus[?]", statusCapacity)
+    end
+    for i = 1, count do
+        statusVideos[i - 1] = vids[i]._luaVlcVideo
+        vids[i]._statusIndex = i - 1
+    end
+    libvlcWrapper.luavlc_players_update(statusVideos, count, statuses)
+    -- without love.timer there's no way to tell frames apart, so always refresh
+    statusFrame = love.timer and frameIndex or -1
+end
+
+local PROBE_STATUSES = {[0] = "done", "failed", "timeout"}
+local TRACK_TYPES = {[-1] = "unknown", [0] = "audio", "video", "subtitle"}
+
+local probeCallbacks = {} -- id -> {path, callback}
+local probeCount = 0
+local probeConfigured = false
+local probeResults = ffi.new("LuaVLC_ProbeResult[16]")
+
+local function probeResultToTable(result)
+    local info = {
+        status = PROBE_STATUSES[result.status], cached = result.cached ~= 0,
+        duration = result.duration, width = result.width, height = result.height, fps = result.fps,
+        tracks = {}
+    }
+    for i = 0, result.trackCount - 1 do
+        local track = result.tracks[i]
+        info.tracks[i + 1] = {
+            type = TRACK_TYPES[track.type] or "unknown",
+            codec = ffi.string(track.codec):gsub("%s+$", ""), description = ffi.string(track.description),
+            language = ffi.string(track.language), bitrate = track.bitrate,
+            width = track.width, height = track.height, fps = track.fps,
+            channels = track.channels, rate = track.rate
+        }
+    end
+    return info
+end
+
+local function pollProbes()
+    while true do
+        local count = libvlcWrapper.luavlc_probe_poll(probeResults, 16)
+        for i = 0, count - 1 do
+            local request = probeCallbacks[probeResults[i].id]
+            probeCallbacks[probeResults[i].id] = nil
+            probeCount = probeCount - 1
+            if request then
+                request.callback(probeResultToTable(probeResults[i]), request.path)
+            end
+        end
+        if count < 16 then
+            break
+        end
+    end
+end
+
+local thumbnailCallbacks = {} -- id -> {path, callback}
+local thumbnailCount = 0
+local thumbnailConfigured = false
+local thumbnailResult = ffi.new("LuaVLC_ThumbnailResult")
+
+local function pollThumbnails()
+    while libvlcWrapper.luavlc_thumbnail_poll(thumbnailResult) do
+        local request = thumbnailCallbacks[thumbnailResult.id]
+        thumbnailCallbacks[thumbnailResult.id] = nil
+        thumbnailCount = thumbnailCount - 1
+        local imageData
+        if thumbnailResult.status == 0 then
+            imageData = love.image.newImageData(thumbnailResult.width, thumbnailResult.height, "rgba8")
+            ffi.copy(imageData:getFFIPointer(), thumbnailResult.pixels, thumbnailResult.width * thumbnailResult.height * 4)
+        end
+        libvlcWrapper.luavlc_thumbnail_free_pixels(thumbnailResult.pixels)
+        if request then
+            request.callback(imageData, request.path, thumbnailResult.cached ~= 0)
+        end
+    end
+end
+
+local BAKE_STATUSES = {[0] = "ready", "failed", "tooBig"}
+
+local bakes = {} -- id -> baked clip
+local bakeCount = 0
+local bakeResult = ffi.new("LuaVLC_BakeResult")
+local bakeOptions = {maxClipMemory = 64 * 1024 * 1024, maxMemory = 512 * 1024 * 1024, maxDuration = 10}
+local bakedMemory = 0 -- bytes of textures held by baked clips
+
+-- has to match LUAVLC_COMPRESS_* in lib/wrapper/libvlc_wrapper.cpp, pixelFormat is what love calls it
+local COMPRESS_FORMATS = {
+    bc1 = {id = 1, pixelFormat = "DXT1", extension = "dds"},
+    bc7 = {id = 2, pixelFormat = "BC7", extension = "dds"},
+    etc1 = {id = 3, pixelFormat = "ETC1", extension = "pkm"},
+}
+local COMPRESS_NAMES = {[0] = "none", "bc1", "bc7", "etc1"}
+local compressHeader = ffi.new("unsigned char[148]")
+
+-- the format to bake with, or nil for plain rgba if the gpu can't sample it. "auto" takes the best looking one there is
+local function compressFormat(name)
+    if not name then
+        return nil
+    end
+    local formats = love.graphics.getTextureFormats and love.graphics.getTextureFormats({}) or love.graphics.getImageFormats()
+    local candidates = name == "auto" and {"bc7", "bc1", "etc1"} or {name}
+    for _, candidate in ipairs(candidates) do
+        local format = COMPRESS_FORMATS[candidate]
+        if format and formats[format.pixelFormat] then
+            return candidate
+        end
+    end
+    return nil
+end
+
+-- turns the frames into an array texture (or a texture per frame if those aren't supported or there's too many)
+local function bakeTextures(baked, result)
+    local w, h, count = result.width, result.height, result.frames
+    local frameBytes = tonumber(result.frameBytes)
+    local format = COMPRESS_FORMATS[COMPRESS_NAMES[result.format]]
+    local slices = {}
+    for i = 0, count - 1 do
+        if format then
+            -- love only loads compressed textures out of files, so wrap the blocks in a dds/pkm header
+            local headerSize = libvlcWrapper.luavlc_compress_header(format.id, w, h, compressHeader)
+            local fileData = love.filesystem.newFileData(ffi.string(compressHeader, headerSize) .. ffi.string(result.pixels + i * frameBytes, frameBytes), "frame." .. format.extension)
+            slices[i + 1] = love.image.newCompressedData(fileData)
+            fileData:release()
+        else
+            local imageData = love.image.newImageData(w, h, "rgba8")
+            ffi.copy(imageData:getFFIPointer(), result.pixels + i * frameBytes, frameBytes)
+            slices[i + 1] = imageData
+        end
+    end
+    local limits = love.graphics.getSystemLimits()
+    if love.graphics.getTextureTypes().array and count <= (limits.texturelayers or 0) then
+        baked._array = love.graphics.newArrayImage(slices)
+    else
+        baked._images = {}
+        for i = 1, count do
+            baked._images[i] = love.graphics.newImage(slices[i])
+        end
+    end
+    for i = 1, count do
+        slices[i]:release()
+    end
+end
+
+local function pollBakes()
+    while libvlcWrapper.luavlc_bake_poll(bakeResult) do
+        local baked = bakes[bakeResult.id]
+        bakes[bakeResult.id] = nil
+        bakeCount = bakeCount - 1
+        if baked and not baked._released then
+            baked._status = BAKE_STATUSES[bakeResult.status]
+            local bytes = tonumber(bakeResult.frameBytes) * bakeResult.frames
+            -- other clips might have finished first and used up the budget in the meantime
+            if baked._status == "ready" and bakedMemory + bytes > bakeOptions.maxMemory then
+                baked._status = "tooBig"
+            end
+            if baked._status == "ready" then
+                baked._width, baked._height = bakeResult.width, bakeResult.height
+                baked._frames, baked._fps = bakeResult.frames, bakeResult.fps
+                baked._format = COMPRESS_NAMES[bakeResult.format]
+                bakeTextures(baked, bakeResult)
+                baked._bytes = bytes
+                bakedMemory = bakedMemory + bytes
+                libvlcWrapper.luavlc_memory_track(nil, MEMORY.texture, bytes)
+            end
+            if baked._callback then
+                baked._callback(baked, baked._status)
+            end
+        end
+        libvlcWrapper.luavlc_bake_free_pixels(bakeResult.pixels)
+    end
+end
+
+if love.timer then
+    -- this also runs the decode scheduler, which has to happen even when nothing gets drawn
+    local timerStep = love.timer.step
+    love.timer.step = function(...)
+        frameIndex = frameIndex + 1
+        if #vids > 0 then
+            updateStatuses()
+        end
+        if probeCount > 0 then
+            pollProbes()
+        end
+        if thumbnailCount > 0 then
+            pollThumbnails()
+        end
+        if bakeCount > 0 then
+            pollBakes()
+        end
+        return timerStep(...)
+    end
+end
+
+--- 
+--- Returns how much memory (in bytes) LoveVLC is using right now and at its peak, both in total
+--- and per category (`frame`, `texture`, `audioRing`, `audioBuffers`, `picturePool`, `source` and `frameCache`)
+--- 
+--- `stats.videos[i]` is the same thing for each video alive, in the same order as `stats.videos[i].video`
+--- 
+--- `picturePool` is an estimate of what VLC keeps internally, everything else is exact
+--- 
+--- @return table stats
+function lovevlc.getMemoryStats()
+    local count = #vids
+    local list = ffi.new("LuaVLC_Video*[?]", math.max(count, 1))
+    local perVideo = ffi.new("LuaVLC_MemoryStats[?]", math.max(count, 1))
+    local global = ffi.new("LuaVLC_MemoryStats")
+    for i = 1, count do
+        list[i - 1] = vids[i]._luaVlcVideo
+    end
+    libvlcWrapper.luavlc_memory_query(list, count, perVideo, global)
+
+    local stats = memoryStatsToTable(global)
+    stats.videos = {}
+    for i = 1, count do
+        local entry = memoryStatsToTable(perVideo[i - 1])
+        entry.video = vids[i]
+        stats.videos[i] = entry
+    end
+    return stats
+end
+
+--- 
+--- Configures the decode scheduler, which stops wasting time decoding videos nobody is looking at
+--- 
+--- Videos that haven't been drawn for `settings.idleTime` seconds get put into `settings.idleMode`:
+--- - `"pause"` pauses them, they resume where they left off
+--- - `"keyframe"` pauses them, but keeps skipping ahead by keyframe every `settings.keyframeInterval` seconds.
+---   With libvlc 3.0 that only works for videos with a keyframe index (see `video:getSeekStats`), the rest just pause
+--- - `"audio"` stops decoding their video, but keeps the audio playing
+--- - `"none"` keeps decoding like normal
+--- 
+--- `settings.maxActive` limits how many videos can decode at once, videos with
+--- the biggest on-screen area win, the rest get put into their idle mode
+--- 
+--- Pass `nil` to turn the scheduler off again
+--- 
+--- @param settings? {idleTime: number?, idleMode: string?, maxActive: integer?, keyframeInterval: number?}
+function lovevlc.setScheduler(settings)
+    settings = settings or {}
+    libvlcWrapper.luavlc_scheduler_configure(
+        settings.idleTime or 0, idleModeValue(settings.idleMode or "pause"),
+        settings.maxActive or 0, settings.keyframeInterval or 1
+    )
+end
+
+--- Returns whether encrypted videos get decrypted with AES-NI, instead of the (slower, but still plenty fast) portable version
+--- @return boolean
+function lovevlc.hasHardwareDecryption()
+    return libvlcWrapper.luavlc_aes_hardware()
+end
+
+--- 
+--- Turns on the disk cache for `http://` videos, they get saved while they're streamed and played from disk after that
+--- 
+--- Once the cache goes over `settings.maxSize` MB (512 by default), the least recently played videos get deleted
+--- 
+--- `settings.directory` is a real path, by default it's `videocache` in the save directory
+--- 
+--- Pass `nil` to turn it off again (what's already cached stays on disk)
+--- 
+--- @param settings? {directory: string?, maxSize: number?}
+--- @return boolean success
+function lovevlc.setURLCache(settings)
+    if not settings then
+        return libvlcWrapper.luavlc_url_cache_configure(nil, 0)
+    end
+    local directory = settings.directory
+    if not directory then
+        love.filesystem.createDirectory("videocache")
+        directory = love.filesystem.getSaveDirectory() .. "/videocache"
+    end
+    return libvlcWrapper.luavlc_url_cache_configure(directory, (settings.maxSize or 512) * 1024 * 1024)
+end
+
+--- Returns `{hits, misses, downloaded, size, files}` for the URL cache, sizes are in bytes
+--- @return table stats
+function lovevlc.getURLCacheStats()
+    local stats = ffi.new("LuaVLC_UrlCacheStats")
+    libvlcWrapper.luavlc_url_cache_stats(stats)
+    return {
+        hits = tonumber(stats.hits), misses = tonumber(stats.misses),
+        downloaded = tonumber(stats.downloadedBytes), size = tonumber(stats.cachedBytes), files = stats.files
+    }
+end
+
+--- Deletes everything in the URL cache that isn't being downloaded right now
+function lovevlc.clearURLCache()
+    libvlcWrapper.luavlc_url_cache_clear()
+end
+
+--- 
+--- Configures `lovevlc.probe`, call it before probing anything to change the defaults
+--- 
+--- `settings.workers` is how many files get parsed at once (4 by default), `settings.timeout` is in seconds (5 by default)
+--- 
+--- Results get cached in `settings.cacheFile` (a real path, `lovevlc/probecache.bin` in the save directory by default),
+--- pass `false` to not cache anything on disk
+--- 
+--- @param settings? {workers: integer?, timeout: number?, cacheFile: string|false|nil}
+function lovevlc.setProbeOptions(settings)
+    settings = settings or {}
+    local cacheFile = settings.cacheFile
+    if cacheFile == nil then
+        love.filesystem.createDirectory("lovevlc")
+        cacheFile = love.filesystem.getSaveDirectory() .. "/lovevlc/probecache.bin"
+    end
+    libvlcWrapper.luavlc_probe_configure(settings.workers or 4, (settings.timeout or 5) * 1000, cacheFile or nil)
+    probeConfigured = true
+end
+
+-- defined further down
+local fileExists
+
+-- probing and thumbnails can take love.filesystem paths, as long as they're real files somewhere
+local function realPath(path)
+    if not fileExists(path) then
+        local dir = love.filesystem.getRealDirectory(path)
+        if dir and fileExists(dir .. "/" .. path) then
+            return dir .. "/" .. path
+        end
+    end
+    return path
+end
+
+--- 
+--- Finds out the duration, size, codecs and tracks of videos without making a player for them
+--- 
+--- Files get parsed in the background (see `lovevlc.setProbeOptions`), `callback(info, path)` gets
+--- called from `love.timer.step` once each one is done. Files that haven't changed since they were last
+--- probed come straight out of the cache
+--- 
+--- `info` is `{status, cached, duration, width, height, fps, tracks}`, `status` is `"done"`, `"failed"` or `"timeout"`,
+--- and each track is `{type, codec, description, language, bitrate, width, height, fps, channels, rate}`
+--- 
+--- Only works on files on disk (or in `love.filesystem`, as long as they aren't inside of an archive)
+--- 
+--- @param paths string|string[]
+--- @param callback fun(info: table, path: string)
+function lovevlc.probe(paths, callback)
+    if type(paths) == "string" then
+        paths = {paths}
+    end
+    if not probeConfigured then
+        lovevlc.setProbeOptions()
+    end
+    local handle = require((_G.LOVEVLC_PARENT and (_G.LOVEVLC_PARENT .. ".") or "") .. "util.handle")
+    if not handle.instance and libvlcWrapper.luavlc_vlc_state() ~= 1 then
+        handle.init()
+    end
+    for i = 1, #paths do
+        local id = libvlcWrapper.luavlc_probe_request(realPath(paths[i]))
+        probeCallbacks[id] = {path = paths[i], callback = callback}
+        probeCount = probeCount + 1
+    end
+end
+
+--- 
+--- Configures `lovevlc.thumbnail`, call it before asking for any thumbnails to change the defaults
+--- 
+--- `settings.workers` is how many thumbnails get made at once (2 by default, each one is a decoder running),
+--- `settings.timeout` is in seconds (10 by default)
+--- 
+--- Thumbnails get cached in `settings.directory` (a real path, `lovevlc/thumbnails` in the save directory by default),
+--- pass `false` to not cache anything on disk
+--- 
+--- @param settings? {workers: integer?, timeout: number?, directory: string|false|nil}
+function lovevlc.setThumbnailOptions(settings)
+    settings = settings or {}
+    local directory = settings.directory
+    if directory == nil then
+        love.filesystem.createDirectory("lovevlc/thumbnails")
+        directory = love.filesystem.getSaveDirectory() .. "/lovevlc/thumbnails"
+    end
+    libvlcWrapper.luavlc_thumbnail_configure(settings.workers or 2, (settings.timeout or 10) * 1000, directory or nil)
+    thumbnailConfigured = true
+end
+
+--- 
+--- Makes a thumbnail of a video in the background, `callback(imageData, path, cached)` gets called
+--- from `love.timer.step` once it's done (`imageData` is nil if it couldn't be made)
+--- 
+--- `time` is in seconds, or a table `{position = 0.5}` to go by how far into the video it is instead.
+--- Leave `width` or `height` out to keep the video's aspect ratio, or both for its full size
+--- 
+--- Thumbnails get cached on disk (see `lovevlc.setThumbnailOptions`) until the video file changes
+--- 
+--- @param path string
+--- @param time number|{position: number}
+--- @param width? integer
+--- @param height? integer
+--- @param callback fun(imageData: love.ImageData?, path: string, cached: boolean)
+function lovevlc.thumbnail(path, time, width, height, callback)
+    if type(width) == "function" then
+        callback, width, height = width, nil, nil
+    end
+    if not thumbnailConfigured then
+        lovevlc.setThumbnailOptions()
+    end
+    local handle = require((_G.LOVEVLC_PARENT and (_G.LOVEVLC_PARENT .. ".") or "") .. "util.handle")
+    if not handle.instance and libvlcWrapper.luavlc_vlc_state() ~= 1 then
+        handle.init()
+    end
+    local seconds, position = -1, 0
+    if type(time) == "table" then
+        position = math.min(math.max(time.position or 0, 0), 1)
+    else
+        seconds = math.max(time or 0, 0)
+    end
+    local id = libvlcWrapper.luavlc_thumbnail_request(realPath(path), seconds, position, width or 0, height or 0)
+    thumbnailCallbacks[id] = {path = path, callback = callback}
+    thumbnailCount = thumbnailCount + 1
+end
+
+local KEYFRAME_INDEX_STATUSES = {[0] = "none", "building", "ready", "failed"}
+local SEEK_PRECISE, SEEK_FAST = 0, 1
+local keyframesConfigured = false
+
+--- 
+--- Configures the keyframe indexes `video:scrub` and `video:seek(time, true)` use
+--- 
+--- Indexes get cached in `settings.directory` (a real path, `lovevlc/keyframes` in the save directory by default),
+--- pass `false` to not cache anything on disk
+--- 
+--- @param settings? {directory: string|false|nil}
+function lovevlc.setKeyframeOptions(settings)
+    settings = settings or {}
+    local directory = settings.directory
+    if directory == nil then
+        love.filesystem.createDirectory("lovevlc/keyframes")
+        directory = love.filesystem.getSaveDirectory() .. "/lovevlc/keyframes"
+    end
+    libvlcWrapper.luavlc_keyframes_configure(directory or nil)
+    keyframesConfigured = true
+end
+
+--- 
+--- Configures `lovevlc.bake`
+--- 
+--- `settings.maxClipMemory` is the most a single baked clip can take up (64 MB by default), `settings.maxMemory` is
+--- the most all of them together can (512 MB by default), and clips longer than `settings.maxDuration` seconds
+--- (10 by default) never get baked. `settings.workers` is how many clips get baked at once (2 by default)
+--- 
+--- @param settings {maxClipMemory: number?, maxMemory: number?, maxDuration: number?, workers: integer?}
+function lovevlc.setBakeOptions(settings)
+    bakeOptions.maxClipMemory = settings.maxClipMemory or bakeOptions.maxClipMemory
+    bakeOptions.maxMemory = settings.maxMemory or bakeOptions.maxMemory
+    bakeOptions.maxDuration = settings.maxDuration or bakeOptions.maxDuration
+    if settings.workers then
+        libvlcWrapper.luavlc_bake_configure(settings.workers)
+    end
+end
+
+--- 
+--- Times the block compressors `lovevlc.bake` uses on a made up video-like image, to pick a format and quality.
+--- Runs on the calling thread (plus the compression workers), so don't call it mid game
+--- 
+--- `settings.formats` defaults to every format, `settings.qualities` to `{0, 1, 2}`, and the image is
+--- `settings.width` x `settings.height` (256 x 256) with `settings.frames` (8) frames.
+--- Returns a list of `{format, quality, milliseconds, megapixelsPerSecond, psnr, ratio}`, psnr in dB
+--- 
+--- @param settings? {formats: string[]?, qualities: integer[]?, width: integer?, height: integer?, frames: integer?}
+--- @return table[] results
+function lovevlc.benchmarkCompression(settings)
+    settings = settings or {}
+    local out = ffi.new("LuaVLC_CompressBenchmark")
+    local results = {}
+    for _, name in ipairs(settings.formats or {"bc1", "bc7", "etc1"}) do
+        local format = assert(COMPRESS_FORMATS[name], "Unknown compression format " .. tostring(name))
+        for _, quality in ipairs(settings.qualities or {0, 1, 2}) do
+            libvlcWrapper.luavlc_compress_benchmark(format.id, quality, settings.width or 256, settings.height or 256, settings.frames or 8, out)
+            results[#results + 1] = {
+                format = name, quality = quality, milliseconds = out.milliseconds,
+                megapixelsPerSecond = out.megapixelsPerSecond, psnr = out.psnr, ratio = out.ratio
+            }
+        end
+    end
+    return results
+end
+
+--- 
+--- Decodes a short clip once (on a worker thread) into an array texture, and returns a looping player for it
+--- that never touches VLC again. Meant for ambient loops (fire, water, screens) that would otherwise
+--- get decoded over and over forever
+--- 
+--- The clip isn't there right away, `baked:getStatus()` is `"baking"` until it's done and then `"ready"`, `"failed"`,
+--- or `"tooBig"` if it's over the limits in `lovevlc.setBakeOptions`. `settings.callback(baked, status)` gets called
+--- from `love.timer.step` once it's done either way. Drawing it before then draws nothing
+--- 
+--- `settings.width`/`settings.height` scale it down while baking (leave one out to keep the aspect ratio),
+--- which makes a lot more clips fit. Only works on files on disk (or real files in `love.filesystem`)
+--- 
+--- `settings.compress` block compresses the frames on worker threads in chunks as they get decoded: `"bc1"` (1/8 the memory),
+--- `"bc7"` (1/4, looks a lot better), `"etc1"` (1/8, for mobile gpus) or `"auto"` for the best one the gpu supports.
+--- Memory limits count the compressed size. If the gpu can't sample the format the clip is baked as plain rgba.
+--- `settings.quality` (0 to 2, 1 by default) trades compression time for quality, see `lovevlc.benchmarkCompression`
+--- 
+--- The player has `play`, `pause`, `stop`, `seek`, `tell`, `isPlaying`, `setLooping`, `getDuration`, `getFormat`,
+--- `getWidth`, `getHeight`, `getDimensions`, `draw` and `release`, like a regular video. It starts out playing and looping
+--- 
+--- @param path string
+--- @param settings? {width: integer?, height: integer?, compress: string?, quality: integer?, callback: fun(baked: table, status: string)?}
+--- @return table baked
+function lovevlc.bake(path, settings)
+    settings = settings or {}
+    local handle = require((_G.LOVEVLC_PARENT and (_G.LOVEVLC_PARENT .. ".") or "") .. "util.handle")
+    if not handle.instance and libvlcWrapper.luavlc_vlc_state() ~= 1 then
+        handle.init()
+    end
+
+    local baked = {
+        path = path, _status = "baking", _callback = settings.callback,
+        _width = 1, _height = 1, _frames = 0, _fps = 30, _bytes = 0, _format = "none",
+        _playing = true, _looping = true, _position = 0, _startTime = love.timer.getTime()
+    }
+
+    local function position(self)
+        if self._playing and self._frames > 0 then
+            local duration = self._frames / self._fps
+            local t = self._position + (love.timer.getTime() - self._startTime)
+            if not self._looping and t >= duration then
+                self._playing, self._position = false, duration
+                return duration
+            end
+            return t % duration
+        end
+        return self._position
+    end
+
+    function baked:getStatus()
+        return self._status
+    end
+    function baked:isReady()
+        return self._status == "ready"
+    end
+    function baked:play()
+        if not self._playing then
+            if not self._looping and self._position >= self:getDuration() then
+                self._position = 0
+            end
+            self._playing, self._startTime = true, love.timer.getTime()
+        end
+    end
+    function baked:pause()
+        self._position = position(self)
+        self._playing = false
+    end
+    function baked:stop()
+        self._playing, self._position = false, 0
+    end
+    function baked:seek(time)
+        self._position, self._startTime = math.max(time, 0), love.timer.getTime()
+    end
+    function baked:tell()
+        return position(self)
+    end
+    function baked:isPlaying()
+        return self._playing
+    end
+    function baked:setLooping(looping)
+        self._position, self._startTime = position(self), love.timer.getTime()
+        self._looping = looping
+    end
+    function baked:isLooping()
+        return self._looping
+    end
+    function baked:getDuration()
+        return self._frames > 0 and self._frames / self._fps or 0
+    end
+    function baked:getFrameCount()
+        return self._frames
+    end
+    function baked:getFormat()
+        return self._format
+    end
+    function baked:getWidth()
+        return self._width
+    end
+    function baked:getHeight()
+        return self._height
+    end
+    function baked:getDimensions()
+        return self._width, self._height
+    end
+    function baked:draw(...)
+        if self._frames == 0 then
+            return
+        end
+        local frame = math.min(math.floor(position(self) * self._fps), self._frames - 1)
+        if self._array then
+            love.graphics.drawLayer(self._array, frame + 1, ...)
+        else
+            love.graphics.draw(self._images[frame + 1], ...)
+        end
+    end
+    function baked:release()
+        if self._released then
+            return
+        end
+        self._released = true
+        if self._array then
+            self._array:release()
+        end
+        for _, image in ipairs(self._images or {}) do
+            image:release()
+        end
+        self._array, self._images, self._frames = nil, nil, 0
+        bakedMemory = bakedMemory - self._bytes
+        libvlcWrapper.luavlc_memory_track(nil, MEMORY.texture, -self._bytes)
+        self._bytes = 0
+    end
+
+    local maxBytes = math.min(bakeOptions.maxClipMemory, bakeOptions.maxMemory - bakedMemory)
+    if maxBytes <= 0 then
+        baked._status = "tooBig"
+        if baked._callback then
+            baked._callback(baked, baked._status)
+        end
+        return baked
+    end
+    local format = compressFormat(settings.compress)
+    local id = libvlcWrapper.luavlc_bake_request(realPath(path), settings.width or 0, settings.height or 0, maxBytes, bakeOptions.maxDuration,
+        format and COMPRESS_FORMATS[format].id or 0, settings.quality or 1)
+    bakes[id] = baked
+    bakeCount = bakeCount + 1
+    return baked
+end
+
+local pattern = "^[%a][%a%d+%.%-]*://[^%s]*$"
+local function isURL(s)
+    return s:match(pattern) ~= nil
+end
+
+function fileExists(path)
+    local file = io.open(path, "rb")
+    if file then
+        file:close()
+        return true
+    end
+    return false
+end
+
+-- physfs is built into love, so this only works if love exports its symbols
+-- (it does on linux, and on windows builds made with msvc)
+local physfsBound = nil
+local function bindPhysFS()
+    if physfsBound ~= nil then
+        return physfsBound
+    end
+    physfsBound = false
+    pcall(ffi.cdef, [[
+        typedef struct PHYSFS_File PHYSFS_File;
+        PHYSFS_File* PHYSFS_openRead(const char* filename);
+        int64_t PHYSFS_readBytes(PHYSFS_File* handle, void* buffer, uint64_t len);
+        int PHYSFS_seek(PHYSFS_File* handle, uint64_t pos);
+        int64_t PHYSFS_fileLength(PHYSFS_File* handle);
+        int PHYSFS_close(PHYSFS_File* handle);
+    ]])
+    local libs = {ffi.C}
+    if os == "Windows" then
+        local ok, lib = pcall(ffi.load, "love")
+        if ok then
+            table.insert(libs, lib)
+        end
+    end
+    for i = 1, #libs do
+        local lib = libs[i]
+        local ok, physfs = pcall(function()
+            local fns = ffi.new("LuaVLC_PhysFS")
+            fns.openRead = ffi.cast("void*", lib.PHYSFS_openRead)
+            fns.readBytes = ffi.cast("void*", lib.PHYSFS_readBytes)
+            fns.seek = ffi.cast("void*", lib.PHYSFS_seek)
+            fns.fileLength = ffi.cast("void*", lib.PHYSFS_fileLength)
+            fns.close = ffi.cast("void*", lib.PHYSFS_close)
+            return fns
+        end)
+        if ok then
+            libvlcWrapper.luavlc_physfs_bind(physfs)
+            physfsBound = true
+            break
+        end
+    end
+    return physfsBound
+end
+
+local PREFETCH_DEFAULT_MB = 16
+
+-- keys and ivs can be raw bytes or hex
+local function decodeKey(value)
+    if #value % 2 == 0 and value:match("^%x+$") and (#value == 32 or #value == 48 or #value == 64) then
+        return (value:gsub("%x%x", function(byte) return string.char(tonumber(byte, 16)) end))
+    end
+    return value
+end
+
+-- makes the media for a source, wrapping it with decryption and the read-ahead thread if settings asks for them
+local function sourceMedia(source, settings)
+    if settings.key then
+        local key = decodeKey(settings.key)
+        local iv = settings.iv and decodeKey(settings.iv) or string.rep("\0", 16)
+        if #iv ~= 16 then
+            libvlcWrapper.luavlc_source_free(source)
+            error("settings.iv has to be 16 bytes (or 32 hex characters)!", 4)
+        end
+        source = libvlcWrapper.luavlc_source_new_aes_ctr(source, key, #key, iv)
+        if source == nil then
+            error("settings.key has to be 16, 24 or 32 bytes (or twice that in hex characters)!", 4)
+        end
+    end
+    if settings.prefetch then
+        local mb = type(settings.prefetch) == "number" and settings.prefetch or PREFETCH_DEFAULT_MB
+        source = libvlcWrapper.luavlc_source_new_prefetch(source, mb * 1024 * 1024)
+    end
+    local media = libvlcWrapper.luavlc_media_new_source(source)
+    if media == nil then
+        libvlcWrapper.luavlc_source_free(source)
+        return nil, nil
+    end
+    return media, source
+end
+
+--- Makes the media for a video, returns the media and the source it reads from (if any)
+--- 
+--- Files that only exist in `love.filesystem` (a fused game, a mounted zip, the save directory)
+--- get read straight thru physfs, unless `settings.filesystem` says otherwise
+--- 
+--- `settings.mmap` reads local files thru a memory mapping instead of VLC's own file access
+--- 
+--- `settings.prefetch` (`true` or a window size in MB) reads files on a separate read-ahead thread
+--- 
+--- `settings.key`/`settings.iv` decrypt AES-CTR encrypted files on the fly
+--- 
+--- `settings.data` (a `love.Data` or a string) plays straight from memory, it has
+--- to stay alive as long as the media does (the video keeps a reference to it)
+--- 
+--- `fromFile` is set when the video was made from a `love.File`, which always goes thru physfs
+--- 
+--- @return ffi.cdata* media
+--- @return ffi.cdata*? source
+local function newMedia(filename, settings, fromFile)
+    local instance = libvlcWrapper.luavlc_get_vlc_instance()
+    if settings.archive then
+        local archive = settings.archive
+        local entry = ffi.new("LuaVLC_ArchiveEntry")
+        if archive._archive == nil or not libvlcWrapper.luavlc_archive_find(archive._archive, filename, entry) then
+            error("Couldn't find " .. filename .. " in video archive " .. archive.path .. "!", 3)
+        end
+        -- the packer already knows what the clip is, so vlc doesn't have to probe for it,
+        -- options is newVideo's own list so this doesn't stick around for the next clip
+        local codec = ffi.string(entry.codec)
+        if codec ~= "" then
+            table.insert(settings.options, ":demux=" .. codec)
+        end
+        return sourceMedia(libvlcWrapper.luavlc_source_new_archive(archive._archive, filename), settings)
+    end
+    if settings.data then
+        local data = settings.data
+        local pointer, size
+        if type(data) == "string" then
+            pointer, size = ffi.cast("const void*", data), #data
+        else
+            pointer, size = data:getFFIPointer(), data:getSize()
+        end
+        return sourceMedia(libvlcWrapper.luavlc_source_new_memory(pointer, size), settings)
+    end
+    if isURL(filename) then
+        if settings.cache ~= false then
+            local source = libvlcWrapper.luavlc_source_new_cached_url(filename)
+            if source ~= nil then
+                return sourceMedia(source, settings)
+            end
+        end
+        if settings.key then
+            error("Encrypted videos can only be streamed from http:// URLs with the URL cache on!", 3)
+        end
+        return libvlc.libvlc_media_new_location(instance, filename), nil
+    end
+    local useFilesystem = settings.filesystem
+    if fromFile then
+        useFilesystem = true
+    elseif useFilesystem == nil then
+        useFilesystem = not fileExists(filename) and love.filesystem.getInfo(filename, "file") ~= nil
+    end
+    if not useFilesystem then
+        if settings.mmap then
+            local source = libvlcWrapper.luavlc_source_new_mmap(filename)
+            if source == nil then
+                error("Couldn't open " .. filename .. " for memory mapping!", 3)
+            end
+            return sourceMedia(source, settings)
+        end
+        if settings.prefetch or settings.key then
+            local source = libvlcWrapper.luavlc_source_new_file(filename)
+            if source == nil then
+                error("Couldn't open " .. filename .. "!", 3)
+            end
+            return sourceMedia(source, settings)
+        end
+        return libvlc.libvlc_media_new_path(instance, filename), nil
+    end
+    if bindPhysFS() then
+        return sourceMedia(libvlcWrapper.luavlc_source_new_physfs(filename), settings)
+    end
+    -- no physfs, but it might still be a regular file on disk
+    local dir = love.filesystem.getRealDirectory(filename)
+    if dir and fileExists(dir .. "/" .. filename) then
+        return libvlc.libvlc_media_new_path(instance, dir .. "/" .. filename), nil
+    end
+    -- otherwise it's inside of an archive, last resort is reading all of it into memory,
+    -- settings is newVideo's own copy so the buffer doesn't leak into the next video
+    settings.data = love.filesystem.newFileData(filename)
+    return newMedia(filename, settings)
+end
+
+-- have to match DIRTY_BAND_ROWS and DIRTY_MAX_RANGES in lib/wrapper/libvlc_wrapper.cpp
+local DIRTY_BAND_ROWS = 16
+local DIRTY_MAX_RANGES = 32
+local dirtyRanges = ffi.new("unsigned int[?]", DIRTY_MAX_RANGES * 2)
+-- rows per replacePixels for videos without an ImageData of their own, a power of two so it shares
+-- staging images with partial uploads
+local UPLOAD_BAND_ROWS = 128
+
+-- copies rows y to y + height of the frame into a staging image (made on first use) and uploads them
+local function uploadRows(v, y, height)
+    local ctx = v._luaVlcVideo
+    local w = v._width
+    local staging = v._staging[height]
+    if not staging then
+        staging = love.image.newImageData(w, height, "rgba8")
+        v._staging[height] = staging
+        libvlcWrapper.luavlc_memory_track(ctx, MEMORY.frame, w * height * 4)
+    end
+    ffi.copy(staging:getFFIPointer(), ctx.pixelBuffer + y * w * 4, w * height * 4)
+    v.image:replacePixels(staging, 1, 1, 0, y, false)
+end
+
+local function uploadFull(v)
+    local stats = v._uploadStats
+    local w, h = v._width, v._height
+    if v.imageData then
+        v.image:replacePixels(v.imageData)
+    else
+        -- the frame lives in a wrapper buffer, so it goes up a band at a time thru one small staging image
+        local height = math.min(UPLOAD_BAND_ROWS, h)
+        for y = 0, h - 1, height do
+            uploadRows(v, math.min(y, h - height), height)
+        end
+    end
+    stats.full = stats.full + 1
+    stats.bytes = stats.bytes + w * h * 4
+end
+
+-- uploads what changed in a video's frame since the last one, or all of it when it isn't tracking that
+local function uploadFrame(v)
+    local stats = v._uploadStats
+    if not v._partialUpload then
+        uploadFull(v)
+        return
+    end
+    local ctx = v._luaVlcVideo
+    local count = libvlcWrapper.luavlc_dirty_take(ctx, dirtyRanges, DIRTY_MAX_RANGES)
+    if count == 0 then
+        stats.skipped = stats.skipped + 1
+        return
+    end
+    -- staging images come in power of two band counts so there's only ever a handful of them,
+    -- uploading a few unchanged rows along with the rest doesn't hurt
+    local w, h = v._width, v._height
+    local heights, rows = {}, 0
+    for i = 0, count - 1 do
+        local height = DIRTY_BAND_ROWS
+        while height < dirtyRanges[i * 2 + 1] do
+            height = height * 2
+        end
+        heights[i] = math.min(height, h)
+        rows = rows + heights[i]
+    end
+    if count < 0 or rows * 2 > h then
+        uploadFull(v)
+        return
+    end
+    for i = 0, count - 1 do
+        local height = heights[i]
+        uploadRows(v, math.min(dirtyRanges[i * 2], h - height), height)
+    end
+    stats.partial = stats.partial + 1
+    stats.bytes = stats.bytes + rows * w * 4
+end
+
+--- 
+--- Whether `settings.asyncUpload` can work here, and why not if it can't. Needs LÖVE's OpenGL backend on a real GPU
+--- with OpenGL 4.4 (or `ARB_buffer_storage`), so not GLES, Vulkan, Metal or software renderers like llvmpipe
+--- 
+--- @return boolean supported, string? reason
+function lovevlc.hasAsyncUpload()
+    if love.graphics.getRendererInfo() ~= "OpenGL" then
+        return false, "not the OpenGL backend"
+    end
+    local reason = ffi.new("const char*[1]")
+    if not libvlcWrapper.luavlc_gl_load(reason) then
+        return false, ffi.string(reason[0])
+    end
+    return true
+end
+
+-- drawn in between when looking up an image's gl name, made on first use
+local bindProbe = nil
+
+-- love doesn't hand out gl names, but drawing an image leaves it bound to the first texture unit.
+-- draws the image, something else and the image again, and only trusts the name if the binding followed
+-- along every time, so a stale one (another video the same size, say) can't pass for it. 0 if it didn't
+local function boundTexture(image)
+    bindProbe = bindProbe or love.graphics.newImage(love.image.newImageData(1, 1))
+    local names = {}
+    for i, drawn in ipairs({image, bindProbe, image}) do
+        love.graphics.flushBatch()
+        love.graphics.draw(drawn, 0, 0, 0, 0, 0)
+        love.graphics.flushBatch()
+        names[i] = libvlcWrapper.luavlc_gl_bound_texture()
+    end
+    if names[1] == 0 or names[1] == names[2] or names[1] ~= names[3] then
+        return 0
+    end
+    return names[1]
+end
+
+-- has to match FRC_SLOTS in lib/wrapper/libvlc_wrapper.cpp
+local FRC_SLOTS = 4
+local FRC_MODES = {pick = true, blend = true}
+local frcPick = ffi.new("LuaVLC_FrcPick")
+
+-- the images frames get queued into for frame rate conversion, one texture per image
+local function startFrameQueue(v)
+    local ctx = v._luaVlcVideo
+    local w, h = v._width, v._height
+    local frc = {imageData = {}, images = {}, serials = {}, pointers = ffi.new("unsigned char*[?]", FRC_SLOTS)}
+    for i = 1, FRC_SLOTS do
+        frc.imageData[i] = love.image.newImageData(w, h, "rgba8")
+        frc.images[i] = love.graphics.newImage(frc.imageData[i])
+        frc.pointers[i - 1] = frc.imageData[i]:getFFIPointer()
+    end
+    libvlcWrapper.luavlc_memory_track(ctx, MEMORY.frame, w * h * 4 * FRC_SLOTS)
+    libvlcWrapper.luavlc_memory_track(ctx, MEMORY.texture, w * h * 4 * FRC_SLOTS)
+    libvlcWrapper.luavlc_frc_configure(ctx, frc.pointers)
+    v._frc = frc
+end
+
+local function stopFrameQueue(v)
+    local frc = v._frc
+    if not frc then
+        return
+    end
+    -- waits for a copy into the images that's still going
+    libvlcWrapper.luavlc_frc_configure(v._luaVlcVideo, nil)
+    for i = 1, FRC_SLOTS do
+        frc.imageData[i]:release()
+        frc.images[i]:release()
+    end
+    local bytes = v._width * v._height * 4 * FRC_SLOTS
+    libvlcWrapper.luavlc_memory_track(v._luaVlcVideo, MEMORY.frame, -bytes)
+    libvlcWrapper.luavlc_memory_track(v._luaVlcVideo, MEMORY.texture, -bytes)
+    v._frc = nil
+end
+
+-- texture of a frame queue slot, uploaded if it got a new frame since it was last drawn
+local function frameQueueImage(v, slot, serial)
+    local frc = v._frc
+    serial = tonumber(serial)
+    if frc.serials[slot] ~= serial then
+        frc.serials[slot] = serial
+        frc.images[slot + 1]:replacePixels(frc.imageData[slot + 1])
+        v._uploadStats.full = v._uploadStats.full + 1
+        v._uploadStats.bytes = v._uploadStats.bytes + v._width * v._height * 4
+    end
+    return frc.images[slot + 1]
+end
+
+-- stand-ins for vlc's adjust, logo and marquee filters, done when the video gets drawn instead of on every
+-- decoded frame. options go by vlc's names or libvlc_video_{adjust,logo,marquee}_option_t values
+local ADJUST_OPTIONS = {[0] = "enable", "contrast", "brightness", "hue", "saturation", "gamma"}
+local LOGO_OPTIONS = {[0] = "enable", "file", "x", "y", "delay", "repeat", "opacity", "position"}
+local MARQUEE_OPTIONS = {[0] = "enable", "text", "color", "opacity", "position", "refresh", "size", "timeout", "x", "y"}
+
+-- same defaults as vlc
+local function newAdjust()
+    return {enable = 0, contrast = 1, brightness = 1, hue = 0, saturation = 1, gamma = 1}
+end
+local function newLogo()
+    return {enable = 0, file = "", x = -1, y = -1, delay = 1000, ["repeat"] = -1, opacity = 255, position = -1, entries = {}, started = 0}
+end
+local function newMarquee()
+    return {enable = 0, text = "", color = 0xFFFFFF, opacity = 255, position = -1, refresh = 1000, size = 0, timeout = 0, x = 0, y = 0, started = 0}
+end
+
+local function filterOption(options, option)
+    if type(option) == "number" then
+        option = options[option]
+    elseif type(option) == "string" then
+        option = option:lower()
+    end
+    for _, name in pairs(options) do
+        if name == option then
+            return name
+        end
+    end
+    error("unknown option " .. tostring(option), 3)
+end
+
+-- deinterlacing modes, by vlc's names. the 2x ones show each field on its own, at twice the frame rate
+local DEINTERLACE_MODES = {blend = 1, bob = 2, linear = 3, yadif = 4, yadif2x = 4}
+local DEINTERLACE_FIELD_RATE = {bob = true, linear = true, yadif2x = true}
+
+-- deinterlacing, frame blending (for frame rate conversion) and vlc's adjust filter, in one pass
+local VIDEO_SHADER = [[
+uniform Image blendTexture;
+uniform float blendWeight;
+uniform bool adjust;
+uniform float contrast;
+uniform float brightness;
+uniform vec2 hue; // cos, sin
+uniform float saturation;
+uniform float gamma; // 1 / vlc's gamma
+uniform int deinterlace; // 0 off, 1 blend, 2 bob, 3 linear, 4 yadif
+uniform float field; // which rows are the field being shown, 0 even (top) or 1 odd (bottom)
+uniform bool firstField; // whether it's the field that comes first in the frame
+uniform vec2 texel; // size of one pixel of the frame
+uniform Image previousTexture; // the frame before this one, for yadif
+
+vec4 frame(Image tex, vec2 uv) {
+    return mix(Texel(tex, uv), Texel(blendTexture, uv), blendWeight);
+}
+
+float luma(vec4 pixel) {
+    return dot(pixel.rgb, vec3(0.299, 0.587, 0.114));
+}
+
+vec4 deinterlaced(Image tex, vec2 uv) {
+    // snapped to the middle of the row so the rows above and below are whole rows away
+    float row = floor(uv.y / texel.y);
+    vec2 at = vec2(uv.x, (row + 0.5) * texel.y);
+    vec2 up = vec2(0.0, texel.y);
+    vec4 here = frame(tex, at);
+    vec4 c = frame(tex, at - up);
+    vec4 e = frame(tex, at + up);
+    if (row < 0.5)
+        c = e;
+    if (at.y + up.y > 1.0)
+        e = c;
+    if (deinterlace == 1)
+        return here * 0.5 + (c + e) * 0.25;
+    if (mod(row, 2.0) == field)
+        return here;
+    if (deinterlace == 2)
+        return field == 0.0 ? c : e;
+    if (deinterlace == 3)
+        return (c + e) * 0.5;
+
+    // yadif-ish: an edge directed guess from the field's own rows, kept within how much the missing row changes
+    // over time. this row of this frame is the other field, half a frame after (or before) the one being shown
+    vec2 side = vec2(texel.x, 0.0);
+    vec4 spatial = (c + e) * 0.5;
+    float best = abs(luma(frame(tex, at - up - side)) - luma(frame(tex, at + up - side))) + abs(luma(c) - luma(e))
+        + abs(luma(frame(tex, at - up + side)) - luma(frame(tex, at + up + side)));
+    for (int k = -1; k <= 1; k += 2) {
+        vec2 d = side * float(k);
+        float score = abs(luma(frame(tex, at - up - side + d)) - luma(frame(tex, at + up - side - d)))
+            + abs(luma(frame(tex, at - up + d)) - luma(frame(tex, at + up - d)))
+            + abs(luma(frame(tex, at - up + side + d)) - luma(frame(tex, at + up + side - d)));
+        if (score < best) {
+            best = score;
+            spatial = (frame(tex, at - up + d) + frame(tex, at + up - d)) * 0.5;
+        }
+    }
+    vec4 before = Texel(previousTexture, at);
+    vec4 temporal = firstField ? (before + here) * 0.5 : here;
+    vec4 diff = firstField ? abs(before - here) * 0.5 : vec4(0.0);
+    // how much the rows around it moved since the last frame
+    diff = max(diff, (abs(Texel(previousTexture, at - up) - c) + abs(Texel(previousTexture, at + up) - e)) * 0.5);
+    return clamp(spatial, temporal - diff, temporal + diff);
+}
+
+vec4 effect(vec4 color, Image tex, vec2 uv, vec2 screen) {
+    vec4 pixel = deinterlace != 0 ? deinterlaced(tex, uv) : frame(tex, uv);
+    if (adjust) {
+        // what vlc's adjust does, contrast/brightness/gamma on luma and a rotate/scale of chroma, in full range bt.601
+        float y = dot(pixel.rgb, vec3(0.299, 0.587, 0.114));
+        vec2 c = vec2(dot(pixel.rgb, vec3(-0.168736, -0.331264, 0.5)), dot(pixel.rgb, vec3(0.5, -0.418688, -0.081312)));
+        y = pow(clamp((y - 0.5) * contrast + 0.5 + brightness - 1.0, 0.0, 1.0), gamma);
+        c = vec2(c.x * hue.x + c.y * hue.y, c.y * hue.x - c.x * hue.y) * saturation;
+        pixel.rgb = clamp(vec3(y + 1.402 * c.y, y - 0.344136 * c.x - 0.714136 * c.y, y + 1.772 * c.x), 0.0, 1.0);
+    }
+    return pixel * color;
+}
+]]
+local videoShader -- made on first use
+local fieldInfo = ffi.new("LuaVLC_FieldInfo")
+
+-- how to deinterlace the video's current frame: the shader's mode, which rows are the field to show
+-- and whether that's the first field of the frame, or nil if it shouldn't be
+local function deinterlaceState(v)
+    if v._deinterlace == 0 or v._cell or not libvlcWrapper.luavlc_fields_info(v._luaVlcVideo, fieldInfo) then
+        return nil
+    end
+    if v._deinterlace < 0 and fieldInfo.interlaced == 0 then
+        return nil
+    end
+    local topFirst = v._fieldOrder == "top" or (v._fieldOrder ~= "bottom" and fieldInfo.topFieldFirst ~= 0)
+    -- field rate modes switch to the second field halfway thru the frame
+    local first = not DEINTERLACE_FIELD_RATE[v._deinterlaceMode] or fieldInfo.frameMs <= 0
+        or fieldInfo.sinceFrameMs < fieldInfo.frameMs / 2
+    return DEINTERLACE_MODES[v._deinterlaceMode], topFirst == first and 0 or 1, first
+end
+
+-- yadif looks at the frame before the current one, so the texture gets copied right before it's replaced
+local function keepPreviousFrame(v)
+    if v._deinterlace == 0 or DEINTERLACE_MODES[v._deinterlaceMode] ~= 4 or not v.image then
+        return
+    end
+    if not v._previousFrame then
+        v._previousFrame = love.graphics.newCanvas(v._width, v._height)
+        libvlcWrapper.luavlc_memory_track(v._luaVlcVideo, MEMORY.texture, v._width * v._height * 4)
+    end
+    love.graphics.push("all")
+    love.graphics.origin()
+    love.graphics.setCanvas(v._previousFrame)
+    love.graphics.setShader()
+    love.graphics.setBlendMode("replace")
+    love.graphics.setColor(1, 1, 1, 1)
+    love.graphics.draw(v.image)
+    love.graphics.pop()
+end
+
+local function releasePreviousFrame(v)
+    if v._previousFrame then
+        v._previousFrame:release()
+        v._previousFrame = nil
+        libvlcWrapper.luavlc_memory_track(v._luaVlcVideo, MEMORY.texture, -v._width * v._height * 4)
+    end
+end
+
+-- the shader to draw a video with, or nil if it doesn't need one
+local function videoShaderFor(v, image, blend, weight)
+    local adjust = v._adjust
+    local adjusting = adjust.enable ~= 0
+    local deinterlace, field, first = deinterlaceState(v)
+    if not blend and not adjusting and not deinterlace then
+        return nil
+    end
+    videoShader = videoShader or love.graphics.newShader(VIDEO_SHADER)
+    videoShader:send("blendTexture", blend or image)
+    videoShader:send("blendWeight", blend and weight or 0)
+    videoShader:send("adjust", adjusting)
+    videoShader:send("deinterlace", deinterlace or 0)
+    if deinterlace then
+        local w, h = image:getDimensions()
+        videoShader:send("texel", {1 / w, 1 / h})
+        videoShader:send("field", field)
+        videoShader:send("firstField", first)
+        videoShader:send("previousTexture", v._previousFrame or image)
+    end
+    if adjusting then
+        local hue = math.rad(adjust.hue)
+        videoShader:send("contrast", adjust.contrast)
+        videoShader:send("brightness", adjust.brightness)
+        videoShader:send("hue", {math.cos(hue), math.sin(hue)})
+        videoShader:send("saturation", adjust.saturation)
+        videoShader:send("gamma", 1 / math.max(adjust.gamma, 0.01))
+    end
+    return videoShader
+end
+
+-- "file,delay,alpha;file,delay,alpha;...", delay and alpha are optional
+local function loadLogo(logo, files)
+    for _, entry in ipairs(logo.entries) do
+        entry.image:release()
+    end
+    logo.entries = {}
+    for item in files:gmatch("[^;]+") do
+        local path, delay, alpha = item:match("^([^,]*),?(%-?%d*),?(%-?%d*)$")
+        local image
+        if path and path ~= "" then
+            if love.filesystem.getInfo(path) then
+                image = love.graphics.newImage(path)
+            else
+                -- not in love's filesystem, try it as a regular path
+                local file = io.open(path, "rb")
+                if file then
+                    image = love.graphics.newImage(love.filesystem.newFileData(file:read("*a"), path))
+                    file:close()
+                end
+            end
+        end
+        if image then
+            logo.entries[#logo.entries + 1] = {image = image, delay = tonumber(delay), alpha = tonumber(alpha)}
+        end
+    end
+    logo.started = love.timer.getTime()
+end
+
+-- aligns a w by h box inside the video like vlc does, position is a mix of
+-- 1 (left), 2 (right), 4 (top) and 8 (bottom), or -1 to just put it at x, y
+local function overlayPosition(v, w, h, position, x, y)
+    if position < 0 then
+        return math.max(x, 0), math.max(y, 0)
+    end
+    local vw, vh = v:getWidth(), v:getHeight()
+    x, y = math.max(x, 0), math.max(y, 0)
+    local px = position % 4 == 1 and x or position % 4 == 2 and vw - w - x or (vw - w) / 2
+    local py = math.floor(position / 4) % 4 == 1 and y or math.floor(position / 4) % 4 == 2 and vh - h - y or (vh - h) / 2
+    return px, py
+end
+
+local function drawLogo(v, logo)
+    local entries = logo.entries
+    if #entries == 0 then
+        return
+    end
+    local total = 0
+    for _, entry in ipairs(entries) do
+        total = total + math.max(entry.delay or logo.delay, 1)
+    end
+    local elapsed = (love.timer.getTime() - logo.started) * 1000
+    local entry = entries[#entries]
+    if logo["repeat"] < 0 or elapsed < total * (logo["repeat"] + 1) then
+        elapsed = elapsed % total
+        for _, e in ipairs(entries) do
+            elapsed = elapsed - math.max(e.delay or logo.delay, 1)
+            if elapsed < 0 then
+                entry = e
+                break
+            end
+        end
+    end
+    local alpha = entry.alpha and entry.alpha >= 0 and entry.alpha or logo.opacity
+    local w, h = entry.image:getDimensions()
+    local x, y = overlayPosition(v, w, h, logo.position, logo.x, logo.y)
+    love.graphics.setColor(1, 1, 1, alpha / 255)
+    love.graphics.draw(entry.image, x, y)
+end
 
-    void luavlc_audio_free_ptr(void* audio);
-    
-    void video_setup_format(libvlc_media_player_t *mp, unsigned int width, unsigned int height);
-    void video_use_unlock_callback(libvlc_media_player_t *mp, void *opaque);
-    void video_use_all_callbacks(libvlc_media_player_t *mp, void *opaque);
-    void video_setup_audio(void* video, libvlc_media_player_t *mp);
+local marqueeFonts = {} -- size -> font
 
-    bool can_update_texture(void);
-]]
+local function drawMarquee(v, marquee)
+    local now = love.timer.getTime()
+    if marquee.timeout > 0 and (now - marquee.started) * 1000 > marquee.timeout then
+        return
+    end
+    -- vlc runs the text thru strftime, and redraws it every refresh ms
+    local text = marquee.text
+    if text:find("%", 1, true) then
+        if not marquee.expanded or (now - marquee.expandedAt) * 1000 >= marquee.refresh then
+            marquee.expanded = os.date(text)
+            marquee.expandedAt = now
+        end
+        text = marquee.expanded
+    end
+    if text == "" then
+        return
+    end
+    local size = marquee.size > 0 and marquee.size or math.max(math.floor(v:getHeight() / 20), 8)
+    local font = marqueeFonts[size]
+    if not font then
+        font = love.graphics.newFont(size)
+        marqueeFonts[size] = font
+    end
+    local x, y = overlayPosition(v, font:getWidth(text), font:getHeight(), marquee.position, marquee.x, marquee.y)
+    local color = marquee.color
+    love.graphics.setColor(math.floor(color / 65536) % 256 / 255, math.floor(color / 256) % 256 / 255, color % 256 / 255, marquee.opacity / 255)
+    love.graphics.print(text, font, x, y)
+end
 
-if not love.graphics then
-    return -- this file gets required for handle.initasync
+local overlayTransform -- made on first use
+
+-- draws the logo and marquee over a video that was just drawn with the same arguments
+local function drawOverlays(v, ...)
+    local first = ...
+    local transform
+    if type(first) == "userdata" and first.typeOf and first:typeOf("Transform") then
+        transform = first
+    elseif first == nil or type(first) == "number" then
+        local x, y, r, sx, sy, ox, oy, kx, ky = ...
+        overlayTransform = overlayTransform or love.math.newTransform()
+        transform = overlayTransform:setTransformation(x or 0, y or 0, r or 0, sx or 1, sy or sx or 1, ox or 0, oy or 0, kx or 0, ky or 0)
+    else
+        -- drawn with a quad of its own, there's no telling where the overlays would go
+        return
+    end
+    love.graphics.push("all")
+    love.graphics.applyTransform(transform)
+    if v._logo.enable ~= 0 then
+        drawLogo(v, v._logo)
+    end
+    if v._marquee.enable ~= 0 then
+        drawMarquee(v, v._marquee)
+    end
+    love.graphics.pop()
 end
-local oldnewvid = love.graphics.newVideo
-local vids = {}
 
-local pattern = "^[%a][%a%d+%.%-]*://[^%s]*$"
-local function isURL(s)
-    return s:match(pattern) ~= nil
+-- keeps the band the full uploads of videos without an ImageData use
+local function releaseStaging(v)
+    local keep = not v.imageData and v._rendered and not v._cell and math.min(UPLOAD_BAND_ROWS, v._height)
+    for height, staging in pairs(v._staging) do
+        if height ~= keep then
+            staging:release()
+            v._staging[height] = nil
+            libvlcWrapper.luavlc_memory_track(v._luaVlcVideo, MEMORY.frame, -v._width * height * 4)
+        end
+    end
 end
 
 --- 
@@ -137,6 +1786,44 @@ end
 --- You can provide a `VideoStream`, but only Theora video streams
 --- are supported, to play other formats you need to use a file name.
 --- 
+--- File names that don't exist on disk but do exist in `love.filesystem` (or a `love.File`)
+--- are read straight out of it, set `settings.filesystem` to force this on or off.
+--- 
+--- Set `settings.mmap` to read local files thru a memory mapping (good for kiosks playing from fast local disks).
+--- 
+--- Set `settings.prefetch` to `true` (or a window size in MB, 16 by default) to read files on a separate
+--- read-ahead thread, for slow hard drives and network shares. See `video:getPrefetchStats()`.
+--- 
+--- `http://` URLs go thru the disk cache when it's turned on (see `lovevlc.setURLCache`), unless `settings.cache` is `false`.
+--- 
+--- Files encrypted with AES-CTR (`openssl enc -aes-256-ctr -K <key> -iv <iv> -nosalt`, 128 and 192 bit keys work too)
+--- are decrypted while they're read when `settings.key` is set, nothing ever gets written to disk decrypted.
+--- `settings.key` and `settings.iv` (all zeros by default) can be raw bytes or hex. This works for any file, data or archive clip.
+--- 
+--- Unless `settings.autoCaching` is `false`, `:file-caching`/`:network-caching` get picked from the
+--- read throughput measured so far (by prefetching videos).
+--- 
+--- Clips packed into a video archive are played with `archive:newVideo(name, settings)` (see `lovevlc.openArchive`).
+--- 
+--- MP4 and Matroska files on disk get a keyframe index built in the background (and cached, see `lovevlc.setKeyframeOptions`)
+--- for `video:scrub` and fast seeks, set `settings.keyframeIndex` to `false` to skip it.
+--- 
+--- `settings.frameCache` (a size in MB, or `{size, lookahead}`) keeps decoded frames around for stepping back, see `video:setFrameCache`.
+--- 
+--- Lots of small videos on screen at once are cheaper in an atlas, see `lovevlc.newAtlas`.
+--- 
+--- `settings.partialUpload` only uploads the rows that changed each frame, see `video:setPartialUpload`.
+--- `settings.asyncUpload` hands frames to the GPU without stalling the main thread, see `video:setAsyncUpload`.
+--- `settings.frameRateConversion` (`"pick"` or `"blend"`) times frames to the display instead of showing the newest,
+--- see `video:setFrameRateConversion`.
+--- `settings.deinterlace` (a mode, or `true`) deinterlaces frames that look interlaced on the GPU instead of in VLC,
+--- with `settings.fieldOrder` to override the detected field order, see `video:setDeinterlace`.
+--- `settings.keepImageData = false` has VLC decode into a buffer of the wrapper's instead of `video.imageData`,
+--- so only the texture stays around at full size, see `video:getImageData`.
+--- 
+--- A `love.Data` (like a `ByteData`) can be passed instead of a file name to play it from memory without
+--- copying it, or pass a string of bytes as `settings.data`.
+--- 
 --- NOTE: `settings.dpiscale` is currently ignored!
 --- 
 --- [Open in Browser](https://love2d.org/wiki/love.graphics.newVideo)
@@ -145,14 +1832,26 @@ end
 --- @overload fun(filename: string, settings?: table):love.Video
 --- @overload fun(filename: string, loadaudio?: boolean):love.Video
 --- @overload fun(videostream: love.VideoStream, loadaudio?: boolean):love.Video
+--- @overload fun(data: love.Data, settings?: table):love.Video
 love.graphics.newVideo = function(filename, settings)
+    local fromFile = false
+    local fromData = nil
+    if type(filename) == "userdata" and filename.typeOf and filename:typeOf("File") then
+        -- love.filesystem File, play what it points to
+        filename = filename:getFilename()
+        fromFile = true
+    elseif type(filename) == "userdata" and filename.typeOf and filename:typeOf("Data") then
+        -- ByteData, FileData, etc, play it straight from memory
+        fromData = filename
+        filename = filename.getFilename and filename:getFilename() or "memory"
+    end
     if type(filename) == "table" or type(filename) == "userdata" then
         -- assume video stream
         return oldnewvid(filename, settings)
     end
     -- otherwise assume file name
     local ext = filename:match("^.+(%..+)$")
-    if ext == ".ogv" then
+    if ext == ".ogv" and not fromData and not (type(settings) == "table" and (settings.archive or settings.key)) then
         return oldnewvid(filename, settings)
     end
     if type(settings) == "boolean" then
@@ -161,18 +1860,27 @@ love.graphics.newVideo = function(filename, settings)
     if not settings then
         settings = {audio = false, dpiscale = love.graphics.getDPIScale()}
     end
+    -- everything below fills in this copy, the caller's table might get reused for another video
+    local copy = {}
+    for k, v in pairs(settings) do
+        copy[k] = v
+    end
+    copy.options = settings.options and {unpack(settings.options)} or {}
+    settings = copy
     if settings.audio == nil then
         settings.audio = false
     end
     if settings.dpiscale == nil then
         settings.dpiscale = love.graphics.getDPIScale( )
     end
-    if settings.options == nil then
-        settings.options = {}
-    end
+    -- checked before anything gets made, so a bad one doesn't leave a half made video behind
+    local idleMode = settings.idleMode and idleModeValue(settings.idleMode)
     if not settings.audio then
         table.insert(settings.options, ":no-audio")
     end
+    if fromData then
+        settings.data = fromData
+    end
     local handle = require((_G.LOVEVLC_PARENT and (_G.LOVEVLC_PARENT .. ".") or "") .. "util.handle")
     if not handle.instance then
         handle.init()
@@ -181,13 +1889,17 @@ love.graphics.newVideo = function(filename, settings)
         _type = "LoveVLCVideo",
 
         image = nil, --- @type love.Image
-        imageData = nil, --- @type love.ImageData
+        imageData = nil, --- @type love.ImageData nil with `settings.keepImageData = false`, use `video:getImageData`
 
         _mediaPlayer = nil, --- @protected
         _rendered = false, --- @protected
 
         _luaVlcVideo = nil, --- @protected
         _luaVlcAudio = nil, --- @protected
+        _data = nil, --- @protected
+
+        _statusIndex = nil, --- @protected
+        _frameSequence = 0, --- @protected
 
         _volume = 1.0 --- @protected
     } --- @class lovevlc.Video
@@ -199,6 +1911,7 @@ love.graphics.newVideo = function(filename, settings)
         end,
         setVolume = function(_, vol)
             video._volume = vol
+            video._luaVlcVideo.volume = vol
             libvlc.libvlc_audio_set_volume(video._mediaPlayer, vol * 100)
         end
     }, {
@@ -210,59 +1923,522 @@ love.graphics.newVideo = function(filename, settings)
             error("You can't access the " .. k .. " property from VLC audio source!", 2)
         end
     })
-    table.insert(vids, video)
 
-    local media = nil
-    if isURL(filename) then
-        media = libvlc.libvlc_media_new_location(libvlcWrapper.luavlc_get_vlc_instance(), filename)
-    else
-        media = libvlc.libvlc_media_new_path(libvlcWrapper.luavlc_get_vlc_instance(), filename)
+    local media, source = newMedia(filename, settings, fromFile)
+    -- the source reads straight out of this, so it can't get collected before the video is released
+    video._data = settings.data
+    local options = {}
+    if settings.autoCaching ~= false and not settings.data then
+        local network = isURL(filename) or (source ~= nil and libvlcWrapper.luavlc_source_is_network(source))
+        local caching = libvlcWrapper.luavlc_prefetch_caching_ms(network)
+        if caching > 0 then
+            -- goes first so options passed in by the user still win
+            options[1] = (network and ":network-caching=" or ":file-caching=") .. caching
+        end
     end
     for i = 1, #settings.options do
-        libvlc.libvlc_media_add_option(media, settings.options[i])
+        options[#options + 1] = settings.options[i]
+    end
+    for i = 1, #options do
+        libvlc.libvlc_media_add_option(media, options[i])
     end
     video._mediaPlayer = libvlc.libvlc_media_player_new_from_media(media)
-    libvlc.libvlc_media_release(media)
 
-    video._luaVlcVideo = libvlcWrapper.luavlc_new()
+    video._luaVlcVideo = libvlcWrapper.luavlc_new_ptr()
     ffi.gc(video._luaVlcVideo, nil) -- NO GC FOR YOU
 
     video._luaVlcAudio = libvlcWrapper.luavlc_audio_new_ptr()
     ffi.gc(video._luaVlcAudio, nil) -- NO GC FOR YOU x2
 
-    libvlcWrapper.video_use_unlock_callback(video._mediaPlayer, ffi.cast("void*", video._luaVlcVideo.pixelBuffer))
+    libvlcWrapper.luavlc_video_attach(video._luaVlcVideo, video._mediaPlayer, media)
+    libvlcWrapper.luavlc_video_attach_audio(video._luaVlcVideo, video._luaVlcAudio)
+    if source then
+        libvlcWrapper.luavlc_video_attach_source(video._luaVlcVideo, source)
+    end
+    libvlc.libvlc_media_release(media)
+    -- only once it has a player, newMedia can still error out above and love.audio walks this list
+    table.insert(vids, video)
+
+    if idleMode then
+        video._luaVlcVideo.idleMode = idleMode
+    end
+
+    -- plain files on disk can be indexed and decoded a second time by the frame cache,
+    -- encrypted ones would just be noise to the parser
+    if not settings.archive and not settings.data and not settings.key and not isURL(filename) then
+        local path = realPath(filename)
+        video._diskPath = fileExists(path) and path or nil
+    end
+    if settings.keyframeIndex ~= false and video._diskPath then
+        if not keyframesConfigured then
+            lovevlc.setKeyframeOptions()
+        end
+        libvlcWrapper.luavlc_video_index_keyframes(video._luaVlcVideo, video._diskPath)
+    end
+    video._frameCache = settings.frameCache
+    video._atlas = settings.atlas
+    video._partialUpload = settings.partialUpload or false
+    video._asyncUpload = settings.asyncUpload or false
+    video._staging = {}
+    video._keepImageData = settings.keepImageData ~= false
+    video._frcMode = settings.frameRateConversion or nil
+    video._adjust = newAdjust()
+    video._logo = newLogo()
+    video._marquee = newMarquee()
+    video._deinterlace = 0
+    video._deinterlaceMode = "yadif2x"
+    video._fieldOrder = settings.fieldOrder or "auto"
+    video._uploadStats = {full = 0, partial = 0, skipped = 0, async = 0, bytes = 0}
+
+    libvlcWrapper.video_use_unlock_callback(video._mediaPlayer, video._luaVlcVideo)
     libvlcWrapper.video_setup_audio(video._luaVlcAudio, video._mediaPlayer)
 
+    --- Returns the status of this video for the current frame, every video
+    --- gets refreshed in a single call the first time this is called in a frame
+    --- 
+    --- The returned struct gets reused, so copy anything you want to keep around
+    --- 
+    --- @return ffi.cdata* status `frameSequence`, `state`, `time`, `length`, `width`, `height`, `buffering` and `droppedFrames`
+    video.getStatus = function(v)
+        if statusFrame ~= frameIndex or not v._statusIndex then
+            updateStatuses()
+        end
+        return statuses[v._statusIndex]
+    end
     video.play = function(v)
+        -- counts as being drawn, so the scheduler doesn't idle it right away
+        v._luaVlcVideo.wantPlaying = 1
+        v._luaVlcVideo.presentCount = v._luaVlcVideo.presentCount + 1
+        -- picks up from the cached frame that's showing, if there is one
+        libvlcWrapper.luavlc_frame_cache_resume(v._luaVlcVideo)
         libvlc.libvlc_media_player_play(v._mediaPlayer)
+        statusFrame = -1
     end
     video.pause = function(v)
-        libvlc.libvlc_media_player_pause(v._mediaPlayer)
+        v._luaVlcVideo.wantPlaying = 0
+        libvlc.libvlc_media_player_set_pause(v._mediaPlayer, 1)
+        statusFrame = -1
     end
     video.stop = function(v)
+        v._luaVlcVideo.wantPlaying = 0
         libvlc.libvlc_media_player_stop(v._mediaPlayer)
+        statusFrame = -1
     end
     video.isPlaying = function(v)
-        return libvlc.libvlc_media_player_is_playing(v._mediaPlayer)
+        return v:getStatus().state == 3 -- 3 = playing
     end
     video.tell = function(v)
-        return tonumber(libvlc.libvlc_media_player_get_time(v._mediaPlayer)) / 1000.0
+        return v:getStatus().time
     end
     video.getDuration = function(v)
-        return libvlc.libvlc_media_player_get_length(v._mediaPlayer) / 1000.0
+        return v:getStatus().length
+    end
+    --- Seeks to `time` (in seconds), or to the keyframe nearest to it if `fast` is true
+    --- (which doesn't have to decode anything before it, so it's way quicker on long-GOP files)
+    video.seek = function(v, time, fast)
+        libvlcWrapper.luavlc_video_seek(v._luaVlcVideo, time * 1000.0, fast and SEEK_FAST or SEEK_PRECISE)
+        statusFrame = -1
+    end
+    --- Call this every time a timeline scrubber moves, it fast-seeks to the nearest keyframe with only
+    --- one seek in flight at a time. Call `video:endScrub(time)` when it gets let go to land exactly on `time`
+    --- @return number time where the video is going to land, in seconds
+    video.scrub = function(v, time)
+        statusFrame = -1
+        return libvlcWrapper.luavlc_video_scrub(v._luaVlcVideo, time * 1000.0, false) / 1000.0
+    end
+    video.endScrub = function(v, time)
+        libvlcWrapper.luavlc_video_scrub(v._luaVlcVideo, time * 1000.0, true)
+        statusFrame = -1
+    end
+    --- Returns the keyframe times (in seconds) of this video, or nil if its keyframe index isn't
+    --- ready (see `video:getSeekStats().keyframeIndex`). Intra-only videos have every frame as a keyframe and return `{}`
+    --- @return number[]?
+    video.getKeyframes = function(v)
+        local count = libvlcWrapper.luavlc_video_keyframes(v._luaVlcVideo, nil, 0)
+        if count < 0 then
+            return nil
+        end
+        local times = ffi.new("double[?]", math.max(count, 1))
+        libvlcWrapper.luavlc_video_keyframes(v._luaVlcVideo, times, count)
+        local out = {}
+        for i = 0, count - 1 do
+            out[i + 1] = times[i] / 1000.0
+        end
+        return out
+    end
+    --- 
+    --- Keeps up to `size` MB of recently decoded frames around the playhead, so stepping backwards
+    --- (`video:stepFrame(-1)`) and small scrubs (`video:showFrame(time)`) come out of memory instead of
+    --- a seek. Frames get stored as 4:2:0 YUV, about 1.5 bytes per pixel
+    --- 
+    --- With `lookahead` (in seconds, 2 by default) a worker decodes that many seconds of frames before wherever
+    --- stepping back runs out of cached ones, on a hidden player of its own. Only works for files on disk
+    --- 
+    --- Pass `0` or `false` to turn it off. Can also be set up front with `settings.frameCache = size` or
+    --- `{size = ..., lookahead = ...}`, it starts once the video shows its first frame
+    --- 
+    --- @param size number|false
+    --- @param lookahead? number
+    video.setFrameCache = function(v, size, lookahead)
+        v._frameCache = size and {size = size, lookahead = lookahead} or false
+        if not v._rendered then
+            return
+        end
+        size = size or 0
+        lookahead = lookahead or 2
+        libvlcWrapper.luavlc_frame_cache_configure(v._luaVlcVideo, size * 1024 * 1024,
+            lookahead > 0 and v._diskPath or nil, lookahead * 1000.0)
+    end
+    --- Steps `frames` frames forwards or backwards (1 by default, negative goes back), pause the video first
+    --- 
+    --- Cached frames show up right away, anything else gets decoded (and shows up a bit later)
+    --- @return boolean cached whether every step came out of the frame cache
+    video.stepFrame = function(v, frames)
+        frames = frames or 1
+        local direction = frames < 0 and -1 or 1
+        local cached = true
+        for _ = 1, math.abs(frames) do
+            if libvlcWrapper.luavlc_frame_cache_step(v._luaVlcVideo, direction) < 0 then
+                cached = false
+                break
+            end
+        end
+        statusFrame = -1
+        return cached
+    end
+    --- Shows the frame at `time` (in seconds) out of the frame cache, or seeks to it if it isn't cached
+    --- (or the video isn't paused, the cache only gets used while it is)
+    --- @return boolean cached
+    video.showFrame = function(v, time)
+        statusFrame = -1
+        if libvlcWrapper.luavlc_frame_cache_show(v._luaVlcVideo, time * 1000.0) >= 0 then
+            return true
+        end
+        v:seek(time)
+        return false
+    end
+    --- Returns `{hits, misses, hitRate, evictions, captured, lookahead, frames, bytes, budget, frameDuration}`,
+    --- or nil if the frame cache is off. `captured`/`lookahead` count frames stored from playback/the lookahead worker
+    video.getFrameCacheStats = function(v)
+        local stats = ffi.new("LuaVLC_FrameCacheStats")
+        if not libvlcWrapper.luavlc_frame_cache_stats(v._luaVlcVideo, stats) then
+            return nil
+        end
+        local lookups = tonumber(stats.hits + stats.misses)
+        return {
+            hits = tonumber(stats.hits), misses = tonumber(stats.misses),
+            hitRate = lookups > 0 and tonumber(stats.hits) / lookups or 0,
+            evictions = tonumber(stats.evictions), captured = tonumber(stats.captured), lookahead = tonumber(stats.lookahead),
+            frames = stats.frames, bytes = tonumber(stats.bytes), budget = tonumber(stats.budget),
+            frameDuration = stats.frameMs / 1000
+        }
+    end
+    --- 
+    --- Compares every new frame with the last one (on VLC's thread, in bands of 16 rows) and only uploads
+    --- the rows that changed, or nothing at all when the frame is the same. Made for screencasts, slideshows
+    --- and UI recordings, where most of the picture stays put. It costs a copy of the frame and a compare per frame,
+    --- so leave it off for regular footage where everything changes anyway. Doesn't do anything for atlas videos
+    --- 
+    --- Can also be set up front with `settings.partialUpload = true`
+    --- 
+    --- @param enabled boolean
+    video.setPartialUpload = function(v, enabled)
+        v._partialUpload = enabled and not v._cell
+        if not v._rendered then
+            return
+        end
+        libvlcWrapper.luavlc_dirty_configure(v._luaVlcVideo, v._partialUpload)
+        if not v._partialUpload then
+            releaseStaging(v)
+        end
+    end
+    --- 
+    --- Uploads frames thru a ring of persistently mapped pixel buffers instead of `replacePixels`: a worker thread
+    --- copies each frame in, and the main thread only queues the texture update, which the GPU does on its own time.
+    --- Worth it for big (1440p, 4K) videos where `replacePixels` takes milliseconds of every frame
+    --- 
+    --- Falls back to regular uploads (and returns false) where it can't work, see `lovevlc.hasAsyncUpload`.
+    --- Takes priority over partial uploads, doesn't do anything for atlas videos.
+    --- Can also be set up front with `settings.asyncUpload = true`
+    --- 
+    --- @param enabled boolean
+    --- @return boolean active
+    video.setAsyncUpload = function(v, enabled)
+        v._asyncUpload = enabled
+        if v._pbo ~= nil and not enabled then
+            libvlcWrapper.luavlc_pbo_destroy(v._pbo)
+            v._pbo = nil
+        end
+        if not v._rendered or not enabled or v._pbo ~= nil then
+            return v._pbo ~= nil
+        end
+        if v._cell or not lovevlc.hasAsyncUpload() then
+            return false
+        end
+        -- 0 when the name can't be confirmed, which pbo_create turns down
+        local pbo = libvlcWrapper.luavlc_pbo_create(v._luaVlcVideo, boundTexture(v.image))
+        v._pbo = pbo ~= nil and pbo or nil
+        return v._pbo ~= nil
+    end
+    --- 
+    --- Frame rate conversion, for 24/25/30 fps videos on 60/120/144 Hz screens where showing the newest frame judders.
+    --- `"pick"` queues frames with when they're due and shows the one for the moment being drawn, so the cadence stays even.
+    --- `"blend"` also mixes in the next frame by how close to it that moment is, for smooth motion at the cost of
+    --- a second texture read per pixel (the shader replaces yours for that draw). Both show the picture one frame
+    --- late (so audio runs ahead by that much), and take over from partial and async uploads.
+    --- Pass `false` (or `"off"`) to go back to the newest frame. Doesn't do anything for atlas videos
+    --- 
+    --- Can also be set up front with `settings.frameRateConversion = "blend"`
+    --- 
+    --- @param mode "pick"|"blend"|"off"|false
+    --- @return boolean active
+    video.setFrameRateConversion = function(v, mode)
+        v._frcMode = FRC_MODES[mode] and mode or nil
+        if not v._rendered then
+            return v._frcMode ~= nil
+        end
+        if not v._frcMode or v._cell then
+            stopFrameQueue(v)
+            v._frcShown = nil
+            -- the texture stopped getting frames while the queue was on
+            v._frameSequence = -1
+            return false
+        end
+        if not v._frc then
+            startFrameQueue(v)
+        end
+        return true
+    end
+    --- 
+    --- Same as `libvlc_video_set_adjust_int`/`_float`, but done in a shader when the video gets drawn instead of by VLC's
+    --- adjust filter on every decoded frame, so it doesn't cost any CPU and changing it never stalls playback.
+    --- `option` is one of `"enable"`, `"contrast"` (0 to 2), `"brightness"` (0 to 2), `"hue"` (-180 to 180 degrees),
+    --- `"saturation"` (0 to 3) or `"gamma"` (0.01 to 10), or the matching `libvlc_video_adjust_option_t` value.
+    --- Nothing changes until `"enable"` is set to 1. The shader replaces yours for the draw
+    --- 
+    --- @param option string|integer
+    --- @param value number
+    video.setAdjustFloat = function(v, option, value)
+        v._adjust[filterOption(ADJUST_OPTIONS, option)] = value
+    end
+    video.setAdjustInt = function(v, option, value)
+        v._adjust[filterOption(ADJUST_OPTIONS, option)] = math.floor(value)
+    end
+    video.getAdjustFloat = function(v, option)
+        return v._adjust[filterOption(ADJUST_OPTIONS, option)]
+    end
+    video.getAdjustInt = function(v, option)
+        return math.floor(v._adjust[filterOption(ADJUST_OPTIONS, option)])
+    end
+    --- 
+    --- Same as `libvlc_video_set_logo_int`/`_string`, drawn over the video (in its pixels, with the same transform)
+    --- instead of blended in by VLC. Options are `"enable"`, `"file"` (`"file,delay,alpha;file,delay,alpha;..."`, thru
+    --- love's filesystem or a regular path), `"x"`, `"y"`, `"delay"` (ms per image), `"repeat"` (-1 forever),
+    --- `"opacity"` (0 to 255) and `"position"` (1 left, 2 right, 4 top, 8 bottom, added up, or -1 for `x`/`y`),
+    --- or the matching `libvlc_video_logo_option_t` value. Not drawn when the video is drawn with a quad
+    --- 
+    --- @param option string|integer
+    --- @param value integer
+    video.setLogoInt = function(v, option, value)
+        option = filterOption(LOGO_OPTIONS, option)
+        if option == "file" then
+            error("file is a string option", 2)
+        end
+        if option == "enable" and value ~= 0 and v._logo.enable == 0 then
+            v._logo.started = love.timer.getTime()
+        end
+        v._logo[option] = math.floor(value)
+    end
+    video.getLogoInt = function(v, option)
+        option = filterOption(LOGO_OPTIONS, option)
+        if option == "file" then
+            error("file is a string option", 2)
+        end
+        return v._logo[option]
+    end
+    --- @param option string|integer
+    --- @param value string
+    video.setLogoString = function(v, option, value)
+        if filterOption(LOGO_OPTIONS, option) ~= "file" then
+            error("only file is a string option", 2)
+        end
+        v._logo.file = value
+        loadLogo(v._logo, value)
+    end
+    --- 
+    --- Same as `libvlc_video_set_marquee_int`/`_string`, drawn over the video like the logo. Options are `"enable"`,
+    --- `"text"` (run thru `os.date` like VLC runs it thru strftime, every `"refresh"` ms), `"color"` (0xRRGGBB),
+    --- `"opacity"` (0 to 255), `"position"`, `"size"` (in pixels, 0 picks one from the video's height), `"timeout"`
+    --- (ms until it hides, 0 for never), `"x"` and `"y"`, or the matching `libvlc_video_marquee_option_t` value
+    --- 
+    --- @param option string|integer
+    --- @param value integer
+    video.setMarqueeInt = function(v, option, value)
+        option = filterOption(MARQUEE_OPTIONS, option)
+        if option == "text" then
+            error("text is a string option", 2)
+        end
+        if option == "enable" and value ~= 0 and v._marquee.enable == 0 then
+            v._marquee.started = love.timer.getTime()
+        end
+        v._marquee[option] = math.floor(value)
+    end
+    video.getMarqueeInt = function(v, option)
+        option = filterOption(MARQUEE_OPTIONS, option)
+        if option == "text" then
+            error("text is a string option", 2)
+        end
+        return v._marquee[option]
+    end
+    --- @param option string|integer
+    --- @param value string
+    video.setMarqueeString = function(v, option, value)
+        if filterOption(MARQUEE_OPTIONS, option) ~= "text" then
+            error("only text is a string option", 2)
+        end
+        v._marquee.text = value
+        v._marquee.expanded = nil
+        v._marquee.started = love.timer.getTime()
+    end
+    --- Returns how frame rate conversion is going, or nil when it's off: `frames` that came in, `presents` (draws),
+    --- `blended` and `repeats` (the same frame drawn again on its own), `skipped` frames that never got shown,
+    --- `underruns` (frames that were late), `cuts` (seeks and stalls, never blended across), the measured `frameTime`,
+    --- `judder` (the standard deviation of how far the picture drawn is from where it should be in time, both in ms)
+    --- and the average `blendWeight` of the second frame
+    --- @return table? stats
+    video.getFrameRateStats = function(v)
+        local stats = ffi.new("LuaVLC_FrcStats")
+        if not libvlcWrapper.luavlc_frc_stats(v._luaVlcVideo, stats) then
+            return nil
+        end
+        return {
+            frames = tonumber(stats.frames), presents = tonumber(stats.presents), blended = tonumber(stats.blended),
+            repeats = tonumber(stats.repeats), skipped = tonumber(stats.skipped), underruns = tonumber(stats.underruns),
+            cuts = tonumber(stats.cuts), frameTime = stats.frameMs, judder = stats.judderMs, blendWeight = stats.blendWeight
+        }
+    end
+    --- 
+    --- Deinterlaces in a shader when the video gets drawn, instead of with VLC's CPU deinterlace filters, which get
+    --- turned off for this video. Same shape as `libvlc_video_set_deinterlace`: `state` is -1 for only frames that
+    --- look interlaced (see `video:getFieldInfo`), 0 for off and 1 for every frame. `mode` is `"blend"` (mixes the
+    --- fields), `"bob"` (repeats each field's rows), `"linear"` (interpolates them), `"yadif"` (edge directed, and
+    --- keeps still parts of the picture sharp) or `"yadif2x"`, the default. bob, linear and yadif2x show each field on
+    --- its own, at twice the frame rate. The shader replaces yours for the draw, doesn't do anything for atlas videos.
+    --- With libvlc 3.0 turning it off leaves VLC's deinterlacing off too, 4.0 goes back to deciding by itself
+    --- 
+    --- Can also be set up front with `settings.deinterlace = mode` (or `true`), which is the same as `state` -1
+    --- 
+    --- @param state integer|boolean
+    --- @param mode? "blend"|"bob"|"linear"|"yadif"|"yadif2x"
+    video.setDeinterlace = function(v, state, mode)
+        if type(state) == "boolean" then
+            state = state and 1 or 0
+        end
+        if mode ~= nil and not DEINTERLACE_MODES[mode] then
+            error("unknown deinterlace mode " .. tostring(mode), 2)
+        end
+        v._deinterlaceMode = mode or v._deinterlaceMode
+        if (state ~= 0) ~= (v._deinterlace ~= 0) then
+            -- frames have to come in with both fields still woven together
+            libvlcWrapper.luavlc_video_set_deinterlace(v._mediaPlayer, state ~= 0 and 0 or -1, nil)
+        end
+        v._deinterlace = state
+        if v._rendered and not v._cell then
+            libvlcWrapper.luavlc_fields_configure(v._luaVlcVideo, state ~= 0)
+        end
+        if state == 0 or DEINTERLACE_MODES[v._deinterlaceMode] ~= 4 then
+            releasePreviousFrame(v)
+        end
+    end
+    --- Which field gets treated as coming first: `"top"`, `"bottom"` or `"auto"` (the default) to go by what was detected
+    --- @param order "auto"|"top"|"bottom"
+    video.setFieldOrder = function(v, order)
+        v._fieldOrder = order
+    end
+    --- Returns what the interlace detection made of the current frame, or nil when deinterlacing is off:
+    --- its `frame` number, `combing` (the fraction of pixels that looked combed), whether it's `interlaced`
+    --- (combed, or was in the last 60 frames), the detected `fieldOrder` (`"top"` or `"bottom"` first) and how sure it
+    --- is (`orderConfidence`, 0 to 1), the measured `frameTime` in ms and the `field` being shown right now
+    --- @return table? info
+    video.getFieldInfo = function(v)
+        local info = ffi.new("LuaVLC_FieldInfo")
+        if not libvlcWrapper.luavlc_fields_info(v._luaVlcVideo, info) then
+            return nil
+        end
+        local _, field = deinterlaceState(v)
+        return {
+            frame = info.frameSequence, combing = info.combing, interlaced = info.interlaced ~= 0,
+            fieldOrder = info.topFieldFirst ~= 0 and "top" or "bottom", orderConfidence = info.orderConfidence,
+            frameTime = info.frameMs, field = field and (field == 0 and "top" or "bottom") or nil
+        }
+    end
+    --- Returns how frames got uploaded: `full`, `partial`, `skipped` (identical) and `async` upload counts and the `bytes` sent.
+    --- With partial uploads on it also has `frames`, `identical` and `changed` (the fraction of rows that changed)
+    --- from the compare on VLC's side. With async uploads on, `copied`/`dropped` frames on the worker and the
+    --- average `copyTime` (worker) and `submitTime` (main thread) per frame, in ms
+    --- @return table stats
+    video.getUploadStats = function(v)
+        local out = {
+            full = v._uploadStats.full, partial = v._uploadStats.partial, skipped = v._uploadStats.skipped,
+            async = v._uploadStats.async, bytes = v._uploadStats.bytes
+        }
+        local stats = ffi.new("LuaVLC_DirtyStats")
+        if libvlcWrapper.luavlc_dirty_stats(v._luaVlcVideo, stats) then
+            out.frames, out.identical = tonumber(stats.frames), tonumber(stats.identical)
+            out.changed = stats.totalRows > 0 and tonumber(stats.dirtyRows) / tonumber(stats.totalRows) or 0
+        end
+        local pboStats = ffi.new("LuaVLC_PboStats")
+        if v._pbo ~= nil and libvlcWrapper.luavlc_pbo_stats(v._pbo, pboStats) then
+            local copied, uploaded = tonumber(pboStats.copied), tonumber(pboStats.uploaded)
+            out.copied, out.dropped = copied, tonumber(pboStats.dropped)
+            out.copyTime = copied > 0 and pboStats.copyMs / copied or 0
+            out.submitTime = uploaded > 0 and pboStats.submitMs / uploaded or 0
+        end
+        return out
     end
-    video.seek = function(v, time)
-        libvlc.libvlc_media_player_set_time(v._mediaPlayer, time * 1000.0)
+    --- Returns how long seeks took to show their first frame (in ms), split into `fast` and `precise`
+    --- (each `{count, last, average, max}`), how many scrub seeks were `coalesced` away, and the
+    --- state of the keyframe index (`"none"`, `"building"`, `"ready"` or `"failed"`) and its size
+    --- @return table stats
+    video.getSeekStats = function(v)
+        local stats = ffi.new("LuaVLC_SeekStats")
+        libvlcWrapper.luavlc_video_seek_stats(v._luaVlcVideo, stats)
+        local function mode(i)
+            local count = stats.count[i]
+            return {
+                count = count, last = stats.lastMs[i], max = stats.maxMs[i],
+                average = count > 0 and stats.totalMs[i] / count or 0
+            }
+        end
+        return {
+            precise = mode(SEEK_PRECISE), fast = mode(SEEK_FAST), coalesced = stats.coalesced,
+            keyframeIndex = KEYFRAME_INDEX_STATUSES[stats.keyframeIndex], keyframes = stats.keyframes
+        }
     end
     video.release = function(v)
         -- kill the media player
         libvlc.libvlc_media_player_stop(v._mediaPlayer)
         libvlc.libvlc_media_player_release(v._mediaPlayer)
 
-        -- free luavlc audio struct stuff
-        libvlcWrapper.luavlc_audio_free_ptr(v._luaVlcAudio)
+        -- the async upload stream, its gl objects only go away with luavlc_pbo_destroy
+        -- (it stays valid after luavlc_free_ptr, but this way its memory is taken off the video's count too)
+        if v._pbo ~= nil then
+            libvlcWrapper.luavlc_pbo_destroy(v._pbo)
+            v._pbo = nil
+        end
 
-        -- free love2d resources
+        -- free love2d resources, before the video struct since they count their memory towards it
+        -- (releaseStaging calls luavlc_memory_track on it)
+        stopFrameQueue(v)
+        v._frcShown = nil
+        loadLogo(v._logo, "")
+        releasePreviousFrame(v)
+        v._rendered = false
+        releaseStaging(v)
+        if v._cell then
+            v._atlas:_free(v._cell)
+            v._cell = nil
+        end
         if v.imageData then
             v.imageData:release()
             v.imageData = nil
@@ -271,64 +2447,502 @@ love.graphics.newVideo = function(filename, settings)
             v.image:release()
             v.image = nil
         end
+        v._data = nil
+
+        -- free luavlc audio & video struct stuff
+        -- (audio first, it counts its memory towards the video)
+        libvlcWrapper.luavlc_audio_free_ptr(v._luaVlcAudio)
+        libvlcWrapper.luavlc_free_ptr(v._luaVlcVideo)
+        -- the player is stopped and released, nothing decodes into it anymore
+        if v._pixelBuffer then
+            libvlcWrapper.luavlc_free_pixel_buffer(v._pixelBuffer)
+            v._pixelBuffer = nil
+        end
         table.remove(vids, table.indexOf(vids, v))
+        statusFrame = -1
     end
-    video.getWidth = function(v)
-        if not v.imageData then
-            return 1
+    --- 
+    --- Returns a copy of the current frame as a new `love.ImageData`, or nil before the video has one.
+    --- Works the same whether or not the video keeps its own `video.imageData` (see `settings.keepImageData`),
+    --- the copy belongs to the caller. VLC might be writing the next frame into it at the same time, so expect
+    --- torn frames from a video that's playing
+    --- 
+    --- @return love.ImageData?
+    video.getImageData = function(v)
+        local ctx = v._luaVlcVideo
+        if not v._rendered or ctx.pixelBuffer == nil then
+            return nil
+        end
+        local w, h = v._width, v._height
+        local imageData = love.image.newImageData(w, h, "rgba8")
+        local out = ffi.cast("unsigned char*", imageData:getFFIPointer())
+        local pitch = ctx.pitch > 0 and ctx.pitch or w * 4
+        if pitch == w * 4 then
+            ffi.copy(out, ctx.pixelBuffer, w * h * 4)
+        else
+            for y = 0, h - 1 do
+                ffi.copy(out + y * w * 4, ctx.pixelBuffer + y * pitch, w * 4)
+            end
         end
-        return v.imageData:getWidth()
+        return imageData
+    end
+    video.getWidth = function(v)
+        return v._width or 1
     end
     video.getHeight = function(v)
-        if not v.imageData then
-            return 1
-        end
-        return v.imageData:getHeight()
+        return v._height or 1
     end
     video.getDimensions = function(v)
         return video.getWidth(v), video.getHeight(v)
     end
+    --- Returns how much memory (in bytes) this video is using, see `lovevlc.getMemoryStats`
+    --- @return table stats
+    video.getMemoryUsage = function(v)
+        local stats = ffi.new("LuaVLC_MemoryStats")
+        local list = ffi.new("LuaVLC_Video*[1]", v._luaVlcVideo)
+        libvlcWrapper.luavlc_memory_query(list, 1, stats, nil)
+        return memoryStatsToTable(stats)
+    end
+    --- Returns how the read-ahead thread is doing, or `nil` if the video wasn't made with `settings.prefetch`
+    --- 
+    --- `hits`/`stalls` count reads that were/weren't ready yet, `throughput` is in bytes per second
+    video.getPrefetchStats = function(v)
+        local stats = ffi.new("LuaVLC_PrefetchStats")
+        if not libvlcWrapper.luavlc_video_prefetch_stats(v._luaVlcVideo, stats) then
+            return nil
+        end
+        local reads = tonumber(stats.hits + stats.stalls)
+        return {
+            hits = tonumber(stats.hits), stalls = tonumber(stats.stalls), stallTime = stats.stallMs / 1000,
+            hitRate = reads > 0 and tonumber(stats.hits) / reads or 0,
+            fetched = tonumber(stats.fetchedBytes), dropped = tonumber(stats.droppedBytes), seeks = tonumber(stats.seeks),
+            buffered = tonumber(stats.bufferedBytes), window = tonumber(stats.windowBytes),
+            throughput = stats.throughput
+        }
+    end
     video.getSource = function(v)
         return video._fakeSource
     end
-    video.draw = function(v, ...)
+    --- marks the video as drawn (at `area` pixels) for the scheduler, sets up its texture once it's playing
+    --- and uploads new frames. Returns the texture to draw (and the quad inside of it for atlas videos), or nil.
+    --- With frame blending it also returns a second texture to mix over the first and how much of it
+    --- @protected
+    video._present = function(v, area)
+        local ctx = v._luaVlcVideo
+        ctx.presentedArea = area
+        ctx.presentCount = ctx.presentCount + 1
+
+        local status = v:getStatus()
         if not v._rendered then
-            local state = libvlc.libvlc_media_player_get_state(v._mediaPlayer)
-            if state == 3 then -- 3 = playing
-                local cw, ch = ffi.new("unsigned int[1]"), ffi.new("unsigned int[1]")
-                libvlc.libvlc_video_get_size(v._mediaPlayer, 0, cw, ch)
-                
-                local w, h = tonumber(cw[0]), tonumber(ch[0])
+            if status.state == 3 then -- 3 = playing
+                local w, h = status.width, status.height
                 if w > 0 and h > 0 then
-                    v._luaVlcVideo.width = cw[0]
-                    v._luaVlcVideo.height = ch[0]
+                    local cell = v._atlas and v._atlas:_allocate(v, w, h)
+                    if cell then
+                        -- vlc writes straight into the atlas, one row of the atlas apart
+                        w, h = cell.width, cell.height
+                        ctx.pixelBuffer = cell.pointer
+                        ctx.pitch = cell.pitch
+                        libvlc.libvlc_video_set_format(v._mediaPlayer, "RGBA", w, h, cell.pitch)
+                        v._cell = cell
+                    else
+                        -- didn't fit, it gets a texture of its own
+                        v._atlas = nil
+                        libvlc.libvlc_video_set_format(v._mediaPlayer, "RGBA", w, h, w * 4)
+                        local buffer = not v._keepImageData and libvlcWrapper.luavlc_new_pixel_buffer(w, h)
+                        if buffer and buffer ~= nil then
+                            ffi.fill(buffer, w * h * 4)
+                            v._pixelBuffer = buffer
+                            ctx.pixelBuffer = buffer
+                            v.image = love.graphics.newTexture(w, h, {format = "rgba8"})
+                        else
+                            v.imageData = love.image.newImageData(w, h, "rgba8")
+                            ctx.pixelBuffer = v.imageData:getFFIPointer()
+                            v.image = love.graphics.newImage(v.imageData)
+                        end
 
-                    libvlc.libvlc_video_set_format(v._mediaPlayer, "RGBA", w, h, w * 4)
-                    v.imageData = love.image.newImageData(w, h, "rgba8")
-                    v._luaVlcVideo.pixelBuffer = v.imageData:getFFIPointer()
+                        -- whatever is still counted when the video gets released is given back by luavlc_free_ptr
+                        libvlcWrapper.luavlc_memory_track(ctx, MEMORY.frame, w * h * 4)
+                        libvlcWrapper.luavlc_memory_track(ctx, MEMORY.texture, w * h * 4)
+                    end
+                    ctx.width = w
+                    ctx.height = h
+                    v._width, v._height = w, h
 
-                    libvlcWrapper.video_use_all_callbacks(v._mediaPlayer, ffi.cast("void*", v._luaVlcVideo.pixelBuffer))
-                    
-                    v.image = love.graphics.newImage(v.imageData)
+                    libvlcWrapper.video_use_all_callbacks(v._mediaPlayer, ctx)
+                    v._frameSequence = status.frameSequence
                     v._rendered = true
+
+                    if not v.imageData and not v._cell then
+                        -- a new texture isn't cleared, so it starts out as the (blank) buffer like an ImageData would
+                        uploadFull(v)
+                    end
+                    if v._partialUpload then
+                        v:setPartialUpload(true)
+                    end
+                    if v._asyncUpload then
+                        v:setAsyncUpload(true)
+                    end
+                    if v._frcMode then
+                        v:setFrameRateConversion(v._frcMode)
+                    end
+                    if v._deinterlace ~= 0 then
+                        libvlcWrapper.luavlc_fields_configure(ctx, true)
+                    end
+                    local frameCache = v._frameCache
+                    if frameCache then
+                        if type(frameCache) == "number" then
+                            frameCache = {size = frameCache}
+                        end
+                        v:setFrameCache(frameCache.size or 64, frameCache.lookahead)
+                    end
+                end
+            end
+        elseif v._cell then
+            v._atlas:_upload()
+        elseif v._frc then
+            v._frameSequence = status.frameSequence
+            if libvlcWrapper.luavlc_frc_pick(ctx, v._frcMode == "blend", frcPick) then
+                local first = frameQueueImage(v, frcPick.first, frcPick.firstSerial)
+                v._frcShown = first
+                if frcPick.second >= 0 then
+                    return first, nil, frameQueueImage(v, frcPick.second, frcPick.secondSerial), frcPick.weight
                 end
+                return first
             end
+            -- nothing queued yet since it got turned on
+            return v._frcShown or v.image
+        elseif v._pbo ~= nil then
+            -- a frame can finish copying any time after vlc showed it, so this gets asked every draw
+            if status.frameSequence ~= v._frameSequence then
+                keepPreviousFrame(v)
+            end
+            love.graphics.flushBatch()
+            if libvlcWrapper.luavlc_pbo_upload(v._pbo) then
+                v._uploadStats.async = v._uploadStats.async + 1
+                v._uploadStats.bytes = v._uploadStats.bytes + v._width * v._height * 4
+            end
+            v._frameSequence = status.frameSequence
         else
-            local state = libvlc.libvlc_media_player_get_state(v._mediaPlayer)
-            if state == 3 and libvlcWrapper.can_update_texture() and v.imageData then
+            -- paused counts too, for seeks and frame steps
+            if (status.state == 3 or status.state == 4) and status.frameSequence ~= v._frameSequence and v.image then
                 -- we don't need to update the pixels here since
-                -- we passed the ffi pointer to them directly to vlc
-                v.image:replacePixels(v.imageData)
+                -- we passed the pointer to them directly to vlc
+                v._frameSequence = status.frameSequence
+                keepPreviousFrame(v)
+                uploadFrame(v)
             end
-            libvlc.libvlc_audio_set_volume(v._mediaPlayer, v._volume * 100)
         end
-        if v.image then
-            love.graphics.draw(v.image, ...)
+        if v._cell then
+            return v._atlas.image, v._cell.quad
+        end
+        return v.image
+    end
+    video.draw = function(v, ...)
+        -- lets the scheduler know this video is still being looked at, and how big it is
+        local first, _, _, sx, sy = ...
+        if first ~= nil and type(first) ~= "number" then
+            sx, sy = 1, 1 -- drawn with a transform or quad, just assume its full size
+        end
+        sx = sx or 1
+        sy = sy or sx
+        local image, quad, blend, weight = v:_present(math.abs(v:getWidth() * sx * v:getHeight() * sy))
+        if not image then
+            return
+        end
+        -- replaces whatever shader is set for this one draw
+        local shader = videoShaderFor(v, image, blend, weight)
+        local previous = shader and love.graphics.getShader()
+        if shader then
+            love.graphics.setShader(shader)
+        end
+        if quad then
+            love.graphics.draw(image, quad, ...)
+        else
+            love.graphics.draw(image, ...)
+        end
+        if shader then
+            love.graphics.setShader(previous)
+        end
+        if v._logo.enable ~= 0 or v._marquee.enable ~= 0 then
+            drawOverlays(v, ...)
         end
     end
+    if settings.deinterlace then
+        video:setDeinterlace(-1, settings.deinterlace ~= true and settings.deinterlace or nil)
+    end
     return video
 end
 
+--- 
+--- Opens a video archive (`.lvpk`) made by the export tool (see `VIDEO_ARCHIVES` in `commands/export/export_settings.lua`)
+--- 
+--- Every clip inside gets played straight out of one shared memory mapping of the archive,
+--- so opening a clip is just an index lookup instead of a file open
+--- 
+--- Archives need to be real files on disk, they can't be inside of the `.love`/fused executable
+--- 
+--- @param path string
+--- @return table? archive, string? error
+function lovevlc.openArchive(path)
+    if not fileExists(path) then
+        local dir = love.filesystem.getRealDirectory(path)
+        if dir and fileExists(dir .. "/" .. path) then
+            path = dir .. "/" .. path
+        end
+    end
+    local handle = libvlcWrapper.luavlc_archive_open(path)
+    if handle == nil then
+        return nil, "Couldn't open video archive " .. path .. ", it's either missing or not a valid archive"
+    end
+
+    local archive = {path = path, _archive = handle}
+
+    --- Returns every clip in the archive as `{name, codec, offset, size}`
+    function archive:getEntries()
+        local entries = {}
+        if self._archive == nil then
+            return entries
+        end
+        local entry = ffi.new("LuaVLC_ArchiveEntry")
+        for i = 0, libvlcWrapper.luavlc_archive_count(self._archive) - 1 do
+            libvlcWrapper.luavlc_archive_entry(self._archive, i, entry)
+            entries[#entries + 1] = {
+                name = ffi.string(entry.name), codec = ffi.string(entry.codec),
+                offset = tonumber(entry.offset), size = tonumber(entry.length)
+            }
+        end
+        return entries
+    end
+
+    --- @param name string
+    --- @return boolean
+    function archive:hasEntry(name)
+        return self._archive ~= nil and libvlcWrapper.luavlc_archive_find(self._archive, name, ffi.new("LuaVLC_ArchiveEntry"))
+    end
+
+    --- Same as `love.graphics.newVideo`, but plays the clip called `name` out of the archive
+    --- @param name string
+    --- @param settings? table
+    function archive:newVideo(name, settings)
+        if type(settings) == "boolean" then
+            settings = {audio = settings}
+        end
+        -- newVideo copies it again, this one just keeps the archive off the caller's table
+        local copy = {archive = self}
+        for k, v in pairs(settings or {}) do
+            if k ~= "archive" then
+                copy[k] = v
+            end
+        end
+        return love.graphics.newVideo(name, copy)
+    end
+
+    --- Closes the archive, videos already made from it keep working until they're released
+    function archive:close()
+        if self._archive ~= nil then
+            libvlcWrapper.luavlc_archive_close(self._archive)
+            self._archive = nil
+        end
+    end
+
+    return archive
+end
+
+-- gap between atlas cells, so linear filtering doesn't bleed the neighbours in
+local ATLAS_PADDING = 2
+
+--- 
+--- Creates a `width` x `height` atlas texture that lots of small videos (store grids, previews, walls of screens)
+--- decode into side by side. VLC writes each video's frames straight into its cell, and the whole atlas gets
+--- uploaded once per frame instead of once per video, then they can all be drawn in a single draw call
+--- 
+--- Make videos with `atlas:newVideo(filename, settings)`, `settings.width`/`settings.height` shrink them to fit
+--- (keeping the aspect ratio) which is usually what you want for previews. Each frame `atlas:clear()`, then
+--- `atlas:add(video, x, y, r, sx, sy, ...)` the ones on screen and `atlas:draw()`. `video:draw(...)` still works
+--- (and LÖVE batches it anyway when nothing else gets drawn in between)
+--- 
+--- Videos that don't fit anymore get a texture of their own, like any other video.
+--- `settings.sprites` is how many videos the sprite batch starts out with room for (64 by default)
+--- 
+--- @param width integer
+--- @param height integer
+--- @param settings? {sprites: integer?}
+--- @return table atlas
+function lovevlc.newAtlas(width, height, settings)
+    settings = settings or {}
+    local atlas = {
+        width = width, height = height,
+        imageData = love.image.newImageData(width, height, "rgba8"), image = nil, --- @type love.Image
+        _shelves = {}, _nextY = 0, _freeCells = {}, _videos = {},
+        _uploadFrame = -1, _uploads = 0, _dirty = false
+    }
+    atlas.image = love.graphics.newImage(atlas.imageData)
+    atlas._pointer = ffi.cast("unsigned char*", atlas.imageData:getFFIPointer())
+    atlas._batch = love.graphics.newSpriteBatch(atlas.image, settings.sprites or 64, "stream")
+    libvlcWrapper.luavlc_memory_track(nil, MEMORY.frame, width * height * 4)
+    libvlcWrapper.luavlc_memory_track(nil, MEMORY.texture, width * height * 4)
+
+    -- shelf packing, freed cells get reused by anything that fits in them
+    --- @protected
+    function atlas:_allocate(video, w, h)
+        local maxWidth, maxHeight = video._atlasWidth, video._atlasHeight
+        if maxWidth or maxHeight then
+            local scale = math.min(maxWidth and maxWidth / w or math.huge, maxHeight and maxHeight / h or math.huge, 1)
+            w, h = math.max(math.floor(w * scale + 0.5), 1), math.max(math.floor(h * scale + 0.5), 1)
+        end
+        local slotWidth, slotHeight = w + ATLAS_PADDING, h + ATLAS_PADDING
+
+        local x, y
+        local best
+        for i, free in ipairs(self._freeCells) do
+            if free.width >= slotWidth and free.height >= slotHeight and (not best or free.width * free.height < self._freeCells[best].width * self._freeCells[best].height) then
+                best = i
+            end
+        end
+        if best then
+            local free = table.remove(self._freeCells, best)
+            x, y, slotWidth, slotHeight = free.x, free.y, free.width, free.height
+        else
+            for _, shelf in ipairs(self._shelves) do
+                if shelf.height >= slotHeight and shelf.x + slotWidth <= self.width then
+                    x, y = shelf.x, shelf.y
+                    shelf.x = shelf.x + slotWidth
+                    slotHeight = shelf.height
+                    break
+                end
+            end
+            if not x then
+                if self._nextY + slotHeight > self.height or slotWidth > self.width then
+                    return nil
+                end
+                local shelf = {x = slotWidth, y = self._nextY, height = slotHeight}
+                self._shelves[#self._shelves + 1] = shelf
+                self._nextY = self._nextY + slotHeight
+                x, y = 0, shelf.y
+            end
+        end
+
+        self._videos[video] = true
+        return {
+            x = x, y = y, width = w, height = h, slotWidth = slotWidth, slotHeight = slotHeight,
+            pointer = self._pointer + (y * self.width + x) * 4, pitch = self.width * 4,
+            quad = love.graphics.newQuad(x, y, w, h, self.width, self.height)
+        }
+    end
+
+    --- @protected
+    function atlas:_free(cell)
+        for row = 0, cell.height - 1 do
+            ffi.fill(cell.pointer + row * cell.pitch, cell.width * 4, 0)
+        end
+        cell.quad:release()
+        self._freeCells[#self._freeCells + 1] = {x = cell.x, y = cell.y, width = cell.slotWidth, height = cell.slotHeight}
+        for video in pairs(self._videos) do
+            if video._cell == cell then
+                self._videos[video] = nil
+            end
+        end
+        self._dirty = true
+    end
+
+    -- one upload for every video that got a new frame, at most once per frame
+    --- @protected
+    function atlas:_upload()
+        if self._uploadFrame == frameIndex then
+            return
+        end
+        self._uploadFrame = frameIndex
+        local dirty = self._dirty
+        for video in pairs(self._videos) do
+            local status = video:getStatus()
+            if (status.state == 3 or status.state == 4) and status.frameSequence ~= video._frameSequence then
+                video._frameSequence = status.frameSequence
+                dirty = true
+            end
+        end
+        if dirty then
+            self.image:replacePixels(self.imageData)
+            self._dirty = false
+            self._uploads = self._uploads + 1
+        end
+    end
+
+    --- Same as `love.graphics.newVideo`, but the video decodes into this atlas.
+    --- `settings.width`/`settings.height` are the most space it gets in it
+    --- @param filename string
+    --- @param settings? table
+    function atlas:newVideo(filename, settings)
+        if type(settings) == "boolean" then
+            settings = {audio = settings}
+        end
+        -- same as archive:newVideo, keeps the atlas off the caller's table
+        local copy = {atlas = self}
+        for k, v in pairs(settings or {}) do
+            if k ~= "atlas" then
+                copy[k] = v
+            end
+        end
+        local video = love.graphics.newVideo(filename, copy)
+        video._atlasWidth, video._atlasHeight = copy.width, copy.height
+        return video
+    end
+
+    --- Adds `video` to the sprite batch with the usual draw arguments (`x, y, r, sx, sy, ox, oy, kx, ky`),
+    --- videos that aren't showing anything yet (or ended up outside of the atlas) get skipped
+    --- @return integer? id
+    function atlas:add(video, x, y, r, sx, sy, ...)
+        sx = sx or 1
+        sy = sy or sx
+        local _, quad = video:_present(math.abs(video:getWidth() * sx * video:getHeight() * sy))
+        if quad and video._atlas == self then
+            return self._batch:add(quad, x or 0, y or 0, r or 0, sx, sy, ...)
+        end
+    end
+
+    function atlas:clear()
+        self._batch:clear()
+    end
+
+    --- Uploads new frames and draws everything added since `atlas:clear()`
+    function atlas:draw(...)
+        self:_upload()
+        love.graphics.draw(self._batch, ...)
+    end
+
+    function atlas:getImage()
+        return self.image
+    end
+
+    function atlas:getSpriteBatch()
+        return self._batch
+    end
+
+    --- Returns `{videos, uploads, used}`, `used` is how much of the atlas is taken up (0 - 1)
+    function atlas:getStats()
+        local videos, used = 0, 0
+        for video in pairs(self._videos) do
+            videos = videos + 1
+            used = used + video._cell.slotWidth * video._cell.slotHeight
+        end
+        return {videos = videos, uploads = self._uploads, used = used / (self.width * self.height)}
+    end
+
+    --- Releases the atlas and every video still in it
+    function atlas:release()
+        for video in pairs(self._videos) do
+            video:release()
+        end
+        self._batch:release()
+        self.image:release()
+        self.imageData:release()
+        libvlcWrapper.luavlc_memory_track(nil, MEMORY.frame, -self.width * self.height * 4)
+        libvlcWrapper.luavlc_memory_track(nil, MEMORY.texture, -self.width * self.height * 4)
+    end
+
+    return atlas
+end
+
 -- override love.graphics.draw so you can directly draw vlc videos
 -- as if they were a native Love2D video
 
@@ -346,4 +2960,6 @@ love.audio.stop = function()
         vids[i]:stop()
     end
     return audioStop()
-end
\ No newline at end of file
+end
+
+return lovevlc
\ No newline at end of file
@@ -1,7 +1,58 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <intrin.h>
+#else
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if __linux__
+#include <sys/vfs.h>
+#endif
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define LUAVLC_AESNI 1
+#include <wmmintrin.h>
+#if !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LUAVLC_SSE2 1
+#include <emmintrin.h>
+#endif
+
 #include "AL/al.h"
 #include "AL/alc.h"
 #include "AL/alext.h"
@@ -17,11 +68,183 @@ extern "C" {
     #define EXPORT_DLL 
     #endif
 
+    // what memory_track counts bytes as, keep in sync with MEMORY_CATEGORIES in init.lua
+    enum {
+        LUAVLC_MEM_FRAME = 0, // cpu-side frame vlc decodes into (ImageData or wrapper-owned)
+        LUAVLC_MEM_TEXTURE, // gpu texture the frame gets uploaded to, reported by lua
+        LUAVLC_MEM_AUDIO_RING, // audio queued on the openal source that hasn't been played yet
+        LUAVLC_MEM_AUDIO_BUFFERS, // everything held by the openal buffers
+        LUAVLC_MEM_PICTURE_POOL, // estimate of vlc's own decoded picture pool
+        LUAVLC_MEM_SOURCE, // buffers owned by media sources (read buffers, read-ahead, etc)
+        LUAVLC_MEM_FRAME_CACHE, // decoded frames kept around the playhead for stepping back
+        LUAVLC_MEM_COUNT
+    };
+
+    typedef struct {
+        int64_t current[LUAVLC_MEM_COUNT];
+        int64_t peak[LUAVLC_MEM_COUNT];
+        int64_t total;
+        int64_t totalPeak;
+    } LuaVLC_MemoryStats;
+
+    // the atomic version of the above, written from vlc's threads
+    typedef struct {
+        std::atomic<int64_t> current[LUAVLC_MEM_COUNT];
+        std::atomic<int64_t> peak[LUAVLC_MEM_COUNT];
+        std::atomic<int64_t> total;
+        std::atomic<int64_t> totalPeak;
+    } LuaVLC_MemoryCounters;
+
+    // what the decode scheduler does with a video that hasn't been drawn for a while
+    enum {
+        LUAVLC_IDLE_NONE = 0, // keep decoding like normal
+        LUAVLC_IDLE_PAUSE = 1, // pause it, resumes where it left off
+        LUAVLC_IDLE_KEYFRAME = 2, // pause it, but keep fast-seeking (keyframes only) to where it would've been,
+                                  // on 3.0 that needs a keyframe index, without one it's the same as pausing
+        LUAVLC_IDLE_AUDIO_ONLY = 3 // stop decoding video but keep the audio going
+    };
+
+    struct LuaVLC_Source;
+    struct LuaVLC_KeyframeIndex;
+    struct LuaVLC_FrameCache;
+    struct LuaVLC_DirtyTracker;
+    struct LuaVLC_PboStream;
+    struct LuaVLC_FrameQueue;
+    struct LuaVLC_FieldDetector;
+
+    enum {
+        LUAVLC_SEEK_PRECISE = 0, // lands exactly where it was asked to, decoding from the keyframe before it
+        LUAVLC_SEEK_FAST = 1, // lands on the nearest keyframe
+        LUAVLC_SEEK_MODES
+    };
+
+    // how long seeks take to show their first frame, per LUAVLC_SEEK_* mode
+    typedef struct {
+        unsigned int count[LUAVLC_SEEK_MODES];
+        double lastMs[LUAVLC_SEEK_MODES];
+        double totalMs[LUAVLC_SEEK_MODES];
+        double maxMs[LUAVLC_SEEK_MODES];
+        unsigned int coalesced; // scrub seeks that got dropped because a newer one came in first
+        int keyframeIndex; // LUAVLC_KEYFRAMES_*
+        unsigned int keyframes;
+    } LuaVLC_SeekStats;
+
     typedef struct {
+        // these are shared with lua (see the cdef in init.lua), keep them first and in this order
         unsigned char* pixelBuffer = nullptr;
         unsigned int width = 0;
         unsigned int height = 0;
+        unsigned int pitch = 0; // bytes per row of pixelBuffer, more than width * 4 when it's a cell of an atlas
+        float volume = 1.0f;
+        float presentedArea = 0.0f; // on-screen area of the last draw, in pixels
+        unsigned int presentCount = 0; // bumped by lua every time the video gets drawn
+        int wantPlaying = 0; // whether or not the user wants this playing, the scheduler never resumes anything else
+        int idleMode = -1; // LUAVLC_IDLE_*, or -1 to use the scheduler's default
+
+        // everything below is only touched from C
+        libvlc_media_player_t* mediaPlayer = nullptr;
+        libvlc_media_t* media = nullptr;
+        LuaVLC_Source* source = nullptr; // only for media made with luavlc_media_new_source
+
+        std::atomic<unsigned int> frameSequence{0};
+        std::atomic<float> buffering{0.0f};
+
+        int lastState = -1;
+        float appliedVolume = -1.0f;
+        unsigned int droppedFrames = 0;
+        unsigned int videoWidth = 0;
+        unsigned int videoHeight = 0;
+        double lastStatsTime = 0.0;
+
+        unsigned int seenPresentCount = 0;
+        double lastPresentedTime = -1.0;
+        int idle = LUAVLC_IDLE_NONE; // which idle mode the scheduler put this in, if any
+        double idleMediaTime = 0.0; // for LUAVLC_IDLE_KEYFRAME
+        double idleStartTime = 0.0;
+        double lastKeyframeSeek = 0.0;
+        double idleKeyframe = -1.0; // the keyframe LUAVLC_IDLE_KEYFRAME last went to
+        std::string videoTrackId; // for LUAVLC_IDLE_AUDIO_ONLY on libvlc 4.0
+        int videoTrack = -1; // same as above but for libvlc 3.0
+
+        std::shared_ptr<LuaVLC_KeyframeIndex> keyframes; // see luavlc_video_index_keyframes
+        std::atomic<int> seekPending{-1}; // mode of the last seek, until its first frame gets displayed
+        std::atomic<bool> stepPending{false}; // next_frame was called, until its frame gets displayed
+        std::atomic<double> seekStartMs{0.0};
+        double scrubTarget = -1.0; // where the last scrub seek went
+        double scrubDeferred = -1.0; // where to scrub to once the pending seek lands, -1 if nowhere
+        std::mutex seekMutex; // for seekStats, display_cb writes to it
+        LuaVLC_SeekStats seekStats = {};
+        std::shared_ptr<LuaVLC_FrameCache> frameCache; // see luavlc_frame_cache_configure
+        std::shared_ptr<LuaVLC_DirtyTracker> dirty; // see luavlc_dirty_configure
+        std::shared_ptr<LuaVLC_PboStream> pbo; // see luavlc_pbo_create
+        std::shared_ptr<LuaVLC_FrameQueue> frameQueue; // see luavlc_frc_configure
+        std::shared_ptr<LuaVLC_FieldDetector> fields; // see luavlc_fields_configure
+
+        LuaVLC_MemoryCounters memory = {};
     } LuaVLC_Video;
+
+    static void memory_track(LuaVLC_Video* video, int category, int64_t delta);
+    static void probe_shutdown();
+    static void thumbnail_shutdown();
+    static void keyframes_shutdown();
+    static void bake_shutdown();
+    static void compress_shutdown();
+    static void frame_cache_shutdown();
+    static void seek_finished(LuaVLC_Video* video, int mode);
+    static void scrub_flush(LuaVLC_Video* video, double now);
+    static double keyframe_nearest(LuaVLC_Video* video, double timeMs);
+    static void frame_cache_capture(LuaVLC_Video* video);
+    static void frame_cache_anchor(LuaVLC_Video* video, double timeMs);
+    static void frame_cache_stop(LuaVLC_Video* video);
+    static void dirty_track(LuaVLC_Video* video);
+    static void pbo_frame(LuaVLC_Video* video);
+    static void pbo_detach(LuaVLC_Video* video);
+    static void pbo_shutdown();
+    static void frc_push(LuaVLC_Video* video, bool cut);
+    static void frc_detach(LuaVLC_Video* video);
+    static void fields_track(LuaVLC_Video* video);
+
+    // one open instance of a media source, vlc can open the same media more than once
+    struct LuaVLC_Reader {
+        virtual ~LuaVLC_Reader() {}
+
+        // returns how many bytes were read (can be less than length), 0 at the end of the stream or -1 on error
+        virtual ptrdiff_t read(unsigned char* buffer, size_t length) = 0;
+        virtual int seek(uint64_t offset) = 0;
+    };
+
+    // where a libvlc_media_new_callbacks media gets its bytes from (physfs, mmap, memory, etc)
+    // it belongs to the video it's attached to and gets freed after that video's media
+    struct LuaVLC_Source {
+        LuaVLC_Video* owner = nullptr; // for memory accounting, can be NULL
+        bool network = false; // lives on a network share, picks :network-caching over :file-caching
+
+        virtual ~LuaVLC_Source() {}
+
+        // size should be left as UINT64_MAX if it isn't known, returns NULL on failure
+        virtual LuaVLC_Reader* open(uint64_t* size) = 0;
+    };
+
+    // filled in by luavlc_players_update, once per player per frame
+    typedef struct {
+        unsigned int frameSequence; // goes up every time vlc finishes a frame
+        int state;
+        double time; // in seconds
+        double length; // in seconds
+        unsigned int width;
+        unsigned int height;
+        float buffering; // 0 - 100
+        unsigned int droppedFrames;
+        int idle; // LUAVLC_IDLE_* the scheduler put the video in
+    } LuaVLC_PlayerStatus;
+
+    // only what lua needs out of libvlc_media_stats_t, which isn't laid out the same in 3.0 and 4.0
+    typedef struct {
+        uint64_t readBytes;
+        float inputBitrate;
+        uint64_t displayedPictures;
+        uint64_t lostPictures;
+    } LuaVLC_MediaStats;
     
     typedef struct {
         ALuint source = 0;
@@ -32,9 +255,22 @@ extern "C" {
         ALenum format = 0;
         unsigned sampleRate = 0;
         unsigned int frameSize = 0;
+
+        void* owner = nullptr; // the LuaVLC_Video this belongs to, for memory accounting
+        int64_t queuedBytes = 0; // in buffers on the source's queue, played or not
+        int64_t bufferBytes = 0;
+        int64_t ringBytes = 0; // last unplayed amount counted as LUAVLC_MEM_AUDIO_RING
     } LuaVLC_Audio;
 
-    static libvlc_instance_t* _instance = nullptr;
+    typedef struct {
+        double newMs = 0.0; // time spent inside libvlc_new (plugin bank load or scan)
+        double warmupMs = 0.0;
+        double totalMs = 0.0;
+        int success = 0;
+    } LuaVLC_InitTimings;
+
+    // written by the async init thread and read everywhere else, so it's published atomically
+    static std::atomic<libvlc_instance_t*> _instance{nullptr};
 
     static const int MAX_BUFFER_COUNT = 255;
     static bool _can_update_texture = false;
@@ -42,11 +278,200 @@ extern "C" {
     static int _alUseEXTFLOAT32 = -1;
     static int _alUseEXTMCFORMATS = -1;
 
+    // 0 = not started, 1 = loading, 2 = ready, -1 = failed
+    static std::atomic<int> _instance_state{0};
+    static std::thread _init_thread;
+    static LuaVLC_InitTimings _init_timings;
+
+    // the headers in include/ are from libvlc 4.0, but the libvlc we ship (and most distros have) is 3.0,
+    // anything that changed signature between the two has to go through these
+    static int luavlc_vlc_major() {
+        static int major = -1;
+        if(major == -1)
+            major = atoi(libvlc_get_version());
+        return major;
+    }
+
+    static libvlc_media_t* luavlc_media_new_path(const char* path) {
+        typedef libvlc_media_t* (*new_path_v3)(libvlc_instance_t*, const char*);
+        if(luavlc_vlc_major() < 4)
+            return ((new_path_v3)(void*)&libvlc_media_new_path)(_instance, path);
+        return libvlc_media_new_path(path);
+    }
+
+    // for functions that only exist in one of the two versions, linking to them directly
+    // would make the wrapper fail to load on the other one
+    static void* luavlc_vlc_symbol(const char* name) {
+    #if _WIN32
+        HMODULE module = GetModuleHandleA("libvlc.dll");
+        return module != NULL ? (void*)GetProcAddress(module, name) : NULL;
+    #else
+        static void* handle = nullptr;
+        if(handle == nullptr) {
+            Dl_info info;
+            if(dladdr((void*)&libvlc_new, &info) != 0 && info.dli_fname != NULL)
+                handle = dlopen(info.dli_fname, RTLD_LAZY | RTLD_NOLOAD);
+        }
+        return handle != nullptr ? dlsym(handle, name) : NULL;
+    #endif
+    }
+
+    // fast seeks only land on keyframes, 3.0 can't do that per call (it needs the :input-fast-seek media option)
+    static void luavlc_media_player_set_time(libvlc_media_player_t* mp, libvlc_time_t time, bool fast) {
+        typedef void (*set_time_v3)(libvlc_media_player_t*, libvlc_time_t);
+        if(luavlc_vlc_major() < 4)
+            ((set_time_v3)(void*)&libvlc_media_player_set_time)(mp, time);
+        else
+            libvlc_media_player_set_time(mp, time, fast);
+    }
+
+    static libvlc_media_player_t* luavlc_media_player_new_from_media(libvlc_media_t* media) {
+        typedef libvlc_media_player_t* (*new_from_media_v3)(libvlc_media_t*);
+        if(luavlc_vlc_major() < 4)
+            return ((new_from_media_v3)(void*)&libvlc_media_player_new_from_media)(media);
+        return libvlc_media_player_new_from_media(_instance, media);
+    }
+
+    static bool luavlc_media_get_stats(libvlc_media_t* media, LuaVLC_MediaStats* stats) {
+        if(luavlc_vlc_major() < 4) {
+            struct {
+                int i_read_bytes;
+                float f_input_bitrate;
+                int i_demux_read_bytes;
+                float f_demux_bitrate;
+                int i_demux_corrupted;
+                int i_demux_discontinuity;
+                int i_decoded_video;
+                int i_decoded_audio;
+                int i_displayed_pictures;
+                int i_lost_pictures;
+                int i_played_abuffers;
+                int i_lost_abuffers;
+                int i_sent_packets;
+                int i_sent_bytes;
+                float f_send_bitrate;
+            } v3 = {0};
+            typedef bool (*get_stats_v3)(libvlc_media_t*, void*);
+            if(!((get_stats_v3)(void*)&libvlc_media_get_stats)(media, &v3))
+                return false;
+            stats->readBytes = (uint64_t)v3.i_read_bytes;
+            stats->inputBitrate = v3.f_input_bitrate;
+            stats->displayedPictures = (uint64_t)v3.i_displayed_pictures;
+            stats->lostPictures = (uint64_t)v3.i_lost_pictures;
+            return true;
+        }
+        libvlc_media_stats_t v4;
+        if(!libvlc_media_get_stats(media, &v4))
+            return false;
+        stats->readBytes = v4.i_read_bytes;
+        stats->inputBitrate = v4.f_input_bitrate;
+        stats->displayedPictures = v4.i_displayed_pictures;
+        stats->lostPictures = v4.i_lost_pictures + v4.i_late_pictures;
+        return true;
+    }
+
+    static double luavlc_now_ms() {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration<double, std::milli>(now).count();
+    }
+
+    // same as luavlc_init_vlc, but also reports how long the instance took to create
+    // so startup options (plugin cache, module allow-list) can actually be measured
+    EXPORT_DLL void luavlc_init_vlc_timed(int argc, const char *const *argv, LuaVLC_InitTimings* timings) {
+        double start = luavlc_now_ms();
+        double newTime = 0.0;
+        // an async init that's still going gets waited for instead of racing it, its instance is used if it worked
+        if(_init_thread.joinable())
+            _init_thread.join();
+        if(_instance == nullptr) {
+            _instance = libvlc_new(argc, argv);
+            newTime = luavlc_now_ms() - start;
+        }
+        if(timings != NULL && timings != nullptr) {
+            timings->newMs = newTime;
+            timings->warmupMs = 0.0;
+            timings->totalMs = luavlc_now_ms() - start;
+            timings->success = _instance != nullptr ? 1 : 0;
+        }
+        _instance_state.store(_instance != nullptr ? 2 : -1, std::memory_order_release);
+    }
+
     EXPORT_DLL void luavlc_init_vlc(int argc, const char *const *argv) {
-        if(_instance != nullptr)
+        luavlc_init_vlc_timed(argc, argv, NULL);
+    }
+
+    // plays a short clip with no outputs until it's decoding, so the demux/decoder
+    // plugins it needs are already loaded (vlc keeps them mapped) before the first real video
+    static void warmup_vlc(const char* path) {
+        libvlc_media_t* media = luavlc_media_new_path(path);
+        if(media == NULL || media == nullptr)
+            return;
+
+        libvlc_media_player_t* mp = luavlc_media_player_new_from_media(media);
+        libvlc_media_release(media);
+        if(mp == NULL || mp == nullptr)
             return;
 
-        _instance = libvlc_new(argc, argv);
+        libvlc_media_player_play(mp);
+        double start = luavlc_now_ms();
+        while(luavlc_now_ms() - start < 3000.0) {
+            libvlc_state_t state = libvlc_media_player_get_state(mp);
+            if(state == libvlc_Error || (state == libvlc_Playing && libvlc_media_player_get_time(mp) > 0))
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        libvlc_media_player_release(mp);
+    }
+
+    // builds the instance on a native thread, poll luavlc_vlc_state to know when it's done
+    // argv is copied so the caller doesn't have to keep it alive. a failed init (-1) can be retried,
+    // returns false if it's already loading or loaded, luavlc_vlc_state says which
+    EXPORT_DLL bool luavlc_init_vlc_async(int argc, const char *const *argv, const char* warmupPath) {
+        int expected = 0;
+        if(!_instance_state.compare_exchange_strong(expected, 1) && (expected != -1 || !_instance_state.compare_exchange_strong(expected, 1)))
+            return false;
+
+        if(_init_thread.joinable())
+            _init_thread.join();
+
+        std::vector<std::string> args(argv, argv + argc);
+        std::string warmup = warmupPath != NULL ? warmupPath : "";
+
+        _init_thread = std::thread([args, warmup]() {
+            std::vector<const char*> argPtrs;
+            for(const std::string& arg : args)
+                argPtrs.push_back(arg.c_str());
+
+            double start = luavlc_now_ms();
+            LuaVLC_InitTimings timings;
+            if(_instance == nullptr) {
+                libvlc_instance_t* instance = libvlc_new((int)argPtrs.size(), argPtrs.data());
+                _instance.store(instance, std::memory_order_release);
+                timings.newMs = luavlc_now_ms() - start;
+            }
+            if(_instance != nullptr && !warmup.empty()) {
+                double warmupStart = luavlc_now_ms();
+                warmup_vlc(warmup.c_str());
+                timings.warmupMs = luavlc_now_ms() - warmupStart;
+            }
+            timings.totalMs = luavlc_now_ms() - start;
+            timings.success = _instance != nullptr ? 1 : 0;
+            _init_timings = timings;
+
+            _instance_state.store(_instance != nullptr ? 2 : -1, std::memory_order_release);
+        });
+        return true;
+    }
+
+    // cheap enough to call every frame
+    EXPORT_DLL int luavlc_vlc_state(void) {
+        return _instance_state.load(std::memory_order_acquire);
+    }
+
+    // only valid once luavlc_vlc_state returns 2 or -1
+    EXPORT_DLL void luavlc_get_init_timings(LuaVLC_InitTimings* timings) {
+        if(timings != NULL && timings != nullptr)
+            *timings = _init_timings;
     }
 
     EXPORT_DLL libvlc_instance_t* luavlc_get_vlc_instance() {
@@ -54,15 +479,76 @@ extern "C" {
     }
 
     EXPORT_DLL void luavlc_free_vlc() {
-        if(_instance != nullptr) {
-            libvlc_release(_instance);
-            _instance = nullptr;
+        if(_init_thread.joinable())
+            _init_thread.join();
+        probe_shutdown();
+        thumbnail_shutdown();
+        keyframes_shutdown();
+        bake_shutdown();
+        compress_shutdown();
+        frame_cache_shutdown();
+        pbo_shutdown();
+
+        libvlc_instance_t* instance = _instance.exchange(nullptr);
+        if(instance != nullptr)
+            libvlc_release(instance);
+        _instance_state.store(0, std::memory_order_release);
+    }
+
+    static LuaVLC_MemoryCounters _memory = {};
+
+    // roughly how many decoded pictures vlc keeps around per video (decoder references + display queue)
+    static const int ESTIMATED_POOL_PICTURES = 12;
+
+    static void memory_counters_add(LuaVLC_MemoryCounters* counters, int category, int64_t delta) {
+        int64_t value = counters->current[category].fetch_add(delta) + delta;
+        int64_t peak = counters->peak[category].load();
+        while(value > peak && !counters->peak[category].compare_exchange_weak(peak, value)) {}
+
+        int64_t total = counters->total.fetch_add(delta) + delta;
+        int64_t totalPeak = counters->totalPeak.load();
+        while(total > totalPeak && !counters->totalPeak.compare_exchange_weak(totalPeak, total)) {}
+    }
+
+    static void memory_counters_read(LuaVLC_MemoryCounters* counters, LuaVLC_MemoryStats* out) {
+        for(int i = 0; i < LUAVLC_MEM_COUNT; i++) {
+            out->current[i] = counters->current[i].load();
+            out->peak[i] = counters->peak[i].load();
+        }
+        out->total = counters->total.load();
+        out->totalPeak = counters->totalPeak.load();
+    }
+
+    // counts bytes towards a video (can be NULL) and the global total
+    static void memory_track(LuaVLC_Video* video, int category, int64_t delta) {
+        if(delta == 0 || category < 0 || category >= LUAVLC_MEM_COUNT)
+            return;
+        if(video != NULL && video != nullptr)
+            memory_counters_add(&video->memory, category, delta);
+        memory_counters_add(&_memory, category, delta);
+    }
+
+    // for memory that lua allocates itself (ImageData, Image, etc)
+    EXPORT_DLL void luavlc_memory_track(LuaVLC_Video* video, int category, int64_t delta) {
+        memory_track(video, category, delta);
+    }
+
+    // fills perVideo[i] for every video (perVideo can be NULL) and global (can also be NULL) in one go
+    EXPORT_DLL void luavlc_memory_query(LuaVLC_Video** videos, int count, LuaVLC_MemoryStats* perVideo, LuaVLC_MemoryStats* global) {
+        if(perVideo != NULL && perVideo != nullptr) {
+            for(int i = 0; i < count; i++) {
+                if(videos[i] != NULL && videos[i] != nullptr)
+                    memory_counters_read(&videos[i]->memory, &perVideo[i]);
+                else
+                    memset(&perVideo[i], 0, sizeof(LuaVLC_MemoryStats));
+            }
         }
+        if(global != NULL && global != nullptr)
+            memory_counters_read(&_memory, global);
     }
 
-    EXPORT_DLL LuaVLC_Video luavlc_new() {
-        LuaVLC_Video video = {0};
-        return video;
+    EXPORT_DLL LuaVLC_Video* luavlc_new_ptr() {
+        return new LuaVLC_Video();
     }
 
     EXPORT_DLL LuaVLC_Audio* luavlc_audio_new_ptr() {
@@ -80,199 +566,5938 @@ extern "C" {
             free((void*)pixelBuffer);
     }
 
-    EXPORT_DLL void luavlc_free(LuaVLC_Video video) {
-        if(video.pixelBuffer != NULL && video.pixelBuffer != nullptr) {
-            luavlc_free_pixel_buffer(video.pixelBuffer);
-            video.pixelBuffer = NULL;
-        }
+    // the pixel buffer belongs to whoever set it (usually a love ImageData), so it isn't freed here
+    // call this after the media player has been released
+    EXPORT_DLL void luavlc_free_ptr(LuaVLC_Video* video) {
+        if(video == NULL || video == nullptr)
+            return;
+        if(video->media != nullptr)
+            libvlc_media_release(video->media);
+        if(video->source != nullptr)
+            delete video->source;
+        frame_cache_stop(video);
+        pbo_detach(video);
+        frc_detach(video);
+        for(int i = 0; i < LUAVLC_MEM_COUNT; i++)
+            memory_track(NULL, i, -video->memory.current[i].load());
+        delete video;
     }
 
     EXPORT_DLL void luavlc_audio_free_ptr(LuaVLC_Audio* audio) {
         if (audio == NULL || audio == nullptr)
             return;
+        memory_track((LuaVLC_Video*)audio->owner, LUAVLC_MEM_AUDIO_RING, -audio->ringBytes);
+        memory_track((LuaVLC_Video*)audio->owner, LUAVLC_MEM_AUDIO_BUFFERS, -audio->bufferBytes);
         alDeleteSources(1, &audio->source);
         alDeleteBuffers(audio->bufferCount, audio->buffers);
         free((void*)audio->buffers);
         free((void*)audio);
     }
 
-    // i can't write this or unlock_cb function in lua code
-    // because (in the context of love2d atleast) it causes a segfault after running a few times
-    // so i have to write it here in C land
-    void *lock_cb(void *opaque, void **planes) {
-        *planes = opaque;
-        _can_update_texture = false;
-        return NULL;
+    static int source_open_cb(void *opaque, void **datap, uint64_t *sizep) {
+        LuaVLC_Source* source = (LuaVLC_Source*)opaque;
+        *sizep = UINT64_MAX;
+        LuaVLC_Reader* reader = source->open(sizep);
+        *datap = reader;
+        return reader != nullptr ? 0 : -1;
     }
 
-    void display_cb(void *opaque, void *picture) {
-        _can_update_texture = true;
+    static ptrdiff_t source_read_cb(void *opaque, unsigned char *buf, size_t len) {
+        return ((LuaVLC_Reader*)opaque)->read(buf, len);
     }
 
-    EXPORT_DLL bool can_update_texture(void) {
-        return _can_update_texture;
+    static int source_seek_cb(void *opaque, uint64_t offset) {
+        return ((LuaVLC_Reader*)opaque)->seek(offset);
     }
 
-    EXPORT_DLL void video_use_unlock_callback(libvlc_media_player_t *mp, void *opaque) {
-        libvlc_video_set_callbacks(mp, NULL, NULL, display_cb, opaque);
+    static void source_close_cb(void *opaque) {
+        delete (LuaVLC_Reader*)opaque;
     }
-    
-    EXPORT_DLL void video_use_all_callbacks(libvlc_media_player_t *mp, void *opaque) {
-        libvlc_video_set_callbacks(mp, lock_cb, NULL, display_cb, opaque);
+
+    // makes a media that reads thru the source, which has to outlive it (see luavlc_video_attach_source)
+    EXPORT_DLL libvlc_media_t* luavlc_media_new_source(LuaVLC_Source* source) {
+        if(source == NULL || source == nullptr)
+            return NULL;
+
+        typedef libvlc_media_t* (*new_callbacks_v3)(libvlc_instance_t*, libvlc_media_open_cb, libvlc_media_read_cb,
+            libvlc_media_seek_cb, libvlc_media_close_cb, void*);
+        if(luavlc_vlc_major() < 4)
+            return ((new_callbacks_v3)(void*)&libvlc_media_new_callbacks)(_instance, source_open_cb, source_read_cb, source_seek_cb, source_close_cb, source);
+        return libvlc_media_new_callbacks(source_open_cb, source_read_cb, source_seek_cb, source_close_cb, source);
     }
 
-    void audio_play(void *data, const void *rawSamples, unsigned count, int64_t pts) {
-        LuaVLC_Audio* audio = (LuaVLC_Audio*)data;
-        if(audio == NULL || audio == nullptr || audio->source == 0)
+    // the video takes ownership of the source, and frees it once its media is gone
+    EXPORT_DLL void luavlc_video_attach_source(LuaVLC_Video* video, LuaVLC_Source* source) {
+        if(video == NULL || video == nullptr || source == NULL || source == nullptr)
             return;
+        source->owner = video;
+        video->source = source;
+    }
 
-        ALint nb = 0;
-        bool useUnqueue = audio->bufferIndex > audio->bufferCount - 1;
-        if (!useUnqueue) {
-            audio->bufferIndex += 1;
-            nb = 1;
-        } else {
-            alGetSourcei(audio->source, AL_BUFFERS_PROCESSED, &nb);
+    // only for sources that never got attached to a video
+    EXPORT_DLL void luavlc_source_free(LuaVLC_Source* source) {
+        if(source != NULL && source != nullptr)
+            delete source;
+    }
+
+    // the bits of physfs we need, lua hands these over from love (see luavlc_physfs_bind)
+    typedef struct {
+        void* (*openRead)(const char* filename);
+        int64_t (*readBytes)(void* file, void* buffer, uint64_t length);
+        int (*seek)(void* file, uint64_t offset);
+        int64_t (*fileLength)(void* file);
+        int (*close)(void* file);
+    } LuaVLC_PhysFS;
+
+    static LuaVLC_PhysFS _physfs = {0};
+
+    // how much a physfs reader reads at once, vlc tends to ask for a few kb at a time
+    static const size_t PHYSFS_READ_SIZE = 256 * 1024;
+
+    EXPORT_DLL void luavlc_physfs_bind(const LuaVLC_PhysFS* physfs) {
+        if(physfs != NULL && physfs != nullptr)
+            _physfs = *physfs;
+    }
+
+    // reads in big chunks no matter how little vlc asks for, and seeks inside the current chunk are free
+    struct LuaVLC_PhysFSReader : LuaVLC_Reader {
+        void* file = nullptr;
+        LuaVLC_Video* owner = nullptr;
+
+        unsigned char* buffer = nullptr;
+        uint64_t bufferStart = 0; // file offset of buffer[0]
+        size_t bufferLength = 0;
+        size_t bufferPos = 0;
+
+        ~LuaVLC_PhysFSReader() {
+            _physfs.close(file);
+            free((void*)buffer);
+            memory_track(owner, LUAVLC_MEM_SOURCE, -(int64_t)PHYSFS_READ_SIZE);
         }
 
-        if(nb == 0)
-            return;
+        ptrdiff_t read(unsigned char* dest, size_t length) override {
+            if(bufferPos >= bufferLength) {
+                uint64_t position = bufferStart + bufferLength;
+                if(length >= PHYSFS_READ_SIZE) {
+                    // big enough to skip the buffer
+                    int64_t count = _physfs.readBytes(file, dest, length);
+                    if(count < 0)
+                        return -1;
+                    bufferStart = position + count;
+                    bufferLength = bufferPos = 0;
+                    return (ptrdiff_t)count;
+                }
+                int64_t count = _physfs.readBytes(file, buffer, PHYSFS_READ_SIZE);
+                if(count < 0)
+                    return -1;
+                bufferStart = position;
+                bufferLength = (size_t)count;
+                bufferPos = 0;
+                if(count == 0)
+                    return 0;
+            }
+            size_t count = std::min(length, bufferLength - bufferPos);
+            memcpy(dest, buffer + bufferPos, count);
+            bufferPos += count;
+            return (ptrdiff_t)count;
+        }
 
-        ALuint buffer;
-        if (useUnqueue) {
-            alSourceUnqueueBuffers(audio->source, 1, &buffer);
-        } else {
-            buffer = audio->buffers[audio->bufferIndex - 1];
+        int seek(uint64_t offset) override {
+            if(offset >= bufferStart && offset <= bufferStart + bufferLength) {
+                bufferPos = (size_t)(offset - bufferStart);
+                return 0;
+            }
+            if(_physfs.seek(file, offset) == 0)
+                return -1;
+            bufferStart = offset;
+            bufferLength = bufferPos = 0;
+            return 0;
         }
+    };
 
-        ALsizei size = count * audio->frameSize;
-        alBufferData(buffer, audio->format, rawSamples, size, audio->sampleRate);
-        alSourceQueueBuffers(audio->source, 1, &buffer);
+    struct LuaVLC_PhysFSSource : LuaVLC_Source {
+        std::string path;
 
-        ALint state = 0;
-        alGetSourcei(audio->source, AL_SOURCE_STATE, &state);
-        if(state != AL_PLAYING) {
-            alSourcePlay(audio->source);
+        LuaVLC_Reader* open(uint64_t* size) override {
+            void* file = _physfs.openRead(path.c_str());
+            if(file == NULL)
+                return nullptr;
+
+            LuaVLC_PhysFSReader* reader = new LuaVLC_PhysFSReader();
+            reader->file = file;
+            reader->owner = owner;
+            reader->buffer = (unsigned char*)malloc(PHYSFS_READ_SIZE);
+            memory_track(owner, LUAVLC_MEM_SOURCE, (int64_t)PHYSFS_READ_SIZE);
+
+            int64_t length = _physfs.fileLength(file);
+            if(length >= 0)
+                *size = (uint64_t)length;
+            return reader;
         }
-    }
+    };
 
-    void audio_resume(void *data, int64_t pts) {
-        LuaVLC_Audio* audio = (LuaVLC_Audio*)data;
-        if(audio == NULL || audio == nullptr || audio->source == 0)
-            return;
+    // reads a file from love.filesystem (so from inside a fused game, a mounted zip, the save directory, etc)
+    EXPORT_DLL LuaVLC_Source* luavlc_source_new_physfs(const char* path) {
+        if(_physfs.openRead == NULL || path == NULL)
+            return NULL;
 
-        ALint state = 0;
-        alGetSourcei(audio->source, AL_SOURCE_STATE, &state);
+        LuaVLC_PhysFSSource* source = new LuaVLC_PhysFSSource();
+        source->path = path;
+        return source;
+    }
 
-        if(state == AL_PAUSED || state == AL_STOPPED)
-            alSourcePlay(audio->source);
+    // files bigger than this get read with pread instead of being mapped
+    static uint64_t _mmap_limit = sizeof(void*) >= 8 ? (uint64_t)256 << 30 : (uint64_t)1 << 30;
+    // how far ahead of the read position the os is asked to have pages ready
+    static const uint64_t MMAP_WILLNEED_WINDOW = 8 << 20;
+
+    EXPORT_DLL void luavlc_mmap_set_limit(uint64_t bytes) {
+        _mmap_limit = bytes;
     }
 
-    void audio_pause(void *data, int64_t pts) {
-        LuaVLC_Audio* audio = (LuaVLC_Audio*)data;
-        if(audio == NULL || audio == nullptr || audio->source == 0)
-            return;
+    // a read-only file, mapped into memory when it fits and read with pread when it doesn't
+    // safe to read from several threads at once
+    struct LuaVLC_MappedFile {
+        const unsigned char* data = nullptr; // NULL when falling back to pread
+        uint64_t size = 0;
+    #if _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = NULL;
+    #else
+        int fd = -1;
+    #endif
 
-        ALint state;
-        alGetSourcei(audio->source, AL_SOURCE_STATE, &state);
+        ~LuaVLC_MappedFile() {
+        #if _WIN32
+            if(data != nullptr)
+                UnmapViewOfFile((LPCVOID)data);
+            if(mapping != NULL)
+                CloseHandle(mapping);
+            if(file != INVALID_HANDLE_VALUE)
+                CloseHandle(file);
+        #else
+            if(data != nullptr)
+                munmap((void*)data, (size_t)size);
+            if(fd != -1)
+                close(fd);
+        #endif
+        }
 
-        if(state != AL_PAUSED)
-            alSourcePause(audio->source);
-    }
+        bool open(const char* path, bool allowMapping = true) {
+        #if _WIN32
+            wchar_t widePath[MAX_PATH * 4];
+            if(MultiByteToWideChar(CP_UTF8, 0, path, -1, widePath, MAX_PATH * 4) == 0)
+                return false;
+            file = CreateFileW(widePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+            if(file == INVALID_HANDLE_VALUE)
+                return false;
+            LARGE_INTEGER fileSize;
+            if(!GetFileSizeEx(file, &fileSize))
+                return false;
+            size = (uint64_t)fileSize.QuadPart;
+            if(allowMapping && size > 0 && size <= _mmap_limit) {
+                mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+                if(mapping != NULL)
+                    data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            }
+        #else
+            fd = ::open(path, O_RDONLY);
+            if(fd == -1)
+                return false;
+            struct stat info;
+            if(fstat(fd, &info) != 0)
+                return false;
+            size = (uint64_t)info.st_size;
+            if(allowMapping && size > 0 && size <= _mmap_limit) {
+                void* mapped = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+                if(mapped != MAP_FAILED) {
+                    data = (const unsigned char*)mapped;
+                    madvise(mapped, (size_t)size, MADV_SEQUENTIAL);
+                }
+            }
+        #endif
+            return true;
+        }
 
-    void audio_flush(void *data, int64_t pts) {
-        LuaVLC_Audio* audio = (LuaVLC_Audio*)data;
-        if(audio == NULL || audio == nullptr || audio->source == 0)
-            return;
+        ptrdiff_t readAt(uint64_t offset, unsigned char* dest, size_t length) {
+            if(offset >= size)
+                return 0;
+            length = (size_t)std::min<uint64_t>(length, size - offset);
+            if(data != nullptr) {
+                memcpy(dest, data + offset, length);
+                return (ptrdiff_t)length;
+            }
+        #if _WIN32
+            OVERLAPPED overlapped = {0};
+            overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);
+            overlapped.OffsetHigh = (DWORD)(offset >> 32);
+            DWORD count = 0;
+            if(!ReadFile(file, dest, (DWORD)std::min<size_t>(length, 0x7FFFFFFF), &count, &overlapped))
+                return -1;
+            return (ptrdiff_t)count;
+        #else
+            ssize_t count = pread(fd, dest, length, (off_t)offset);
+            return count < 0 ? -1 : (ptrdiff_t)count;
+        #endif
+        }
 
-        ALint state;
-        alGetSourcei(audio->source, AL_SOURCE_STATE, &state);
+        // asks the os to start reading [offset, offset + length) in the background
+        void willNeed(uint64_t offset, uint64_t length) {
+            if(data == nullptr || offset >= size)
+                return;
+            length = std::min(length, size - offset);
+        #if _WIN32
+            typedef BOOL (WINAPI *prefetch_fn)(HANDLE, ULONG_PTR, PVOID, ULONG);
+            static prefetch_fn prefetch = (prefetch_fn)(void*)GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory");
+            if(prefetch != NULL) {
+                struct { PVOID address; SIZE_T size; } range = {(PVOID)(data + offset), (SIZE_T)length};
+                prefetch(GetCurrentProcess(), 1, &range, 0);
+            }
+        #else
+            static const uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+            uint64_t start = offset - offset % pageSize;
+            madvise((void*)(data + start), (size_t)(length + offset - start), MADV_WILLNEED);
+        #endif
+        }
+    };
 
-        if(state != AL_STOPPED)
-            alSourceStop(audio->source);
+    // reads a range of a mapped file, seeking is just moving the position
+    struct LuaVLC_MappedReader : LuaVLC_Reader {
+        std::shared_ptr<LuaVLC_MappedFile> file; // its own reference, the source can reopen (and remap) under it
+        uint64_t start = 0; // where the range starts in the file
+        uint64_t length = 0;
+        uint64_t position = 0;
+        uint64_t advisedUntil = 0;
+
+        ptrdiff_t read(unsigned char* dest, size_t count) override {
+            if(position >= length)
+                return 0;
+            count = (size_t)std::min<uint64_t>(count, length - position);
+            // keep the next few mb paged in, refreshed every time we get halfway thru the last window
+            if(position + MMAP_WILLNEED_WINDOW / 2 >= advisedUntil) {
+                file->willNeed(start + position, MMAP_WILLNEED_WINDOW);
+                advisedUntil = position + MMAP_WILLNEED_WINDOW;
+            }
+            ptrdiff_t result = file->readAt(start + position, dest, count);
+            if(result > 0)
+                position += (uint64_t)result;
+            return result;
+        }
+
+        int seek(uint64_t offset) override {
+            if(offset > length)
+                return -1;
+            position = offset;
+            advisedUntil = 0; // new playhead, ask for the window around it again
+            return 0;
+        }
+    };
+
+    static bool path_is_network(const char* path) {
+    #if _WIN32
+        if((path[0] == '\\' || path[0] == '/') && path[1] == path[0])
+            return true; // unc path
+        if(path[0] != 0 && path[1] == ':') {
+            char root[4] = {path[0], ':', '\\', 0};
+            return GetDriveTypeA(root) == DRIVE_REMOTE;
+        }
+        return false;
+    #elif __linux__
+        struct statfs info;
+        if(statfs(path, &info) != 0)
+            return false;
+        switch((unsigned long)info.f_type) {
+            case 0x6969: // nfs
+            case 0x517B: // smb
+            case 0xFF534D42: // cifs
+            case 0xFE534D42: // smb2
+            case 0x65735546: // fuse (sshfs and friends)
+                return true;
+        }
+        return false;
+    #else
+        return false;
+    #endif
     }
 
-    void audio_set_volume(void *data, float volume, bool mute) {
-        LuaVLC_Audio* audio = (LuaVLC_Audio*)data;
-        if(audio == NULL || audio == nullptr || audio->source == 0)
-            return;
+    // a range of a (possibly shared) mapped file, the whole file for luavlc_source_new_mmap
+    struct LuaVLC_MappedSource : LuaVLC_Source {
+        std::shared_ptr<LuaVLC_MappedFile> file;
+        uint64_t start = 0;
+        uint64_t length = 0;
 
-        alSourcef(audio->source, AL_GAIN, mute ? 0.0f : volume);
+        LuaVLC_Reader* open(uint64_t* size) override {
+            LuaVLC_MappedReader* reader = new LuaVLC_MappedReader();
+            reader->file = file;
+            reader->start = start;
+            reader->length = length;
+            *size = length;
+            return reader;
+        }
+    };
+
+    // reads a local file thru a memory mapping (or pread for files over the mmap limit)
+    EXPORT_DLL LuaVLC_Source* luavlc_source_new_mmap(const char* path) {
+        if(path == NULL || path == nullptr)
+            return NULL;
+
+        std::shared_ptr<LuaVLC_MappedFile> file = std::make_shared<LuaVLC_MappedFile>();
+        if(!file->open(path))
+            return NULL;
+
+        LuaVLC_MappedSource* source = new LuaVLC_MappedSource();
+        source->file = file;
+        source->length = file->size;
+        source->network = path_is_network(path);
+        return source;
     }
 
-    int audio_setup(void **data, char *format, unsigned *p_rate, unsigned *p_channels) {
-        LuaVLC_Audio* audio = *((LuaVLC_Audio**)data);
-        if(audio == NULL || audio == nullptr || audio->source == 0)
-            return 1;
-        
-        if(_alUseEXTFLOAT32 == -1)
-            _alUseEXTFLOAT32 = (int)alIsExtensionPresent("AL_EXT_FLOAT32");
+    // lovevlc video archive (.lvpk), written by commands/export/tools/packtools.lua
+    // everything is little endian:
+    //   "LVPK" | u32 version | u32 entry count | u32 index size
+    //   then per entry: u16 name length | name | u16 codec length | codec | u64 offset | u64 length
+    //   then the data of every entry, each one starting on a 4096 byte boundary
+    static const uint32_t ARCHIVE_VERSION = 1;
+    static const size_t ARCHIVE_HEADER_SIZE = 16;
 
-        if(_alUseEXTMCFORMATS == -1)
-            _alUseEXTMCFORMATS = (int)alIsExtensionPresent("AL_EXT_MCFORMATS");
-        
-        audio->sampleRate = *p_rate;
-        unsigned channels = *p_channels;
-        
-        if(_alUseEXTMCFORMATS == 1 && channels > 8)
-            channels = 8;
-        else if(channels > 2)
-            channels = 2;
+    typedef struct {
+        const char* name;
+        const char* codec; // container/codec hint stored by the packer, can be empty
+        uint64_t offset;
+        uint64_t length;
+    } LuaVLC_ArchiveEntry;
 
-        bool useFloat32 = _alUseEXTFLOAT32 == 1 && strcmp(format, "FL32") == 0;
-        // memcpy(format, useFloat32 ? "FL32" : "S16N", 4);
+    struct LuaVLC_ArchiveItem {
+        std::string name;
+        std::string codec;
+        uint64_t offset;
+        uint64_t length;
+    };
 
-        switch(channels) {
-            case 1:
-                audio->format = useFloat32 ? AL_FORMAT_MONO_FLOAT32 : AL_FORMAT_MONO16;
-                channels = 1;
-                break;
+    // one open archive, every clip played out of it shares the same mapping/handle
+    typedef struct {
+        std::shared_ptr<LuaVLC_MappedFile> file;
+        bool network;
+        std::vector<LuaVLC_ArchiveItem> items;
+        std::unordered_map<std::string, size_t> lookup;
+    } LuaVLC_Archive;
 
-            case 2:
-            case 3:
-                audio->format = useFloat32 ? AL_FORMAT_STEREO_FLOAT32 : AL_FORMAT_STEREO16;
-                channels = 2;
-                break;
+    static uint64_t read_le(const unsigned char* data, int bytes) {
+        uint64_t value = 0;
+        for(int i = bytes - 1; i >= 0; i--)
+            value = (value << 8) | data[i];
+        return value;
+    }
 
-            case 4:
-                audio->format = useFloat32 ? AL_FORMAT_QUAD32 : AL_FORMAT_QUAD16;
-                channels = 4;
-                break;
+    static bool archive_parse(LuaVLC_Archive* archive) {
+        LuaVLC_MappedFile* file = archive->file.get();
+        unsigned char header[ARCHIVE_HEADER_SIZE];
+        if(file->readAt(0, header, ARCHIVE_HEADER_SIZE) != (ptrdiff_t)ARCHIVE_HEADER_SIZE || memcmp(header, "LVPK", 4) != 0)
+            return false;
+        if(read_le(header + 4, 4) != ARCHIVE_VERSION)
+            return false;
 
-            case 5:
-            case 6:
-                audio->format = useFloat32 ? AL_FORMAT_51CHN32 : AL_FORMAT_51CHN16;
-                channels = 6;
-                break;
+        uint32_t count = (uint32_t)read_le(header + 8, 4);
+        uint64_t indexSize = read_le(header + 12, 4);
+        if(ARCHIVE_HEADER_SIZE + indexSize > file->size)
+            return false;
 
-            case 7:
-            case 8:
-                audio->format = useFloat32 ? AL_FORMAT_71CHN32 : AL_FORMAT_71CHN16;
-                channels = 8;
-                break;
+        std::vector<unsigned char> index((size_t)indexSize);
+        if(file->readAt(ARCHIVE_HEADER_SIZE, index.data(), index.size()) != (ptrdiff_t)index.size())
+            return false;
+
+        size_t pos = 0;
+        for(uint32_t i = 0; i < count; i++) {
+            LuaVLC_ArchiveItem item;
+            for(int field = 0; field < 2; field++) {
+                if(pos + 2 > index.size())
+                    return false;
+                size_t length = (size_t)read_le(&index[pos], 2);
+                pos += 2;
+                if(pos + length > index.size())
+                    return false;
+                (field == 0 ? item.name : item.codec).assign((const char*)&index[pos], length);
+                pos += length;
+            }
+            if(pos + 16 > index.size())
+                return false;
+            item.offset = read_le(&index[pos], 8);
+            item.length = read_le(&index[pos + 8], 8);
+            pos += 16;
+            if(item.offset > file->size || item.length > file->size - item.offset)
+                return false;
+
+            archive->lookup[item.name] = archive->items.size();
+            archive->items.push_back(item);
         }
-        audio->frameSize = (useFloat32 ? sizeof(float) : sizeof(int16_t)) * channels;
-        return 0;
+        return true;
     }
 
-    // have to pass as a void* then cast to LuaVLC_Audio* because
-    // luajit is being really strange and picky about the struct types
-    EXPORT_DLL void video_setup_audio(void* p_audio, libvlc_media_player_t *mp) {
-        LuaVLC_Audio* audio = (LuaVLC_Audio*)p_audio;
-        if (audio == NULL || audio == nullptr)
-            return;
+    EXPORT_DLL LuaVLC_Archive* luavlc_archive_open(const char* path) {
+        if(path == NULL || path == nullptr)
+            return NULL;
+
+        LuaVLC_Archive* archive = new LuaVLC_Archive();
+        archive->file = std::make_shared<LuaVLC_MappedFile>();
+        if(!archive->file->open(path) || !archive_parse(archive)) {
+            delete archive;
+            return NULL;
+        }
+        archive->network = path_is_network(path);
+        return archive;
+    }
+
+    // videos already playing out of the archive keep the file open until they're released
+    EXPORT_DLL void luavlc_archive_close(LuaVLC_Archive* archive) {
+        if(archive != NULL && archive != nullptr)
+            delete archive;
+    }
+
+    EXPORT_DLL int luavlc_archive_count(LuaVLC_Archive* archive) {
+        return (int)archive->items.size();
+    }
+
+    static void archive_fill_entry(const LuaVLC_ArchiveItem& item, LuaVLC_ArchiveEntry* out) {
+        out->name = item.name.c_str();
+        out->codec = item.codec.c_str();
+        out->offset = item.offset;
+        out->length = item.length;
+    }
+
+    // the strings in out stay valid until the archive is closed
+    EXPORT_DLL bool luavlc_archive_entry(LuaVLC_Archive* archive, int index, LuaVLC_ArchiveEntry* out) {
+        if(index < 0 || index >= (int)archive->items.size())
+            return false;
+        archive_fill_entry(archive->items[index], out);
+        return true;
+    }
+
+    EXPORT_DLL bool luavlc_archive_find(LuaVLC_Archive* archive, const char* name, LuaVLC_ArchiveEntry* out) {
+        auto it = archive->lookup.find(name);
+        if(it == archive->lookup.end())
+            return false;
+        archive_fill_entry(archive->items[it->second], out);
+        return true;
+    }
+
+    // opening a clip is just an index lookup, no files get opened
+    EXPORT_DLL LuaVLC_Source* luavlc_source_new_archive(LuaVLC_Archive* archive, const char* name) {
+        auto it = archive->lookup.find(name);
+        if(it == archive->lookup.end())
+            return NULL;
+
+        const LuaVLC_ArchiveItem& item = archive->items[it->second];
+        LuaVLC_MappedSource* source = new LuaVLC_MappedSource();
+        source->file = archive->file;
+        source->network = archive->network;
+        source->start = item.offset;
+        source->length = item.length;
+        return source;
+    }
+
+    struct LuaVLC_MemoryReader : LuaVLC_Reader {
+        const unsigned char* data = nullptr;
+        uint64_t size = 0;
+        uint64_t position = 0;
+
+        ptrdiff_t read(unsigned char* dest, size_t count) override {
+            if(position >= size)
+                return 0;
+            count = (size_t)std::min<uint64_t>(count, size - position);
+            memcpy(dest, data + position, count);
+            position += count;
+            return (ptrdiff_t)count;
+        }
+
+        int seek(uint64_t offset) override {
+            if(offset > size)
+                return -1;
+            position = offset;
+            return 0;
+        }
+    };
+
+    struct LuaVLC_MemorySource : LuaVLC_Source {
+        const unsigned char* data = nullptr;
+        uint64_t size = 0;
+
+        LuaVLC_Reader* open(uint64_t* sizep) override {
+            LuaVLC_MemoryReader* reader = new LuaVLC_MemoryReader();
+            reader->data = data;
+            reader->size = size;
+            *sizep = size;
+            return reader;
+        }
+    };
+
+    // reads from a buffer owned by the caller (a love Data or a lua string), nothing is copied
+    // the caller has to keep the buffer alive until the video using it is released
+    EXPORT_DLL LuaVLC_Source* luavlc_source_new_memory(const void* data, uint64_t size) {
+        if(data == NULL || data == nullptr)
+            return NULL;
+
+        LuaVLC_MemorySource* source = new LuaVLC_MemorySource();
+        source->data = (const unsigned char*)data;
+        source->size = size;
+        return source;
+    }
+
+    // reads a local file with plain reads, no mapping (mostly so it can be wrapped by the prefetcher)
+    EXPORT_DLL LuaVLC_Source* luavlc_source_new_file(const char* path) {
+        if(path == NULL || path == nullptr)
+            return NULL;
+
+        std::shared_ptr<LuaVLC_MappedFile> file = std::make_shared<LuaVLC_MappedFile>();
+        if(!file->open(path, false))
+            return NULL;
+
+        LuaVLC_MappedSource* source = new LuaVLC_MappedSource();
+        source->file = file;
+        source->length = file->size;
+        source->network = path_is_network(path);
+        return source;
+    }
+
+    // how much the prefetch thread asks the wrapped reader for at once
+    static const size_t PREFETCH_CHUNK = 256 << 10;
+    // suggested caching is however long it takes to pull this much at the measured throughput
+    static const double PREFETCH_CACHING_BYTES = 4 << 20;
+
+    // measured read throughput in bytes per second (0 = nothing measured yet), [0] local, [1] network
+    static std::atomic<double> _prefetch_throughput[2] = {{0.0}, {0.0}};
+
+    typedef struct {
+        uint64_t hits; // reads that were already in the window
+        uint64_t stalls; // reads that had to wait for the prefetch thread
+        double stallMs; // total time spent waiting
+        uint64_t fetchedBytes;
+        uint64_t droppedBytes; // thrown away by seeks out of the window
+        uint64_t seeks;
+        uint64_t bufferedBytes; // in the window right now
+        uint64_t windowBytes;
+        double throughput; // bytes per second, averaged
+    } LuaVLC_PrefetchStats;
+
+    struct LuaVLC_PrefetchCounters {
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> stalls{0};
+        std::atomic<double> stallMs{0.0};
+        std::atomic<uint64_t> fetchedBytes{0};
+        std::atomic<uint64_t> droppedBytes{0};
+        std::atomic<uint64_t> seeks{0};
+        std::atomic<uint64_t> bufferedBytes{0};
+        std::atomic<double> throughput{0.0};
+    };
+
+    // keeps a ring of the next windowBytes after the read position filled from its own thread,
+    // so slow disks and network shares don't block vlc's input thread on every read
+    struct LuaVLC_PrefetchReader : LuaVLC_Reader {
+        LuaVLC_Reader* inner = nullptr;
+        LuaVLC_PrefetchCounters* counters = nullptr;
+        LuaVLC_Video* owner = nullptr;
+        bool network = false;
+
+        unsigned char* ring = nullptr;
+        size_t capacity = 0;
+        size_t head = 0; // where position is in the ring
+        size_t count = 0; // bytes ready after position
+
+        uint64_t position = 0; // of the reader, [position, position + count) is in the ring
+        uint64_t generation = 0; // bumped by seeks, so the thread knows to throw its read away
+        bool needSeek = false;
+        bool eof = false;
+        bool failed = false;
+        bool stopping = false;
+
+        std::mutex mutex;
+        std::condition_variable filled;
+        std::condition_variable space;
+        std::thread thread;
+
+        void start(size_t windowBytes) {
+            capacity = std::max(windowBytes, PREFETCH_CHUNK);
+            ring = (unsigned char*)malloc(capacity);
+            memory_track(owner, LUAVLC_MEM_SOURCE, (int64_t)capacity);
+            thread = std::thread(&LuaVLC_PrefetchReader::run, this);
+        }
+
+        ~LuaVLC_PrefetchReader() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            space.notify_all();
+            if(thread.joinable())
+                thread.join();
+            delete inner;
+            free(ring);
+            memory_track(owner, LUAVLC_MEM_SOURCE, -(int64_t)capacity);
+            counters->bufferedBytes = 0;
+        }
+
+        void run() {
+            std::vector<unsigned char> chunk(PREFETCH_CHUNK);
+            std::unique_lock<std::mutex> lock(mutex);
+            while(true) {
+                space.wait(lock, [this]{ return stopping || (!eof && count < capacity); });
+                if(stopping)
+                    break;
+
+                uint64_t startGeneration = generation;
+                uint64_t from = position + count;
+                bool seekFirst = needSeek;
+                needSeek = false;
+                size_t wanted = std::min(PREFETCH_CHUNK, capacity - count);
+                lock.unlock();
+
+                ptrdiff_t got = -1;
+                double readStart = luavlc_now_ms();
+                if(!seekFirst || inner->seek(from) == 0)
+                    got = inner->read(chunk.data(), wanted);
+                double readMs = luavlc_now_ms() - readStart;
+
+                lock.lock();
+                if(startGeneration != generation)
+                    continue; // seeked while we were reading, seek() already asked for a new seek
+                if(got <= 0) {
+                    eof = true;
+                    failed = got < 0;
+                    filled.notify_all();
+                    continue;
+                }
+
+                size_t tail = (head + count) % capacity;
+                size_t first = std::min((size_t)got, capacity - tail);
+                memcpy(ring + tail, chunk.data(), first);
+                memcpy(ring, chunk.data() + first, (size_t)got - first);
+                count += (size_t)got;
+
+                counters->fetchedBytes += (uint64_t)got;
+                counters->bufferedBytes = count;
+                // only full chunks say anything about throughput, short ones are just the end of the file
+                if((size_t)got == wanted && wanted == PREFETCH_CHUNK && readMs > 0.0) {
+                    double measured = (double)got / (readMs / 1000.0);
+                    double average = counters->throughput.load();
+                    counters->throughput = average == 0.0 ? measured : average * 0.9 + measured * 0.1;
+                    double global = _prefetch_throughput[network].load();
+                    _prefetch_throughput[network] = global == 0.0 ? measured : global * 0.9 + measured * 0.1;
+                }
+                filled.notify_all();
+            }
+        }
+
+        ptrdiff_t read(unsigned char* dest, size_t length) override {
+            std::unique_lock<std::mutex> lock(mutex);
+            if(count == 0 && !eof) {
+                counters->stalls++;
+                double waitStart = luavlc_now_ms();
+                filled.wait(lock, [this]{ return count > 0 || eof; });
+                counters->stallMs = counters->stallMs.load() + (luavlc_now_ms() - waitStart);
+            } else if(count > 0) {
+                counters->hits++;
+            }
+            if(count == 0)
+                return failed ? -1 : 0;
+
+            length = std::min(length, count);
+            size_t first = std::min(length, capacity - head);
+            memcpy(dest, ring + head, first);
+            memcpy(dest + first, ring, length - first);
+            head = (head + length) % capacity;
+            count -= length;
+            position += length;
+            counters->bufferedBytes = count;
+            space.notify_one();
+            return (ptrdiff_t)length;
+        }
+
+        int seek(uint64_t offset) override {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(offset >= position && offset <= position + count) {
+                // still inside of the window, just skip ahead
+                size_t skip = (size_t)(offset - position);
+                head = (head + skip) % capacity;
+                count -= skip;
+                position = offset;
+            } else {
+                counters->seeks++;
+                counters->droppedBytes += count;
+                generation++;
+                position = offset;
+                head = count = 0;
+                eof = failed = false;
+                needSeek = true;
+            }
+            counters->bufferedBytes = count;
+            space.notify_one();
+            return 0;
+        }
+    };
+
+    struct LuaVLC_PrefetchSource : LuaVLC_Source {
+        LuaVLC_Source* inner = nullptr;
+        size_t windowBytes = 0;
+        LuaVLC_PrefetchCounters counters;
+
+        ~LuaVLC_PrefetchSource() {
+            delete inner;
+        }
+
+        LuaVLC_Reader* open(uint64_t* size) override {
+            inner->owner = owner;
+            LuaVLC_Reader* innerReader = inner->open(size);
+            if(innerReader == nullptr)
+                return nullptr;
+
+            LuaVLC_PrefetchReader* reader = new LuaVLC_PrefetchReader();
+            reader->inner = innerReader;
+            reader->counters = &counters;
+            reader->owner = owner;
+            reader->network = network;
+            reader->start(windowBytes);
+            return reader;
+        }
+    };
+
+    // wraps another source (which it takes ownership of) with a read-ahead thread
+    EXPORT_DLL LuaVLC_Source* luavlc_source_new_prefetch(LuaVLC_Source* inner, uint64_t windowBytes) {
+        if(inner == NULL || inner == nullptr)
+            return NULL;
+
+        LuaVLC_PrefetchSource* source = new LuaVLC_PrefetchSource();
+        source->inner = inner;
+        source->network = inner->network;
+        source->windowBytes = (size_t)windowBytes;
+        return source;
+    }
+
+    EXPORT_DLL bool luavlc_source_is_network(LuaVLC_Source* source) {
+        return source != NULL && source != nullptr && source->network;
+    }
+
+    // false if the video doesn't read thru a prefetch source
+    EXPORT_DLL bool luavlc_video_prefetch_stats(LuaVLC_Video* video, LuaVLC_PrefetchStats* out) {
+        LuaVLC_PrefetchSource* source = dynamic_cast<LuaVLC_PrefetchSource*>(video->source);
+        if(source == nullptr)
+            return false;
+
+        LuaVLC_PrefetchCounters& counters = source->counters;
+        out->hits = counters.hits;
+        out->stalls = counters.stalls;
+        out->stallMs = counters.stallMs;
+        out->fetchedBytes = counters.fetchedBytes;
+        out->droppedBytes = counters.droppedBytes;
+        out->seeks = counters.seeks;
+        out->bufferedBytes = counters.bufferedBytes;
+        out->windowBytes = source->windowBytes;
+        out->throughput = counters.throughput;
+        return true;
+    }
+
+    // a :file-caching/:network-caching value (in ms) that fits the throughput measured so far, 0 if nothing was measured
+    EXPORT_DLL int luavlc_prefetch_caching_ms(bool network) {
+        double throughput = _prefetch_throughput[network ? 1 : 0].load();
+        if(throughput <= 0.0)
+            return 0;
+        double ms = PREFETCH_CACHING_BYTES / throughput * 1000.0;
+        return (int)std::min(std::max(ms, 300.0), 10000.0);
+    }
+
+    // aes-ctr, the same thing as `openssl enc -aes-256-ctr -K <key> -iv <iv> -nosalt` (or -aes-128-ctr/-aes-192-ctr)
+    // the counter is the iv plus the block index as a big endian 128 bit number, so any offset can be decrypted directly
+    struct LuaVLC_AesKey {
+        unsigned char roundKeys[16 * 15];
+        uint32_t roundWords[4 * 15]; // same keys as big endian words, for the table version
+        int rounds = 0;
+        uint64_t ivHigh = 0;
+        uint64_t ivLow = 0;
+    };
+
+    // blocks of keystream made at once, aes-ni pipelines 4 of them
+    static const size_t AES_BATCH_BLOCKS = 64;
+
+    static unsigned char _aes_sbox[256];
+    static uint32_t _aes_te[4][256];
+    static std::once_flag _aes_tables_once;
+
+    static inline uint32_t aes_ror(uint32_t value, int bits) {
+        return (value >> bits) | (value << (32 - bits));
+    }
+
+    static void aes_init_tables() {
+        // walks the whole field with generator 3, and its inverse alongside it
+        unsigned char p = 1, q = 1;
+        do {
+            p = (unsigned char)(p ^ (p << 1) ^ ((p & 0x80) ? 0x1B : 0));
+            q ^= (unsigned char)(q << 1);
+            q ^= (unsigned char)(q << 2);
+            q ^= (unsigned char)(q << 4);
+            if(q & 0x80)
+                q ^= 0x09;
+            unsigned char x = (unsigned char)(q ^ (q << 1 | q >> 7) ^ (q << 2 | q >> 6) ^ (q << 3 | q >> 5) ^ (q << 4 | q >> 4));
+            _aes_sbox[p] = (unsigned char)(x ^ 0x63);
+        } while(p != 1);
+        _aes_sbox[0] = 0x63;
+
+        for(int i = 0; i < 256; i++) {
+            uint32_t s = _aes_sbox[i];
+            uint32_t s2 = ((s << 1) ^ ((s & 0x80) ? 0x1B : 0)) & 0xFF;
+            uint32_t word = (s2 << 24) | (s << 16) | (s << 8) | (s2 ^ s);
+            _aes_te[0][i] = word;
+            _aes_te[1][i] = aes_ror(word, 8);
+            _aes_te[2][i] = aes_ror(word, 16);
+            _aes_te[3][i] = aes_ror(word, 24);
+        }
+    }
+
+    static bool aes_expand_key(LuaVLC_AesKey* key, const unsigned char* bytes, int length, const unsigned char* iv) {
+        if(length != 16 && length != 24 && length != 32)
+            return false;
+        std::call_once(_aes_tables_once, aes_init_tables);
+
+        int nk = length / 4;
+        key->rounds = nk + 6;
+        int words = 4 * (key->rounds + 1);
+        uint32_t* w = key->roundWords;
+        for(int i = 0; i < nk; i++)
+            w[i] = (uint32_t)bytes[4 * i] << 24 | (uint32_t)bytes[4 * i + 1] << 16 | (uint32_t)bytes[4 * i + 2] << 8 | bytes[4 * i + 3];
+
+        uint32_t rcon = 1;
+        for(int i = nk; i < words; i++) {
+            uint32_t temp = w[i - 1];
+            if(i % nk == 0 || (nk > 6 && i % nk == 4)) {
+                if(i % nk == 0)
+                    temp = aes_ror(temp, 24);
+                temp = (uint32_t)_aes_sbox[temp >> 24] << 24 | (uint32_t)_aes_sbox[(temp >> 16) & 0xFF] << 16
+                    | (uint32_t)_aes_sbox[(temp >> 8) & 0xFF] << 8 | _aes_sbox[temp & 0xFF];
+                if(i % nk == 0) {
+                    temp ^= rcon << 24;
+                    rcon = (rcon << 1) ^ ((rcon & 0x80) ? 0x11B : 0);
+                }
+            }
+            w[i] = w[i - nk] ^ temp;
+        }
+        for(int i = 0; i < words; i++)
+            for(int b = 0; b < 4; b++)
+                key->roundKeys[4 * i + b] = (unsigned char)(w[i] >> (24 - 8 * b));
+
+        for(int i = 0; i < 8; i++) {
+            key->ivHigh = (key->ivHigh << 8) | iv[i];
+            key->ivLow = (key->ivLow << 8) | iv[8 + i];
+        }
+        return true;
+    }
+
+    // encrypts count blocks in place
+    static void aes_encrypt_portable(const LuaVLC_AesKey* key, unsigned char* blocks, size_t count) {
+        const uint32_t* rk = key->roundWords;
+        const uint32_t (*te)[256] = _aes_te;
+        for(size_t b = 0; b < count; b++) {
+            unsigned char* block = blocks + 16 * b;
+            uint32_t s[4], t[4];
+            for(int i = 0; i < 4; i++)
+                s[i] = ((uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 | (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3]) ^ rk[i];
+            for(int r = 1; r < key->rounds; r++) {
+                for(int i = 0; i < 4; i++)
+                    t[i] = te[0][s[i] >> 24] ^ te[1][(s[(i + 1) & 3] >> 16) & 0xFF] ^ te[2][(s[(i + 2) & 3] >> 8) & 0xFF] ^ te[3][s[(i + 3) & 3] & 0xFF] ^ rk[4 * r + i];
+                memcpy(s, t, sizeof(s));
+            }
+            for(int i = 0; i < 4; i++) {
+                uint32_t word = ((uint32_t)_aes_sbox[s[i] >> 24] << 24 | (uint32_t)_aes_sbox[(s[(i + 1) & 3] >> 16) & 0xFF] << 16
+                    | (uint32_t)_aes_sbox[(s[(i + 2) & 3] >> 8) & 0xFF] << 8 | _aes_sbox[s[(i + 3) & 3] & 0xFF]) ^ rk[4 * key->rounds + i];
+                block[4 * i] = (unsigned char)(word >> 24);
+                block[4 * i + 1] = (unsigned char)(word >> 16);
+                block[4 * i + 2] = (unsigned char)(word >> 8);
+                block[4 * i + 3] = (unsigned char)word;
+            }
+        }
+    }
+
+#if LUAVLC_AESNI
+#if defined(_MSC_VER)
+    #define LUAVLC_AESNI_TARGET
+#else
+    #define LUAVLC_AESNI_TARGET __attribute__((target("aes,sse2")))
+#endif
+
+    static bool aesni_supported() {
+        unsigned int regs[4] = {0};
+    #if defined(_MSC_VER)
+        __cpuid((int*)regs, 1);
+    #else
+        if(!__get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3]))
+            return false;
+    #endif
+        return (regs[2] & (1u << 25)) != 0; // ecx bit 25
+    }
+
+    LUAVLC_AESNI_TARGET static void aes_encrypt_aesni(const LuaVLC_AesKey* key, unsigned char* blocks, size_t count) {
+        __m128i rk[15];
+        for(int r = 0; r <= key->rounds; r++)
+            rk[r] = _mm_loadu_si128((const __m128i*)(key->roundKeys + 16 * r));
+
+        size_t b = 0;
+        for(; b + 4 <= count; b += 4) {
+            __m128i* out = (__m128i*)(blocks + 16 * b);
+            __m128i x0 = _mm_xor_si128(_mm_loadu_si128(out), rk[0]);
+            __m128i x1 = _mm_xor_si128(_mm_loadu_si128(out + 1), rk[0]);
+            __m128i x2 = _mm_xor_si128(_mm_loadu_si128(out + 2), rk[0]);
+            __m128i x3 = _mm_xor_si128(_mm_loadu_si128(out + 3), rk[0]);
+            for(int r = 1; r < key->rounds; r++) {
+                x0 = _mm_aesenc_si128(x0, rk[r]);
+                x1 = _mm_aesenc_si128(x1, rk[r]);
+                x2 = _mm_aesenc_si128(x2, rk[r]);
+                x3 = _mm_aesenc_si128(x3, rk[r]);
+            }
+            _mm_storeu_si128(out, _mm_aesenclast_si128(x0, rk[key->rounds]));
+            _mm_storeu_si128(out + 1, _mm_aesenclast_si128(x1, rk[key->rounds]));
+            _mm_storeu_si128(out + 2, _mm_aesenclast_si128(x2, rk[key->rounds]));
+            _mm_storeu_si128(out + 3, _mm_aesenclast_si128(x3, rk[key->rounds]));
+        }
+        for(; b < count; b++) {
+            __m128i* out = (__m128i*)(blocks + 16 * b);
+            __m128i x = _mm_xor_si128(_mm_loadu_si128(out), rk[0]);
+            for(int r = 1; r < key->rounds; r++)
+                x = _mm_aesenc_si128(x, rk[r]);
+            _mm_storeu_si128(out, _mm_aesenclast_si128(x, rk[key->rounds]));
+        }
+    }
+#endif
+
+    typedef void (*aes_encrypt_fn)(const LuaVLC_AesKey*, unsigned char*, size_t);
+
+    static aes_encrypt_fn aes_encrypt_blocks() {
+    #if LUAVLC_AESNI
+        static const aes_encrypt_fn encrypt = aesni_supported() ? aes_encrypt_aesni : aes_encrypt_portable;
+        return encrypt;
+    #else
+        return aes_encrypt_portable;
+    #endif
+    }
+
+    // whether decryption runs on aes-ni or the portable table version
+    EXPORT_DLL bool luavlc_aes_hardware(void) {
+    #if LUAVLC_AESNI
+        return aes_encrypt_blocks() == aes_encrypt_aesni;
+    #else
+        return false;
+    #endif
+    }
+
+    // xors length bytes of keystream into data, starting at byte offset of the stream
+    static void aes_ctr_xor(const LuaVLC_AesKey* key, uint64_t offset, unsigned char* data, size_t length) {
+        aes_encrypt_fn encrypt = aes_encrypt_blocks();
+        unsigned char stream[AES_BATCH_BLOCKS * 16];
+        uint64_t block = offset / 16;
+        size_t skip = (size_t)(offset % 16);
+        while(length > 0) {
+            size_t blocks = std::min(AES_BATCH_BLOCKS, (skip + length + 15) / 16);
+            for(size_t i = 0; i < blocks; i++) {
+                uint64_t low = key->ivLow + block + i;
+                uint64_t high = key->ivHigh + (low < key->ivLow ? 1 : 0);
+                for(int b = 0; b < 8; b++) {
+                    stream[16 * i + b] = (unsigned char)(high >> (56 - 8 * b));
+                    stream[16 * i + 8 + b] = (unsigned char)(low >> (56 - 8 * b));
+                }
+            }
+            encrypt(key, stream, blocks);
+
+            size_t count = std::min(length, blocks * 16 - skip);
+            for(size_t i = 0; i < count; i++)
+                data[i] ^= stream[skip + i];
+            data += count;
+            length -= count;
+            block += blocks;
+            skip = 0;
+        }
+    }
+
+    struct LuaVLC_DecryptReader : LuaVLC_Reader {
+        LuaVLC_Reader* inner = nullptr;
+        const LuaVLC_AesKey* key = nullptr;
+        uint64_t position = 0;
+
+        ~LuaVLC_DecryptReader() {
+            delete inner;
+        }
+
+        ptrdiff_t read(unsigned char* dest, size_t length) override {
+            ptrdiff_t count = inner->read(dest, length);
+            if(count > 0) {
+                aes_ctr_xor(key, position, dest, (size_t)count);
+                position += (uint64_t)count;
+            }
+            return count;
+        }
+
+        int seek(uint64_t offset) override {
+            if(inner->seek(offset) != 0)
+                return -1;
+            position = offset;
+            return 0;
+        }
+    };
+
+    struct LuaVLC_DecryptSource : LuaVLC_Source {
+        LuaVLC_Source* inner = nullptr;
+        LuaVLC_AesKey key;
+
+        ~LuaVLC_DecryptSource() {
+            delete inner;
+            // don't leave the key lying around in freed memory
+            volatile unsigned char* bytes = (volatile unsigned char*)&key;
+            for(size_t i = 0; i < sizeof(key); i++)
+                bytes[i] = 0;
+        }
+
+        LuaVLC_Reader* open(uint64_t* size) override {
+            inner->owner = owner;
+            LuaVLC_Reader* innerReader = inner->open(size);
+            if(innerReader == nullptr)
+                return nullptr;
+
+            LuaVLC_DecryptReader* reader = new LuaVLC_DecryptReader();
+            reader->inner = innerReader;
+            reader->key = &key;
+            return reader;
+        }
+    };
+
+    // wraps another source (which it takes ownership of) with aes-ctr decryption
+    // key is 16, 24 or 32 bytes, iv is always 16, returns NULL (and frees inner) if the key is the wrong size
+    EXPORT_DLL LuaVLC_Source* luavlc_source_new_aes_ctr(LuaVLC_Source* inner, const unsigned char* key, int keyLength, const unsigned char* iv) {
+        if(inner == NULL || inner == nullptr)
+            return NULL;
+
+        LuaVLC_DecryptSource* source = new LuaVLC_DecryptSource();
+        source->inner = inner;
+        source->network = inner->network;
+        if(!aes_expand_key(&source->key, key, keyLength, iv)) {
+            delete source;
+            return NULL;
+        }
+        return source;
+    }
+
+    // just enough of an http/1.0 client to stream a file, with ranges and redirects (no https)
+    // 1.0 so servers can't answer with chunked encoding
+    #if _WIN32
+    typedef SOCKET luavlc_socket;
+    static const luavlc_socket LUAVLC_NO_SOCKET = INVALID_SOCKET;
+    #define luavlc_close_socket closesocket
+    #else
+    typedef int luavlc_socket;
+    static const luavlc_socket LUAVLC_NO_SOCKET = -1;
+    #define luavlc_close_socket ::close
+    #endif
+    // a server hanging up mid-request would otherwise raise SIGPIPE and take the whole game down
+    #ifdef MSG_NOSIGNAL
+    static const int LUAVLC_SEND_FLAGS = MSG_NOSIGNAL;
+    #else
+    static const int LUAVLC_SEND_FLAGS = 0; // windows doesn't have signals, macos gets SO_NOSIGPIPE
+    #endif
+
+    static const int HTTP_MAX_REDIRECTS = 5;
+    static const int HTTP_TIMEOUT_MS = 10000;
+    static const size_t HTTP_HEADER_LIMIT = 16 << 10;
+
+    struct LuaVLC_HttpConnection {
+        luavlc_socket sock = LUAVLC_NO_SOCKET;
+        std::string pending; // body bytes that came in with the headers
+
+        ~LuaVLC_HttpConnection() {
+            if(sock != LUAVLC_NO_SOCKET)
+                luavlc_close_socket(sock);
+        }
+
+        ptrdiff_t receive(unsigned char* dest, size_t length) {
+            if(!pending.empty()) {
+                size_t count = std::min(length, pending.size());
+                memcpy(dest, pending.data(), count);
+                pending.erase(0, count);
+                return (ptrdiff_t)count;
+            }
+            int count = recv(sock, (char*)dest, (int)std::min<size_t>(length, 1 << 30), 0);
+            return count < 0 ? -1 : (ptrdiff_t)count;
+        }
+
+        bool connectTo(const std::string& host, const std::string& port) {
+        #if _WIN32
+            // several of vlc's input threads can get here at once
+            static std::once_flag started;
+            std::call_once(started, []{
+                WSADATA data;
+                WSAStartup(MAKEWORD(2, 2), &data);
+            });
+        #endif
+            struct addrinfo hints = {};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            struct addrinfo* addresses = nullptr;
+            if(getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0)
+                return false;
+            for(struct addrinfo* address = addresses; address != nullptr; address = address->ai_next) {
+                sock = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+                if(sock == LUAVLC_NO_SOCKET)
+                    continue;
+                if(connect(sock, address->ai_addr, (int)address->ai_addrlen) == 0)
+                    break;
+                luavlc_close_socket(sock);
+                sock = LUAVLC_NO_SOCKET;
+            }
+            freeaddrinfo(addresses);
+            if(sock == LUAVLC_NO_SOCKET)
+                return false;
+
+            // a dead server shouldn't be able to hang vlc's input thread forever
+        #if _WIN32
+            DWORD timeout = HTTP_TIMEOUT_MS;
+        #else
+            struct timeval timeout = {HTTP_TIMEOUT_MS / 1000, (HTTP_TIMEOUT_MS % 1000) * 1000};
+        #endif
+            setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+        #ifdef SO_NOSIGPIPE
+            int noSigpipe = 1;
+            setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, (const char*)&noSigpipe, sizeof(noSigpipe));
+        #endif
+            return true;
+        }
+
+        static std::string header(const std::string& headers, const char* name) {
+            size_t nameLength = strlen(name);
+            size_t line = headers.find("\r\n");
+            while(line != std::string::npos && line + 2 < headers.size()) {
+                size_t start = line + 2;
+                line = headers.find("\r\n", start);
+                if(line - start > nameLength && headers[start + nameLength] == ':') {
+                    bool match = true;
+                    for(size_t i = 0; i < nameLength && match; i++)
+                        match = tolower((unsigned char)headers[start + i]) == tolower((unsigned char)name[i]);
+                    if(match) {
+                        size_t value = headers.find_first_not_of(' ', start + nameLength + 1);
+                        return headers.substr(value, line - value);
+                    }
+                }
+            }
+            return "";
+        }
+
+        // starts a request for everything from the byte offset from, size gets the total size (UINT64_MAX if unknown)
+        bool open(std::string url, uint64_t from, uint64_t* size) {
+            for(int redirect = 0; redirect <= HTTP_MAX_REDIRECTS; redirect++) {
+                if(url.compare(0, 7, "http://") != 0)
+                    return false;
+                size_t pathStart = url.find('/', 7);
+                std::string hostPort = url.substr(7, pathStart == std::string::npos ? std::string::npos : pathStart - 7);
+                std::string path = pathStart == std::string::npos ? "/" : url.substr(pathStart);
+                std::string host = hostPort, port = "80";
+                size_t colon = hostPort.rfind(':');
+                if(colon != std::string::npos && hostPort.find(']', colon) == std::string::npos) {
+                    host = hostPort.substr(0, colon);
+                    port = hostPort.substr(colon + 1);
+                }
+                if(host.size() > 2 && host.front() == '[')
+                    host = host.substr(1, host.size() - 2);
+
+                if(sock != LUAVLC_NO_SOCKET)
+                    luavlc_close_socket(sock);
+                sock = LUAVLC_NO_SOCKET;
+                pending.clear();
+                if(!connectTo(host, port))
+                    return false;
+
+                std::string request = "GET " + path + " HTTP/1.0\r\nHost: " + hostPort + "\r\nUser-Agent: LoveVLC\r\nConnection: close\r\n";
+                if(from > 0)
+                    request += "Range: bytes=" + std::to_string(from) + "-\r\n";
+                request += "\r\n";
+                if(send(sock, request.data(), (int)request.size(), LUAVLC_SEND_FLAGS) != (int)request.size())
+                    return false;
+
+                std::string headers;
+                size_t end;
+                char chunk[4096];
+                while((end = headers.find("\r\n\r\n")) == std::string::npos) {
+                    if(headers.size() > HTTP_HEADER_LIMIT)
+                        return false;
+                    int count = recv(sock, chunk, sizeof(chunk), 0);
+                    if(count <= 0)
+                        return false;
+                    headers.append(chunk, count);
+                }
+                pending = headers.substr(end + 4);
+                headers.resize(end + 2);
+
+                int status = 0;
+                if(sscanf(headers.c_str(), "HTTP/%*d.%*d %d", &status) != 1)
+                    return false;
+                if(status >= 300 && status < 400) {
+                    std::string location = header(headers, "Location");
+                    if(location.empty())
+                        return false;
+                    url = location[0] == '/' ? "http://" + hostPort + location : location;
+                    continue;
+                }
+
+                std::string length = header(headers, "Content-Length");
+                *size = length.empty() ? UINT64_MAX : strtoull(length.c_str(), NULL, 10);
+                if(status == 206) {
+                    std::string range = header(headers, "Content-Range");
+                    size_t slash = range.find('/');
+                    *size = slash == std::string::npos || range[slash + 1] == '*' ? UINT64_MAX : strtoull(range.c_str() + slash + 1, NULL, 10);
+                    return true;
+                }
+                if(status != 200)
+                    return false;
+                // no range support, throw away everything before from
+                unsigned char skip[16 << 10];
+                for(uint64_t left = from; left > 0;) {
+                    ptrdiff_t count = receive(skip, (size_t)std::min<uint64_t>(left, sizeof(skip)));
+                    if(count <= 0)
+                        return false;
+                    left -= (uint64_t)count;
+                }
+                return true;
+            }
+            return false;
+        }
+    };
+
+    // opt-in disk cache for http media, configured with luavlc_url_cache_configure
+    // entries are <fnv hash of the url>.bin, and .part while they're still being downloaded
+    // least recently used ones (by modification time, bumped on every play) get evicted over the size limit
+    static std::mutex _url_cache_mutex;
+    static std::filesystem::path _url_cache_dir; // empty when the cache is off
+    static uint64_t _url_cache_limit = 0;
+    static std::vector<std::string> _url_cache_claimed; // keys being downloaded right now
+    static std::atomic<uint64_t> _url_cache_hits{0};
+    static std::atomic<uint64_t> _url_cache_misses{0};
+    static std::atomic<uint64_t> _url_cache_downloaded{0};
+
+    // reads this much past the downloaded part thru the cache, further seeks get their own connection
+    static const uint64_t URL_CACHE_SKIP_AHEAD = 4 << 20;
+
+    typedef struct {
+        uint64_t hits; // plays served from the cache
+        uint64_t misses; // plays that had to download
+        uint64_t downloadedBytes;
+        uint64_t cachedBytes; // on disk right now
+        int files;
+    } LuaVLC_UrlCacheStats;
+
+    static std::string url_cache_key(const char* url) {
+        uint64_t hash = 14695981039346656037ull;
+        for(const char* c = url; *c != 0; c++)
+            hash = (hash ^ (unsigned char)*c) * 1099511628211ull;
+        char key[17];
+        snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash);
+        return key;
+    }
+
+    // the mutex has to be locked
+    static void url_cache_evict() {
+        namespace fs = std::filesystem;
+        if(_url_cache_dir.empty())
+            return;
+
+        struct Entry { fs::file_time_type time; uint64_t size; fs::path path; };
+        std::vector<Entry> entries;
+        uint64_t total = 0;
+        std::error_code error;
+        for(const fs::directory_entry& file : fs::directory_iterator(_url_cache_dir, error)) {
+            fs::path path = file.path();
+            std::string key = path.stem().string();
+            if(path.extension() != ".bin" && path.extension() != ".part")
+                continue;
+            if(std::find(_url_cache_claimed.begin(), _url_cache_claimed.end(), key) != _url_cache_claimed.end())
+                continue; // still downloading, can't go anywhere
+            uint64_t size = file.file_size(error);
+            entries.push_back({file.last_write_time(error), size, path});
+            total += size;
+        }
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.time < b.time; });
+        for(size_t i = 0; i < entries.size() && total > _url_cache_limit; i++) {
+            if(fs::remove(entries[i].path, error))
+                total -= entries[i].size;
+        }
+    }
+
+    // pass NULL (or a limit of 0) to turn the cache off, files already in it are left alone
+    EXPORT_DLL bool luavlc_url_cache_configure(const char* directory, uint64_t maxBytes) {
+        std::lock_guard<std::mutex> lock(_url_cache_mutex);
+        _url_cache_dir.clear();
+        _url_cache_limit = maxBytes;
+        if(directory == NULL || directory == nullptr || maxBytes == 0)
+            return true;
+
+        std::error_code error;
+        std::filesystem::path dir = std::filesystem::u8path(directory);
+        std::filesystem::create_directories(dir, error);
+        if(!std::filesystem::is_directory(dir, error))
+            return false;
+        _url_cache_dir = dir;
+        url_cache_evict();
+        return true;
+    }
+
+    EXPORT_DLL bool luavlc_url_cache_enabled(void) {
+        std::lock_guard<std::mutex> lock(_url_cache_mutex);
+        return !_url_cache_dir.empty();
+    }
+
+    EXPORT_DLL void luavlc_url_cache_stats(LuaVLC_UrlCacheStats* out) {
+        out->hits = _url_cache_hits;
+        out->misses = _url_cache_misses;
+        out->downloadedBytes = _url_cache_downloaded;
+        out->cachedBytes = 0;
+        out->files = 0;
+
+        std::lock_guard<std::mutex> lock(_url_cache_mutex);
+        std::error_code error;
+        if(_url_cache_dir.empty())
+            return;
+        for(const std::filesystem::directory_entry& file : std::filesystem::directory_iterator(_url_cache_dir, error)) {
+            if(file.path().extension() != ".bin")
+                continue;
+            out->cachedBytes += file.file_size(error);
+            out->files++;
+        }
+    }
+
+    EXPORT_DLL void luavlc_url_cache_clear(void) {
+        std::lock_guard<std::mutex> lock(_url_cache_mutex);
+        uint64_t limit = _url_cache_limit;
+        _url_cache_limit = 0;
+        url_cache_evict();
+        _url_cache_limit = limit;
+    }
+
+    struct LuaVLC_UrlCacheReader : LuaVLC_Reader {
+        std::string url;
+        std::string key;
+        uint64_t size = UINT64_MAX;
+        uint64_t position = 0;
+
+        std::filesystem::path dir; // the cache directory and size limit when this started
+        uint64_t limit = 0;
+        bool caching = false; // writing what gets downloaded into the .part file
+        std::fstream part;
+        uint64_t written = 0; // everything before this is in the .part file
+        std::shared_ptr<LuaVLC_MappedFile> complete; // the .bin, once it's all there
+
+        std::unique_ptr<LuaVLC_HttpConnection> frontier; // always reading at written
+        std::unique_ptr<LuaVLC_HttpConnection> side; // for reads too far past written, not cached
+        uint64_t sidePosition = 0;
+
+        ~LuaVLC_UrlCacheReader() {
+            if(caching)
+                stopCaching(false);
+        }
+
+        std::filesystem::path entryPath(const char* extension) {
+            return dir / (key + extension);
+        }
+
+        void stopCaching(bool finished) {
+            part.close();
+            caching = false;
+            std::lock_guard<std::mutex> lock(_url_cache_mutex);
+            _url_cache_claimed.erase(std::remove(_url_cache_claimed.begin(), _url_cache_claimed.end(), key), _url_cache_claimed.end());
+            if(_url_cache_dir != dir)
+                return; // turned off or moved somewhere else since, leave the .part be
+            std::error_code error;
+            if(finished) {
+                std::filesystem::path bin = entryPath(".bin");
+                std::filesystem::rename(entryPath(".part"), bin, error);
+                complete = std::make_shared<LuaVLC_MappedFile>();
+                if(error || !complete->open(bin.u8string().c_str()))
+                    complete.reset();
+            }
+            url_cache_evict();
+        }
+
+        bool start(uint64_t* sizep) {
+            {
+                std::lock_guard<std::mutex> lock(_url_cache_mutex);
+                dir = _url_cache_dir;
+                limit = _url_cache_limit;
+                if(!dir.empty() && std::find(_url_cache_claimed.begin(), _url_cache_claimed.end(), key) == _url_cache_claimed.end()) {
+                    _url_cache_claimed.push_back(key);
+                    caching = true;
+                }
+            }
+            if(caching) {
+                // picks up where an earlier play stopped downloading
+                std::error_code error;
+                std::filesystem::path path = entryPath(".part");
+                written = std::filesystem::exists(path, error) ? std::filesystem::file_size(path, error) : 0;
+                if(error)
+                    written = 0;
+                if(written == 0)
+                    std::ofstream(path, std::ios::binary).close();
+                part.open(path, std::ios::binary | std::ios::in | std::ios::out);
+                if(!part.is_open())
+                    stopCaching(false);
+            }
+
+            std::unique_ptr<LuaVLC_HttpConnection> connection(new LuaVLC_HttpConnection());
+            if(!connection->open(url, written, &size)) {
+                // the server didn't like the range (the file changed?), start over
+                if(written == 0 || !connection->open(url, 0, &size))
+                    return false;
+                written = 0;
+                if(caching) {
+                    part.close();
+                    part.open(entryPath(".part"), std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+                }
+            }
+            if(caching && size != UINT64_MAX && size > limit) {
+                stopCaching(false); // would just evict everything else
+                std::error_code error;
+                std::filesystem::remove(entryPath(".part"), error);
+            }
+            if(caching && written == size)
+                stopCaching(true);
+            if(caching) {
+                frontier = std::move(connection);
+            } else if(complete == nullptr) {
+                // nothing gets written, every read goes thru the side connection so it gets this one
+                side = std::move(connection);
+                sidePosition = written;
+            }
+            *sizep = size;
+            return true;
+        }
+
+        ptrdiff_t sideRead(unsigned char* dest, size_t length) {
+            if(side == nullptr || sidePosition != position) {
+                side.reset(new LuaVLC_HttpConnection());
+                uint64_t ignored;
+                if(!side->open(url, position, &ignored)) {
+                    side.reset();
+                    return -1;
+                }
+                sidePosition = position;
+            }
+            ptrdiff_t count = side->receive(dest, length);
+            if(count > 0)
+                sidePosition += (uint64_t)count;
+            return count;
+        }
+
+        // downloads the next bit at written, into the cache and dest
+        ptrdiff_t frontierRead(unsigned char* dest, size_t length) {
+            if(frontier == nullptr) {
+                frontier.reset(new LuaVLC_HttpConnection());
+                uint64_t ignored;
+                if(!frontier->open(url, written, &ignored)) {
+                    frontier.reset();
+                    return -1;
+                }
+            }
+            ptrdiff_t count = frontier->receive(dest, length);
+            if(count < 0) {
+                frontier.reset(); // probably timed out while we were reading elsewhere, reconnect next time
+                return -1;
+            }
+            if(count == 0) {
+                frontier.reset();
+                if(size == UINT64_MAX)
+                    size = written;
+                if(written == size)
+                    stopCaching(true);
+                return 0;
+            }
+            part.seekp((std::streamoff)written);
+            part.write((const char*)dest, count);
+            written += (uint64_t)count;
+            _url_cache_downloaded += (uint64_t)count;
+            if(written == size)
+                stopCaching(true);
+            return count;
+        }
+
+        ptrdiff_t read(unsigned char* dest, size_t length) override {
+            if(position >= size)
+                return 0;
+            if(size != UINT64_MAX)
+                length = (size_t)std::min<uint64_t>(length, size - position);
+
+            ptrdiff_t count = -1;
+            if(complete != nullptr) {
+                count = complete->readAt(position, dest, length);
+            } else if(caching && position < written) {
+                part.flush();
+                part.seekg((std::streamoff)position);
+                part.read((char*)dest, (std::streamsize)std::min<uint64_t>(length, written - position));
+                count = part.gcount() > 0 ? (ptrdiff_t)part.gcount() : -1;
+                part.clear();
+            } else if(caching && position - written <= URL_CACHE_SKIP_AHEAD) {
+                // close enough, download up to it so it still ends up in the cache
+                unsigned char skip[16 << 10];
+                while(caching && written < position) {
+                    if(frontierRead(skip, (size_t)std::min<uint64_t>(sizeof(skip), position - written)) <= 0)
+                        break;
+                }
+                if(caching && written == position)
+                    count = frontierRead(dest, length);
+                else
+                    count = complete != nullptr ? complete->readAt(position, dest, length) : sideRead(dest, length);
+            } else {
+                count = sideRead(dest, length);
+            }
+            if(count > 0)
+                position += (uint64_t)count;
+            return count;
+        }
+
+        int seek(uint64_t offset) override {
+            if(size != UINT64_MAX && offset > size)
+                return -1;
+            position = offset;
+            return 0;
+        }
+    };
+
+    struct LuaVLC_UrlCacheSource : LuaVLC_Source {
+        std::string url;
+        std::string key;
+
+        LuaVLC_Reader* open(uint64_t* size) override {
+            std::filesystem::path bin;
+            {
+                std::lock_guard<std::mutex> lock(_url_cache_mutex);
+                if(!_url_cache_dir.empty())
+                    bin = _url_cache_dir / (key + ".bin");
+            }
+            std::error_code error;
+            if(!bin.empty() && std::filesystem::exists(bin, error)) {
+                // bump it to the front of the lru
+                std::filesystem::last_write_time(bin, std::filesystem::file_time_type::clock::now(), error);
+                // every reader maps it on its own, vlc can open the media again while an older one is still reading
+                std::shared_ptr<LuaVLC_MappedFile> cached = std::make_shared<LuaVLC_MappedFile>();
+                if(cached->open(bin.u8string().c_str())) {
+                    _url_cache_hits++;
+                    LuaVLC_MappedReader* reader = new LuaVLC_MappedReader();
+                    reader->file = cached;
+                    reader->length = cached->size;
+                    *size = cached->size;
+                    return reader;
+                }
+            }
+
+            _url_cache_misses++;
+            LuaVLC_UrlCacheReader* reader = new LuaVLC_UrlCacheReader();
+            reader->url = url;
+            reader->key = key;
+            if(!reader->start(size)) {
+                delete reader;
+                return nullptr;
+            }
+            return reader;
+        }
+    };
+
+    // streams an http:// url thru the disk cache, returns NULL for anything else (or if the cache is off)
+    EXPORT_DLL LuaVLC_Source* luavlc_source_new_cached_url(const char* url) {
+        if(url == NULL || url == nullptr || strncmp(url, "http://", 7) != 0 || !luavlc_url_cache_enabled())
+            return NULL;
+
+        LuaVLC_UrlCacheSource* source = new LuaVLC_UrlCacheSource();
+        source->url = url;
+        source->key = url_cache_key(url);
+        source->network = true;
+        return source;
+    }
+
+    // i can't write this or unlock_cb function in lua code
+    // because (in the context of love2d atleast) it causes a segfault after running a few times
+    // so i have to write it here in C land
+    void *lock_cb(void *opaque, void **planes) {
+        LuaVLC_Video* video = (LuaVLC_Video*)opaque;
+        *planes = video->pixelBuffer;
+        _can_update_texture = false;
+        return NULL;
+    }
+
+    void display_cb(void *opaque, void *picture) {
+        LuaVLC_Video* video = (LuaVLC_Video*)opaque;
+        // before the sequence goes up, lua takes the dirty rows as soon as it sees the new frame
+        dirty_track(video);
+        video->frameSequence.fetch_add(1, std::memory_order_release);
+        pbo_frame(video);
+        fields_track(video);
+        _can_update_texture = true;
+        int seekMode = video->seekPending.exchange(-1, std::memory_order_acq_rel);
+        if(seekMode >= 0)
+            seek_finished(video, seekMode);
+        video->stepPending.store(false, std::memory_order_release);
+        frc_push(video, seekMode >= 0);
+        frame_cache_capture(video);
+    }
+
+    // kept for older code, only tells you if *any* video finished a frame
+    // use the frameSequence from luavlc_players_update instead
+    EXPORT_DLL bool can_update_texture(void) {
+        return _can_update_texture;
+    }
+
+    EXPORT_DLL void video_use_unlock_callback(libvlc_media_player_t *mp, void *opaque) {
+        libvlc_video_set_callbacks(mp, NULL, NULL, display_cb, opaque);
+    }
+    
+    EXPORT_DLL void video_use_all_callbacks(libvlc_media_player_t *mp, void *opaque) {
+        libvlc_video_set_callbacks(mp, lock_cb, NULL, display_cb, opaque);
+    }
+
+    void video_buffering_cb(const struct libvlc_event_t *event, void *opaque) {
+        LuaVLC_Video* video = (LuaVLC_Video*)opaque;
+        video->buffering.store(event->u.media_player_buffering.new_cache, std::memory_order_relaxed);
+    }
+
+    // ties the player (and its media, which gets retained) to the video
+    // so luavlc_players_update can query them without going thru lua
+    EXPORT_DLL void luavlc_video_attach(LuaVLC_Video* video, libvlc_media_player_t *mp, libvlc_media_t *media) {
+        if(video == NULL || video == nullptr || mp == NULL || mp == nullptr)
+            return;
+
+        video->mediaPlayer = mp;
+        if(media != NULL && media != nullptr) {
+            libvlc_media_retain(media);
+            video->media = media;
+        }
+        libvlc_event_attach(libvlc_media_player_event_manager(mp), libvlc_MediaPlayerBuffering, video_buffering_cb, video);
+    }
+
+    static double _sched_idle_ms = 0.0; // 0 = scheduler disabled
+    static int _sched_idle_mode = LUAVLC_IDLE_PAUSE;
+    static int _sched_max_active = 0; // 0 = no limit
+    static double _sched_keyframe_interval_ms = 1000.0;
+
+    // videos that haven't been drawn for idleSeconds get put into idleMode, and at most
+    // maxActive videos (biggest on-screen area first) get to decode at once
+    EXPORT_DLL void luavlc_scheduler_configure(double idleSeconds, int idleMode, int maxActive, double keyframeInterval) {
+        _sched_idle_ms = idleSeconds > 0.0 ? idleSeconds * 1000.0 : 0.0;
+        _sched_idle_mode = idleMode;
+        _sched_max_active = maxActive > 0 ? maxActive : 0;
+        _sched_keyframe_interval_ms = keyframeInterval > 0.0 ? keyframeInterval * 1000.0 : 1000.0;
+    }
+
+    static void video_set_video_track_enabled(LuaVLC_Video* video, bool enabled) {
+        libvlc_media_player_t* mp = video->mediaPlayer;
+        if(luavlc_vlc_major() < 4) {
+            typedef int (*get_track_v3)(libvlc_media_player_t*);
+            typedef int (*set_track_v3)(libvlc_media_player_t*, int);
+            static get_track_v3 getTrack = (get_track_v3)luavlc_vlc_symbol("libvlc_video_get_track");
+            static set_track_v3 setTrack = (set_track_v3)luavlc_vlc_symbol("libvlc_video_set_track");
+            if(getTrack == NULL || setTrack == NULL)
+                return;
+            if(!enabled) {
+                video->videoTrack = getTrack(mp);
+                setTrack(mp, -1);
+            } else if(video->videoTrack != -1) {
+                setTrack(mp, video->videoTrack);
+            }
+            return;
+        }
+        static auto getSelected = (decltype(&libvlc_media_player_get_selected_track))luavlc_vlc_symbol("libvlc_media_player_get_selected_track");
+        static auto unselect = (decltype(&libvlc_media_player_unselect_track_type))luavlc_vlc_symbol("libvlc_media_player_unselect_track_type");
+        static auto selectIds = (decltype(&libvlc_media_player_select_tracks_by_ids))luavlc_vlc_symbol("libvlc_media_player_select_tracks_by_ids");
+        static auto trackRelease = (decltype(&libvlc_media_track_release))luavlc_vlc_symbol("libvlc_media_track_release");
+        if(getSelected == NULL || unselect == NULL || selectIds == NULL || trackRelease == NULL)
+            return;
+        if(!enabled) {
+            libvlc_media_track_t* track = getSelected(mp, libvlc_track_video);
+            if(track != NULL) {
+                video->videoTrackId = track->psz_id;
+                trackRelease(track);
+            }
+            unselect(mp, libvlc_track_video);
+        } else if(!video->videoTrackId.empty()) {
+            selectIds(mp, libvlc_track_video, video->videoTrackId.c_str());
+        }
+    }
+
+    static void video_enter_idle(LuaVLC_Video* video, int mode, double now) {
+        libvlc_media_player_t* mp = video->mediaPlayer;
+        video->idle = mode;
+        video->idleStartTime = now;
+        video->lastKeyframeSeek = now;
+        video->idleKeyframe = -1.0;
+        video->idleMediaTime = (double)libvlc_media_player_get_time(mp);
+        switch(mode) {
+            case LUAVLC_IDLE_PAUSE:
+            case LUAVLC_IDLE_KEYFRAME:
+                libvlc_media_player_set_pause(mp, 1);
+                break;
+
+            case LUAVLC_IDLE_AUDIO_ONLY:
+                video_set_video_track_enabled(video, false);
+                break;
+        }
+    }
+
+    static void video_leave_idle(LuaVLC_Video* video) {
+        libvlc_media_player_t* mp = video->mediaPlayer;
+        switch(video->idle) {
+            case LUAVLC_IDLE_PAUSE:
+            case LUAVLC_IDLE_KEYFRAME:
+                if(video->wantPlaying)
+                    libvlc_media_player_set_pause(mp, 0);
+                break;
+
+            case LUAVLC_IDLE_AUDIO_ONLY:
+                video_set_video_track_enabled(video, true);
+                break;
+        }
+        video->idle = LUAVLC_IDLE_NONE;
+    }
+
+    static void scheduler_update(LuaVLC_Video** videos, int count, double now) {
+        std::vector<LuaVLC_Video*> visible;
+        for(int i = 0; i < count; i++) {
+            LuaVLC_Video* video = videos[i];
+            if(video == NULL || video == nullptr || video->mediaPlayer == nullptr)
+                continue;
+
+            if(video->lastPresentedTime < 0.0 || video->presentCount != video->seenPresentCount) {
+                video->seenPresentCount = video->presentCount;
+                video->lastPresentedTime = now;
+            }
+            int mode = video->idleMode >= 0 ? video->idleMode : _sched_idle_mode;
+            bool stale = _sched_idle_ms > 0.0 && now - video->lastPresentedTime >= _sched_idle_ms;
+            if(video->idle != LUAVLC_IDLE_NONE) {
+                // paused or stopped by someone else in the meantime, forget about it
+                if(!video->wantPlaying && video->idle != LUAVLC_IDLE_AUDIO_ONLY) {
+                    video->idle = LUAVLC_IDLE_NONE;
+                    continue;
+                }
+                if(stale) {
+                    if(video->idle == LUAVLC_IDLE_KEYFRAME && now - video->lastKeyframeSeek >= _sched_keyframe_interval_ms) {
+                        video->lastKeyframeSeek = now;
+                        double target = video->idleMediaTime + (now - video->idleStartTime);
+                        // 3.0 can't fast seek per call, a "fast" seek there decodes the whole gop up to target.
+                        // a precise seek right onto an indexed keyframe has nothing to decode before it though
+                        double keyframe = keyframe_nearest(video, target);
+                        if(keyframe >= 0.0) {
+                            if(keyframe != video->idleKeyframe) {
+                                video->idleKeyframe = keyframe;
+                                luavlc_media_player_set_time(video->mediaPlayer, (libvlc_time_t)std::ceil(keyframe) + 1, false);
+                            }
+                        } else if(luavlc_vlc_major() >= 4) {
+                            luavlc_media_player_set_time(video->mediaPlayer, (libvlc_time_t)target, true);
+                        }
+                    }
+                    continue;
+                }
+                visible.push_back(video);
+                continue;
+            }
+            if(!video->wantPlaying || libvlc_media_player_get_state(video->mediaPlayer) != libvlc_Playing)
+                continue;
+
+            if(stale && mode != LUAVLC_IDLE_NONE) {
+                video_enter_idle(video, mode, now);
+                continue;
+            }
+            visible.push_back(video);
+        }
+
+        // biggest videos get to decode first
+        std::stable_sort(visible.begin(), visible.end(), [](LuaVLC_Video* a, LuaVLC_Video* b) {
+            return a->presentedArea > b->presentedArea;
+        });
+        for(size_t i = 0; i < visible.size(); i++) {
+            LuaVLC_Video* video = visible[i];
+            bool allowed = _sched_max_active == 0 || (int)i < _sched_max_active;
+            if(allowed && video->idle != LUAVLC_IDLE_NONE)
+                video_leave_idle(video);
+            else if(!allowed && video->idle == LUAVLC_IDLE_NONE) {
+                int mode = video->idleMode >= 0 ? video->idleMode : _sched_idle_mode;
+                video_enter_idle(video, mode != LUAVLC_IDLE_NONE ? mode : LUAVLC_IDLE_PAUSE, now);
+            }
+        }
+    }
+
+    // so the audio's openal buffers get counted towards the video
+    EXPORT_DLL void luavlc_video_attach_audio(LuaVLC_Video* video, LuaVLC_Audio* audio) {
+        if(audio != NULL && audio != nullptr)
+            audio->owner = video;
+    }
+
+    // replaces the get_state, get_time, get_length, video_get_size and audio_set_volume
+    // calls every video used to make from lua each frame with a single call
+    EXPORT_DLL void luavlc_players_update(LuaVLC_Video** videos, int count, LuaVLC_PlayerStatus* out) {
+        double now = luavlc_now_ms();
+        if(_sched_idle_ms > 0.0 || _sched_max_active > 0) {
+            scheduler_update(videos, count, now);
+        } else {
+            // the scheduler got turned off, give back anything it was holding
+            for(int i = 0; i < count; i++) {
+                if(videos[i] != NULL && videos[i] != nullptr && videos[i]->idle != LUAVLC_IDLE_NONE)
+                    video_leave_idle(videos[i]);
+            }
+        }
+        for(int i = 0; i < count; i++) {
+            LuaVLC_Video* video = videos[i];
+            LuaVLC_PlayerStatus* status = &out[i];
+            memset(status, 0, sizeof(LuaVLC_PlayerStatus));
+            if(video == NULL || video == nullptr || video->mediaPlayer == nullptr)
+                continue;
+
+            libvlc_media_player_t* mp = video->mediaPlayer;
+            int state = (int)libvlc_media_player_get_state(mp);
+            if(state != video->lastState) {
+                // vlc forgets the volume when the audio output gets recreated
+                video->appliedVolume = -1.0f;
+                video->lastState = state;
+                video->lastStatsTime = 0.0;
+            }
+            if(state == libvlc_Playing && video->volume != video->appliedVolume) {
+                libvlc_audio_set_volume(mp, (int)(video->volume * 100.0f));
+                video->appliedVolume = video->volume;
+            }
+            // these take locks inside of vlc and barely change, so don't ask every frame
+            if(now - video->lastStatsTime >= 250.0 || video->videoWidth == 0) {
+                video->lastStatsTime = now;
+
+                unsigned int w = 0, h = 0;
+                if(libvlc_video_get_size(mp, 0, &w, &h) == 0 && (w != video->videoWidth || h != video->videoHeight)) {
+                    // decoders mostly output 4:2:0, so 1.5 bytes per pixel
+                    int64_t oldPool = (int64_t)video->videoWidth * video->videoHeight * 3 / 2 * ESTIMATED_POOL_PICTURES;
+                    int64_t newPool = (int64_t)w * h * 3 / 2 * ESTIMATED_POOL_PICTURES;
+                    memory_track(video, LUAVLC_MEM_PICTURE_POOL, newPool - oldPool);
+                    video->videoWidth = w;
+                    video->videoHeight = h;
+                }
+                LuaVLC_MediaStats stats;
+                if(video->media != nullptr && luavlc_media_get_stats(video->media, &stats))
+                    video->droppedFrames = (unsigned int)stats.lostPictures;
+            }
+            status->frameSequence = video->frameSequence.load(std::memory_order_acquire);
+            status->state = state;
+            status->time = (double)libvlc_media_player_get_time(mp) / 1000.0;
+            status->length = (double)libvlc_media_player_get_length(mp) / 1000.0;
+            status->width = video->videoWidth;
+            status->height = video->videoHeight;
+            status->buffering = video->buffering.load(std::memory_order_relaxed);
+            status->droppedFrames = video->droppedFrames;
+            status->idle = video->idle;
+            if(video->scrubDeferred >= 0.0)
+                scrub_flush(video, now);
+        }
+    }
+
+    // counts how much of the queue hasn't been played yet, only called from vlc's audio thread (like the rest of these)
+    static void audio_track_ring(LuaVLC_Audio* audio) {
+        ALint state = 0;
+        alGetSourcei(audio->source, AL_SOURCE_STATE, &state);
+        int64_t unplayed = 0;
+        if(state == AL_PLAYING || state == AL_PAUSED) {
+            // the offset goes from the start of the queue, buffers that are done but not unqueued yet included
+            ALint offset = 0;
+            alGetSourcei(audio->source, AL_BYTE_OFFSET, &offset);
+            unplayed = std::max<int64_t>(audio->queuedBytes - offset, 0);
+        } else {
+            ALint queued = 0, processed = 0;
+            alGetSourcei(audio->source, AL_BUFFERS_QUEUED, &queued);
+            alGetSourcei(audio->source, AL_BUFFERS_PROCESSED, &processed);
+            unplayed = processed >= queued ? 0 : audio->queuedBytes;
+        }
+        memory_track((LuaVLC_Video*)audio->owner, LUAVLC_MEM_AUDIO_RING, unplayed - audio->ringBytes);
+        audio->ringBytes = unplayed;
+    }
+
+    void audio_play(void *data, const void *rawSamples, unsigned count, int64_t pts) {
+        LuaVLC_Audio* audio = (LuaVLC_Audio*)data;
+        if(audio == NULL || audio == nullptr || audio->source == 0)
+            return;
+
+        ALint nb = 0;
+        bool useUnqueue = audio->bufferIndex > audio->bufferCount - 1;
+        if (!useUnqueue) {
+            audio->bufferIndex += 1;
+            nb = 1;
+        } else {
+            alGetSourcei(audio->source, AL_BUFFERS_PROCESSED, &nb);
+        }
+
+        if(nb == 0)
+            return;
+
+        ALuint buffer;
+        ALint oldSize = 0;
+        if (useUnqueue) {
+            alSourceUnqueueBuffers(audio->source, 1, &buffer);
+            alGetBufferi(buffer, AL_SIZE, &oldSize);
+            audio->queuedBytes -= oldSize;
+        } else {
+            buffer = audio->buffers[audio->bufferIndex - 1];
+        }
+
+        ALsizei size = count * audio->frameSize;
+        alBufferData(buffer, audio->format, rawSamples, size, audio->sampleRate);
+        alSourceQueueBuffers(audio->source, 1, &buffer);
+
+        LuaVLC_Video* owner = (LuaVLC_Video*)audio->owner;
+        audio->queuedBytes += size;
+        audio->bufferBytes += size - oldSize;
+        memory_track(owner, LUAVLC_MEM_AUDIO_BUFFERS, size - oldSize);
+
+        ALint state = 0;
+        alGetSourcei(audio->source, AL_SOURCE_STATE, &state);
+        if(state != AL_PLAYING) {
+            alSourcePlay(audio->source);
+        }
+        audio_track_ring(audio);
+    }
+
+    void audio_resume(void *data, int64_t pts) {
+        LuaVLC_Audio* audio = (LuaVLC_Audio*)data;
+        if(audio == NULL || audio == nullptr || audio->source == 0)
+            return;
+
+        ALint state = 0;
+        alGetSourcei(audio->source, AL_SOURCE_STATE, &state);
+
+        if(state == AL_PAUSED || state == AL_STOPPED)
+            alSourcePlay(audio->source);
+    }
+
+    void audio_pause(void *data, int64_t pts) {
+        LuaVLC_Audio* audio = (LuaVLC_Audio*)data;
+        if(audio == NULL || audio == nullptr || audio->source == 0)
+            return;
+
+        ALint state;
+        alGetSourcei(audio->source, AL_SOURCE_STATE, &state);
+
+        if(state != AL_PAUSED)
+            alSourcePause(audio->source);
+    }
+
+    void audio_flush(void *data, int64_t pts) {
+        LuaVLC_Audio* audio = (LuaVLC_Audio*)data;
+        if(audio == NULL || audio == nullptr || audio->source == 0)
+            return;
+
+        ALint state;
+        alGetSourcei(audio->source, AL_SOURCE_STATE, &state);
+
+        if(state != AL_STOPPED)
+            alSourceStop(audio->source);
+        audio_track_ring(audio);
+    }
+
+    void audio_set_volume(void *data, float volume, bool mute) {
+        LuaVLC_Audio* audio = (LuaVLC_Audio*)data;
+        if(audio == NULL || audio == nullptr || audio->source == 0)
+            return;
+
+        alSourcef(audio->source, AL_GAIN, mute ? 0.0f : volume);
+    }
+
+    int audio_setup(void **data, char *format, unsigned *p_rate, unsigned *p_channels) {
+        LuaVLC_Audio* audio = *((LuaVLC_Audio**)data);
+        if(audio == NULL || audio == nullptr || audio->source == 0)
+            return 1;
+        
+        if(_alUseEXTFLOAT32 == -1)
+            _alUseEXTFLOAT32 = (int)alIsExtensionPresent("AL_EXT_FLOAT32");
+
+        if(_alUseEXTMCFORMATS == -1)
+            _alUseEXTMCFORMATS = (int)alIsExtensionPresent("AL_EXT_MCFORMATS");
+        
+        audio->sampleRate = *p_rate;
+        unsigned channels = *p_channels;
+        
+        if(_alUseEXTMCFORMATS == 1 && channels > 8)
+            channels = 8;
+        else if(channels > 2)
+            channels = 2;
+
+        bool useFloat32 = _alUseEXTFLOAT32 == 1 && strcmp(format, "FL32") == 0;
+        // memcpy(format, useFloat32 ? "FL32" : "S16N", 4);
+
+        switch(channels) {
+            case 1:
+                audio->format = useFloat32 ? AL_FORMAT_MONO_FLOAT32 : AL_FORMAT_MONO16;
+                channels = 1;
+                break;
+
+            case 2:
+            case 3:
+                audio->format = useFloat32 ? AL_FORMAT_STEREO_FLOAT32 : AL_FORMAT_STEREO16;
+                channels = 2;
+                break;
+
+            case 4:
+                audio->format = useFloat32 ? AL_FORMAT_QUAD32 : AL_FORMAT_QUAD16;
+                channels = 4;
+                break;
+
+            case 5:
+            case 6:
+                audio->format = useFloat32 ? AL_FORMAT_51CHN32 : AL_FORMAT_51CHN16;
+                channels = 6;
+                break;
+
+            case 7:
+            case 8:
+                audio->format = useFloat32 ? AL_FORMAT_71CHN32 : AL_FORMAT_71CHN16;
+                channels = 8;
+                break;
+        }
+        audio->frameSize = (useFloat32 ? sizeof(float) : sizeof(int16_t)) * channels;
+        return 0;
+    }
+
+    // have to pass as a void* then cast to LuaVLC_Audio* because
+    // luajit is being really strange and picky about the struct types
+    EXPORT_DLL void video_setup_audio(void* p_audio, libvlc_media_player_t *mp) {
+        LuaVLC_Audio* audio = (LuaVLC_Audio*)p_audio;
+        if (audio == NULL || audio == nullptr)
+            return;
         if (mp == NULL || mp == nullptr)
             return;
 
-        alGenSources(1, &audio->source);
-        audio->bufferCount = MAX_BUFFER_COUNT;
-        audio->buffers = (ALuint*)malloc(audio->bufferCount * sizeof(ALuint));
-        for (int i = 0; i < audio->bufferCount; i++) {
-            alGenBuffers(1, &audio->buffers[i]);
-        } 
+        alGenSources(1, &audio->source);
+        audio->bufferCount = MAX_BUFFER_COUNT;
+        audio->buffers = (ALuint*)malloc(audio->bufferCount * sizeof(ALuint));
+        for (int i = 0; i < audio->bufferCount; i++) {
+            alGenBuffers(1, &audio->buffers[i]);
+        } 
+
+        libvlc_audio_set_callbacks(mp, audio_play, audio_pause, audio_resume, audio_flush, NULL, audio);
+        libvlc_audio_set_volume_callback(mp, audio_set_volume);
+        libvlc_audio_set_format_callbacks(mp, audio_setup, NULL);
+    }
+
+    // batch media probing, parses files on a small pool of worker threads without making any players
+    // results are cached on disk by path, size and modification time so rescanning is mostly free
+    enum {
+        LUAVLC_PROBE_DONE,
+        LUAVLC_PROBE_FAILED,
+        LUAVLC_PROBE_TIMEOUT,
+        LUAVLC_PROBE_PENDING // only used internally
+    };
+
+    #define LUAVLC_PROBE_MAX_TRACKS 16
+
+    typedef struct {
+        int type; // libvlc_track_type_t
+        char codec[8]; // fourcc
+        char description[64];
+        char language[16];
+        unsigned int bitrate;
+        unsigned int width;
+        unsigned int height;
+        double fps;
+        unsigned int channels;
+        unsigned int rate;
+    } LuaVLC_ProbeTrack;
+
+    typedef struct {
+        int id;
+        int status; // LUAVLC_PROBE_*
+        int cached; // came out of the cache instead of vlc
+        double duration; // in seconds, 0 if unknown
+        unsigned int width; // of the first video track
+        unsigned int height;
+        double fps;
+        int trackCount;
+        LuaVLC_ProbeTrack tracks[LUAVLC_PROBE_MAX_TRACKS];
+    } LuaVLC_ProbeResult;
+
+    struct LuaVLC_ProbeJob {
+        int id;
+        std::string path;
+    };
+
+    struct LuaVLC_ProbeCacheEntry {
+        uint64_t size;
+        int64_t mtime;
+        LuaVLC_ProbeResult result;
+    };
+
+    static const uint32_t PROBE_CACHE_VERSION = 1;
+
+    extern "C++" {
+    // for pools nothing polls, their work leaves its results somewhere else
+    struct LuaVLC_NoResult {
+        int id;
+    };
+
+    // every background job (probing, thumbnails, baking, keyframe indexes, frame cache fills, pbo copies)
+    // gets queued up in one of these and worked off by up to maxWorkers threads, started as they're needed.
+    // results wait in finished until lua polls for them, unless Result is LuaVLC_NoResult.
+    // Job and Result both start with an int id, work fills in the result for one job
+    template<typename Job, typename Result = LuaVLC_NoResult>
+    struct LuaVLC_WorkerPool {
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<Job> queue;
+        std::vector<Result> finished;
+        std::vector<std::thread> workers;
+        void (*work)(const Job& job, Result* result);
+        int maxWorkers;
+        int nextId = 1;
+        int active = 0; // taken off the queue, but not finished yet
+        std::atomic<bool> stopping{false};
+
+        LuaVLC_WorkerPool(void (*work)(const Job&, Result*), int maxWorkers) : work(work), maxWorkers(maxWorkers) {}
+
+        // returns the id its result will have
+        int request(Job job) {
+            std::lock_guard<std::mutex> lock(mutex);
+            job.id = nextId++;
+            queue.push_back(std::move(job));
+            // busy workers don't count, they won't get to this one until they're done
+            if((int)workers.size() < maxWorkers && workers.size() - active < queue.size())
+                workers.emplace_back(&LuaVLC_WorkerPool::run, this);
+            wake.notify_one();
+            return queue.back().id;
+        }
+
+        void run() {
+            while(true) {
+                Job job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [this]{ return stopping || !queue.empty(); });
+                    if(stopping)
+                        return;
+                    job = std::move(queue.front());
+                    queue.pop_front();
+                    active++;
+                }
+                Result result = {};
+                result.id = job.id;
+                work(job, &result);
+                std::lock_guard<std::mutex> lock(mutex);
+                if constexpr(!std::is_same<Result, LuaVLC_NoResult>::value)
+                    finished.push_back(result);
+                active--;
+            }
+        }
+
+        // the instance might still be starting up in the background, false if there won't be one
+        bool waitForInstance() {
+            while(luavlc_vlc_state() == 1 && !stopping)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            return _instance != nullptr && !stopping;
+        }
+
+        // takes the oldest finished result, returns false if there isn't one
+        bool poll(Result* out) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(finished.empty())
+                return false;
+            *out = finished.front();
+            finished.erase(finished.begin());
+            return true;
+        }
+
+        // drops whatever is still queued and waits for the workers, finished results are left for the caller
+        void shutdown() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+                queue.clear();
+            }
+            wake.notify_all();
+            for(std::thread& worker : workers)
+                worker.join();
+            workers.clear();
+            stopping = false;
+        }
+    };
+    }
+
+    static void probe_work(const LuaVLC_ProbeJob& job, LuaVLC_ProbeResult* result);
+    static LuaVLC_WorkerPool<LuaVLC_ProbeJob, LuaVLC_ProbeResult> _probe_pool(probe_work, 4);
+    static int _probe_timeout_ms = 5000;
+    static std::unordered_map<std::string, LuaVLC_ProbeCacheEntry> _probe_cache;
+    static std::filesystem::path _probe_cache_path; // empty = results only live in memory
+
+    // the mutex has to be locked
+    static void probe_cache_load() {
+        _probe_cache.clear();
+        std::ifstream file(_probe_cache_path, std::ios::binary);
+        uint32_t header[3] = {0};
+        if(!file.read((char*)header, sizeof(header)) || memcmp(header, "LVPC", 4) != 0 || header[1] != PROBE_CACHE_VERSION || header[2] != sizeof(LuaVLC_ProbeResult))
+            return;
+
+        // the file only ever gets appended to, later records win
+        size_t records = 0;
+        while(true) {
+            uint32_t pathLength;
+            LuaVLC_ProbeCacheEntry entry;
+            if(!file.read((char*)&pathLength, sizeof(pathLength)) || pathLength > 65536)
+                break;
+            std::string path(pathLength, '\0');
+            if(!file.read(&path[0], pathLength) || !file.read((char*)&entry.size, sizeof(entry.size))
+                || !file.read((char*)&entry.mtime, sizeof(entry.mtime)) || !file.read((char*)&entry.result, sizeof(entry.result)))
+                break;
+            _probe_cache[path] = entry;
+            records++;
+        }
+        file.close();
+
+        if(records > _probe_cache.size() * 2 + 16) {
+            // mostly stale records, write it back out compacted
+            std::ofstream out(_probe_cache_path, std::ios::binary | std::ios::trunc);
+            out.write((const char*)header, sizeof(header));
+            for(const auto& item : _probe_cache) {
+                uint32_t pathLength = (uint32_t)item.first.size();
+                out.write((const char*)&pathLength, sizeof(pathLength));
+                out.write(item.first.data(), pathLength);
+                out.write((const char*)&item.second.size, sizeof(item.second.size));
+                out.write((const char*)&item.second.mtime, sizeof(item.second.mtime));
+                out.write((const char*)&item.second.result, sizeof(item.second.result));
+            }
+        }
+    }
+
+    // the mutex has to be locked
+    static void probe_cache_store(const std::string& path, const LuaVLC_ProbeCacheEntry& entry) {
+        _probe_cache[path] = entry;
+        if(_probe_cache_path.empty())
+            return;
+
+        std::error_code error;
+        bool fresh = !std::filesystem::exists(_probe_cache_path, error);
+        std::ofstream out(_probe_cache_path, std::ios::binary | std::ios::app);
+        if(fresh) {
+            uint32_t header[3] = {0, PROBE_CACHE_VERSION, (uint32_t)sizeof(LuaVLC_ProbeResult)};
+            memcpy(header, "LVPC", 4);
+            out.write((const char*)header, sizeof(header));
+        }
+        uint32_t pathLength = (uint32_t)path.size();
+        out.write((const char*)&pathLength, sizeof(pathLength));
+        out.write(path.data(), pathLength);
+        out.write((const char*)&entry.size, sizeof(entry.size));
+        out.write((const char*)&entry.mtime, sizeof(entry.mtime));
+        out.write((const char*)&entry.result, sizeof(entry.result));
+    }
+
+    static int probe_parsed_status(libvlc_media_t* media) {
+        int status = (int)libvlc_media_get_parsed_status(media);
+        if(luavlc_vlc_major() < 4) {
+            // 3.0 has no none/pending/cancelled, it's 0 until parsed then skipped, failed, timeout, done
+            if(status == 0)
+                return LUAVLC_PROBE_PENDING;
+            return status == 4 ? LUAVLC_PROBE_DONE : status == 3 ? LUAVLC_PROBE_TIMEOUT : LUAVLC_PROBE_FAILED;
+        }
+        if(status <= libvlc_media_parsed_status_pending)
+            return LUAVLC_PROBE_PENDING;
+        if(status == libvlc_media_parsed_status_done)
+            return LUAVLC_PROBE_DONE;
+        return status == libvlc_media_parsed_status_timeout ? LUAVLC_PROBE_TIMEOUT : LUAVLC_PROBE_FAILED;
+    }
+
+    static void probe_copy_string(char* dest, size_t size, const char* text) {
+        if(text == NULL)
+            text = "";
+        strncpy(dest, text, size - 1);
+        dest[size - 1] = 0;
+    }
+
+    // the track struct starts the same way in 3.0 and 4.0, and that's all this reads
+    static void probe_add_track(LuaVLC_ProbeResult* result, const libvlc_media_track_t* track) {
+        if(result->trackCount >= LUAVLC_PROBE_MAX_TRACKS || track == NULL)
+            return;
+        LuaVLC_ProbeTrack* out = &result->tracks[result->trackCount++];
+        memset(out, 0, sizeof(LuaVLC_ProbeTrack));
+        out->type = (int)track->i_type;
+        for(int i = 0; i < 4; i++)
+            out->codec[i] = (char)((track->i_codec >> (8 * i)) & 0xFF);
+        probe_copy_string(out->description, sizeof(out->description), libvlc_media_get_codec_description(track->i_type, track->i_codec));
+        probe_copy_string(out->language, sizeof(out->language), track->psz_language);
+        out->bitrate = track->i_bitrate;
+        if(track->i_type == libvlc_track_video && track->video != NULL) {
+            out->width = track->video->i_width;
+            out->height = track->video->i_height;
+            if(track->video->i_frame_rate_den != 0)
+                out->fps = (double)track->video->i_frame_rate_num / track->video->i_frame_rate_den;
+            if(result->width == 0) {
+                result->width = out->width;
+                result->height = out->height;
+                result->fps = out->fps;
+            }
+        } else if(track->i_type == libvlc_track_audio && track->audio != NULL) {
+            out->channels = track->audio->i_channels;
+            out->rate = track->audio->i_rate;
+        }
+    }
+
+    static void probe_collect_tracks(libvlc_media_t* media, LuaVLC_ProbeResult* result) {
+        if(luavlc_vlc_major() < 4) {
+            typedef unsigned (*tracks_get_v3)(libvlc_media_t*, libvlc_media_track_t***);
+            typedef void (*tracks_release_v3)(libvlc_media_track_t**, unsigned);
+            static tracks_get_v3 tracksGet = (tracks_get_v3)luavlc_vlc_symbol("libvlc_media_tracks_get");
+            static tracks_release_v3 tracksRelease = (tracks_release_v3)luavlc_vlc_symbol("libvlc_media_tracks_release");
+            if(tracksGet == NULL || tracksRelease == NULL)
+                return;
+            libvlc_media_track_t** tracks = NULL;
+            unsigned count = tracksGet(media, &tracks);
+            for(unsigned i = 0; i < count; i++)
+                probe_add_track(result, tracks[i]);
+            if(tracks != NULL)
+                tracksRelease(tracks, count);
+            return;
+        }
+        static auto getTracklist = (decltype(&libvlc_media_get_tracklist))luavlc_vlc_symbol("libvlc_media_get_tracklist");
+        static auto tracklistCount = (decltype(&libvlc_media_tracklist_count))luavlc_vlc_symbol("libvlc_media_tracklist_count");
+        static auto tracklistAt = (decltype(&libvlc_media_tracklist_at))luavlc_vlc_symbol("libvlc_media_tracklist_at");
+        static auto tracklistDelete = (decltype(&libvlc_media_tracklist_delete))luavlc_vlc_symbol("libvlc_media_tracklist_delete");
+        if(getTracklist == NULL || tracklistCount == NULL || tracklistAt == NULL || tracklistDelete == NULL)
+            return;
+        const libvlc_track_type_t types[] = {libvlc_track_video, libvlc_track_audio, libvlc_track_text};
+        for(libvlc_track_type_t type : types) {
+            libvlc_media_tracklist_t* list = getTracklist(media, type);
+            if(list == NULL)
+                continue;
+            size_t count = tracklistCount(list);
+            for(size_t i = 0; i < count; i++)
+                probe_add_track(result, tracklistAt(list, i));
+            tracklistDelete(list);
+        }
+    }
+
+    struct LuaVLC_ProbeWait {
+        std::mutex mutex;
+        std::condition_variable done;
+        bool finished = false;
+    };
+
+    static void probe_parsed_cb(const libvlc_event_t* event, void* opaque) {
+        LuaVLC_ProbeWait* wait = (LuaVLC_ProbeWait*)opaque;
+        std::lock_guard<std::mutex> lock(wait->mutex);
+        wait->finished = true;
+        wait->done.notify_all();
+    }
+
+    // stopping is the flag of the pool it's running on, it gives up waiting on vlc once that's set
+    static void probe_media(const std::string& path, LuaVLC_ProbeResult* result, const std::atomic<bool>& stopping) {
+        libvlc_media_t* media = luavlc_media_new_path(path.c_str());
+        if(media == NULL || media == nullptr)
+            return;
+
+        LuaVLC_ProbeWait wait;
+        libvlc_event_manager_t* events = libvlc_media_event_manager(media);
+        libvlc_event_attach(events, libvlc_MediaParsedChanged, probe_parsed_cb, &wait);
+
+        int started;
+        if(luavlc_vlc_major() < 4) {
+            typedef int (*parse_with_options_v3)(libvlc_media_t*, int, int);
+            static parse_with_options_v3 parse = (parse_with_options_v3)luavlc_vlc_symbol("libvlc_media_parse_with_options");
+            started = parse != NULL ? parse(media, 0, _probe_timeout_ms) : -1; // 0 is parse_local in 3.0
+        } else {
+            static auto parse = (decltype(&libvlc_media_parse_request))luavlc_vlc_symbol("libvlc_media_parse_request");
+            started = parse != NULL ? parse(_instance, media, libvlc_media_parse_local, _probe_timeout_ms) : -1;
+        }
+
+        if(started == 0) {
+            std::unique_lock<std::mutex> lock(wait.mutex);
+            double deadline = luavlc_now_ms() + _probe_timeout_ms + 1000.0;
+            while(!wait.finished && !stopping && luavlc_now_ms() < deadline)
+                wait.done.wait_for(lock, std::chrono::milliseconds(50));
+            if(!wait.finished) {
+                lock.unlock();
+                typedef void (*parse_stop_v3)(libvlc_media_t*);
+                if(luavlc_vlc_major() < 4)
+                    ((parse_stop_v3)(void*)&libvlc_media_parse_stop)(media);
+                else
+                    libvlc_media_parse_stop(_instance, media);
+            }
+        }
+        libvlc_event_detach(events, libvlc_MediaParsedChanged, probe_parsed_cb, &wait);
+
+        result->status = started == 0 ? probe_parsed_status(media) : LUAVLC_PROBE_FAILED;
+        if(result->status == LUAVLC_PROBE_PENDING)
+            result->status = LUAVLC_PROBE_TIMEOUT;
+        if(result->status == LUAVLC_PROBE_DONE) {
+            libvlc_time_t duration = libvlc_media_get_duration(media);
+            result->duration = duration > 0 ? (double)duration / 1000.0 : 0.0;
+            probe_collect_tracks(media, result);
+        }
+        libvlc_media_release(media);
+    }
+
+    static void probe_work(const LuaVLC_ProbeJob& job, LuaVLC_ProbeResult* result) {
+        LuaVLC_ProbeCacheEntry entry = {};
+        entry.result.id = job.id;
+        entry.result.status = LUAVLC_PROBE_FAILED;
+
+        std::error_code error;
+        std::filesystem::path path = std::filesystem::u8path(job.path);
+        entry.size = std::filesystem::file_size(path, error);
+        bool exists = !error;
+        if(exists)
+            entry.mtime = (int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+
+        bool hit = false, probed = false;
+        if(exists) {
+            std::lock_guard<std::mutex> lock(_probe_pool.mutex);
+            auto it = _probe_cache.find(job.path);
+            if(it != _probe_cache.end() && it->second.size == entry.size && it->second.mtime == entry.mtime) {
+                entry.result = it->second.result;
+                entry.result.id = job.id;
+                entry.result.cached = 1;
+                hit = true;
+            }
+        }
+        if(!hit && exists && _probe_pool.waitForInstance()) {
+            probe_media(job.path, &entry.result, _probe_pool.stopping);
+            probed = true;
+        }
+
+        // timeouts might work next time, so only keep real answers
+        if(probed && entry.result.status != LUAVLC_PROBE_TIMEOUT) {
+            std::lock_guard<std::mutex> lock(_probe_pool.mutex);
+            probe_cache_store(job.path, entry);
+        }
+        *result = entry.result;
+    }
+
+    static void probe_shutdown() {
+        _probe_pool.shutdown();
+    }
+
+    // workers is how many files get parsed at once, cacheFile can be NULL to not keep anything on disk
+    EXPORT_DLL void luavlc_probe_configure(int workers, int timeoutMs, const char* cacheFile) {
+        std::lock_guard<std::mutex> lock(_probe_pool.mutex);
+        _probe_pool.maxWorkers = std::max(workers, 1);
+        _probe_timeout_ms = timeoutMs > 0 ? timeoutMs : 5000;
+        _probe_cache_path = cacheFile != NULL ? std::filesystem::u8path(cacheFile) : std::filesystem::path();
+        if(!_probe_cache_path.empty())
+            probe_cache_load();
+    }
+
+    // queues a local file, returns the id its result will have
+    EXPORT_DLL int luavlc_probe_request(const char* path) {
+        return _probe_pool.request({0, path});
+    }
+
+    // copies up to max finished results into out, returns how many
+    EXPORT_DLL int luavlc_probe_poll(LuaVLC_ProbeResult* out, int max) {
+        std::lock_guard<std::mutex> lock(_probe_pool.mutex);
+        int count = std::min(max, (int)_probe_pool.finished.size());
+        if(count <= 0)
+            return 0;
+        memcpy(out, _probe_pool.finished.data(), sizeof(LuaVLC_ProbeResult) * count);
+        _probe_pool.finished.erase(_probe_pool.finished.begin(), _probe_pool.finished.begin() + count);
+        return count;
+    }
+
+    // how many requests haven't been picked up by poll yet
+    EXPORT_DLL int luavlc_probe_pending(void) {
+        std::lock_guard<std::mutex> lock(_probe_pool.mutex);
+        return (int)(_probe_pool.queue.size() + _probe_pool.finished.size()) + _probe_pool.active;
+    }
+
+    // thumbnails get cached as qoi (https://qoiformat.org), it compresses about as well as png
+    // but is tiny to write and much faster, and lua gets raw rgba back either way
+    static const unsigned char QOI_OP_INDEX = 0x00, QOI_OP_DIFF = 0x40, QOI_OP_LUMA = 0x80, QOI_OP_RUN = 0xC0, QOI_OP_RGB = 0xFE, QOI_OP_RGBA = 0xFF;
+
+    static inline int qoi_hash(const unsigned char* px) {
+        return (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+    }
+
+    static std::vector<unsigned char> qoi_encode(const unsigned char* rgba, unsigned int width, unsigned int height) {
+        std::vector<unsigned char> out;
+        out.reserve(14 + (size_t)width * height * 2 + 8);
+        const unsigned char header[14] = {'q', 'o', 'i', 'f',
+            (unsigned char)(width >> 24), (unsigned char)(width >> 16), (unsigned char)(width >> 8), (unsigned char)width,
+            (unsigned char)(height >> 24), (unsigned char)(height >> 16), (unsigned char)(height >> 8), (unsigned char)height, 4, 0};
+        out.insert(out.end(), header, header + 14);
+
+        unsigned char index[64][4] = {};
+        unsigned char prev[4] = {0, 0, 0, 255};
+        int run = 0;
+        size_t count = (size_t)width * height;
+        for(size_t i = 0; i < count; i++) {
+            const unsigned char* px = rgba + i * 4;
+            if(memcmp(px, prev, 4) == 0) {
+                if(++run == 62 || i == count - 1) {
+                    out.push_back((unsigned char)(QOI_OP_RUN | (run - 1)));
+                    run = 0;
+                }
+                continue;
+            }
+            if(run > 0) {
+                out.push_back((unsigned char)(QOI_OP_RUN | (run - 1)));
+                run = 0;
+            }
+            int hash = qoi_hash(px);
+            if(memcmp(index[hash], px, 4) == 0) {
+                out.push_back((unsigned char)(QOI_OP_INDEX | hash));
+            } else {
+                memcpy(index[hash], px, 4);
+                if(px[3] == prev[3]) {
+                    signed char dr = (signed char)(px[0] - prev[0]), dg = (signed char)(px[1] - prev[1]), db = (signed char)(px[2] - prev[2]);
+                    signed char drg = (signed char)(dr - dg), dbg = (signed char)(db - dg);
+                    if(dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                        out.push_back((unsigned char)(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                    } else if(dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                        out.push_back((unsigned char)(QOI_OP_LUMA | (dg + 32)));
+                        out.push_back((unsigned char)((drg + 8) << 4 | (dbg + 8)));
+                    } else {
+                        const unsigned char op[4] = {QOI_OP_RGB, px[0], px[1], px[2]};
+                        out.insert(out.end(), op, op + 4);
+                    }
+                } else {
+                    const unsigned char op[5] = {QOI_OP_RGBA, px[0], px[1], px[2], px[3]};
+                    out.insert(out.end(), op, op + 5);
+                }
+            }
+            memcpy(prev, px, 4);
+        }
+        const unsigned char end[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+        out.insert(out.end(), end, end + 8);
+        return out;
+    }
+
+    // returns a malloc'd rgba buffer, or NULL if the data isn't a valid qoi image
+    static unsigned char* qoi_decode(const unsigned char* data, size_t size, unsigned int* width, unsigned int* height) {
+        if(size < 22 || memcmp(data, "qoif", 4) != 0)
+            return NULL;
+        *width = (unsigned int)data[4] << 24 | data[5] << 16 | data[6] << 8 | data[7];
+        *height = (unsigned int)data[8] << 24 | data[9] << 16 | data[10] << 8 | data[11];
+        size_t count = (size_t)*width * *height;
+        if(count == 0 || count > (64u << 20))
+            return NULL;
+
+        unsigned char* pixels = (unsigned char*)malloc(count * 4);
+        unsigned char index[64][4] = {};
+        unsigned char px[4] = {0, 0, 0, 255};
+        size_t pos = 14, end = size - 8;
+        int run = 0;
+        for(size_t i = 0; i < count; i++) {
+            if(run > 0) {
+                run--;
+            } else if(pos < end) {
+                unsigned char op = data[pos++];
+                if(op == QOI_OP_RGB && pos + 3 <= end) {
+                    memcpy(px, data + pos, 3);
+                    pos += 3;
+                } else if(op == QOI_OP_RGBA && pos + 4 <= end) {
+                    memcpy(px, data + pos, 4);
+                    pos += 4;
+                } else if((op & 0xC0) == QOI_OP_INDEX) {
+                    memcpy(px, index[op], 4);
+                } else if((op & 0xC0) == QOI_OP_DIFF) {
+                    px[0] += ((op >> 4) & 3) - 2;
+                    px[1] += ((op >> 2) & 3) - 2;
+                    px[2] += (op & 3) - 2;
+                } else if((op & 0xC0) == QOI_OP_LUMA && pos < end) {
+                    unsigned char second = data[pos++];
+                    int dg = (op & 0x3F) - 32;
+                    px[0] += dg - 8 + ((second >> 4) & 0x0F);
+                    px[1] += dg;
+                    px[2] += dg - 8 + (second & 0x0F);
+                } else if((op & 0xC0) == QOI_OP_RUN) {
+                    run = op & 0x3F;
+                }
+                memcpy(index[qoi_hash(px)], px, 4);
+            }
+            memcpy(pixels + i * 4, px, 4);
+        }
+        return pixels;
+    }
+
+    // thumbnails, made on a small pool of worker threads and cached on disk
+    // 4.0 has a real thumbnailer, on 3.0 a hidden player decodes the one frame we want
+    typedef struct {
+        int id;
+        int status; // 0 = ok, 1 = failed
+        int cached;
+        unsigned int width;
+        unsigned int height;
+        unsigned char* pixels; // rgba, free with luavlc_thumbnail_free_pixels
+    } LuaVLC_ThumbnailResult;
+
+    struct LuaVLC_ThumbnailJob {
+        int id;
+        std::string path;
+        double time; // seconds, or < 0 to use position
+        double position; // 0 - 1
+        unsigned int width; // either can be 0 to keep the aspect ratio
+        unsigned int height;
+    };
+
+    static void thumbnail_work(const LuaVLC_ThumbnailJob& job, LuaVLC_ThumbnailResult* result);
+    static LuaVLC_WorkerPool<LuaVLC_ThumbnailJob, LuaVLC_ThumbnailResult> _thumb_pool(thumbnail_work, 2);
+    static int _thumb_timeout_ms = 10000;
+    static std::filesystem::path _thumb_cache_dir; // empty = nothing gets saved
+
+    static void thumbnail_fit(unsigned int sourceWidth, unsigned int sourceHeight, unsigned int* width, unsigned int* height) {
+        if(*width == 0 && *height == 0) {
+            *width = sourceWidth;
+            *height = sourceHeight;
+        } else if(*height == 0) {
+            *height = std::max(1u, (unsigned int)((double)*width * sourceHeight / std::max(sourceWidth, 1u) + 0.5));
+        } else if(*width == 0) {
+            *width = std::max(1u, (unsigned int)((double)*height * sourceWidth / std::max(sourceHeight, 1u) + 0.5));
+        }
+    }
+
+    // 3.0 fallback, decodes into a buffer vlc scales to the thumbnail size for us
+    struct LuaVLC_ThumbnailGrab {
+        std::mutex mutex;
+        std::condition_variable done;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        std::vector<unsigned char> scratch; // vlc decodes into this
+        std::vector<unsigned char> pixels; // the first finished frame gets copied here
+        bool finished = false;
+    };
+
+    static unsigned thumbnail_setup_cb(void** opaque, char* chroma, unsigned* width, unsigned* height, unsigned* pitches, unsigned* lines) {
+        LuaVLC_ThumbnailGrab* grab = (LuaVLC_ThumbnailGrab*)*opaque;
+        thumbnail_fit(*width, *height, &grab->width, &grab->height);
+        memcpy(chroma, "RGBA", 4);
+        *width = grab->width;
+        *height = grab->height;
+        pitches[0] = grab->width * 4;
+        lines[0] = grab->height;
+        grab->scratch.resize((size_t)grab->width * grab->height * 4);
+        return 1;
+    }
+
+    static void* thumbnail_lock_cb(void* opaque, void** planes) {
+        planes[0] = ((LuaVLC_ThumbnailGrab*)opaque)->scratch.data();
+        return NULL;
+    }
+
+    static void thumbnail_display_cb(void* opaque, void* picture) {
+        LuaVLC_ThumbnailGrab* grab = (LuaVLC_ThumbnailGrab*)opaque;
+        std::lock_guard<std::mutex> lock(grab->mutex);
+        if(grab->finished)
+            return;
+        grab->pixels = grab->scratch;
+        grab->finished = true;
+        grab->done.notify_all();
+    }
+
+    static bool thumbnail_generate_v3(const LuaVLC_ThumbnailJob& job, LuaVLC_ThumbnailResult* result) {
+        double time = job.time;
+        if(time < 0.0) {
+            // no way to start at a position, so find out how long it is first
+            LuaVLC_ProbeResult probe = {};
+            probe_media(job.path, &probe, _thumb_pool.stopping);
+            if(probe.status != LUAVLC_PROBE_DONE)
+                return false;
+            time = probe.duration * job.position;
+        }
+
+        libvlc_media_t* media = luavlc_media_new_path(job.path.c_str());
+        if(media == NULL || media == nullptr)
+            return false;
+        libvlc_media_add_option(media, ":no-audio");
+        libvlc_media_add_option(media, ":no-spu");
+        libvlc_media_add_option(media, (":start-time=" + std::to_string(time)).c_str());
+        libvlc_media_player_t* mp = luavlc_media_player_new_from_media(media);
+        libvlc_media_release(media);
+        if(mp == NULL || mp == nullptr)
+            return false;
+
+        LuaVLC_ThumbnailGrab grab;
+        grab.width = job.width;
+        grab.height = job.height;
+        libvlc_video_set_callbacks(mp, thumbnail_lock_cb, NULL, thumbnail_display_cb, &grab);
+        libvlc_video_set_format_callbacks(mp, thumbnail_setup_cb, NULL);
+        libvlc_media_player_play(mp);
+        {
+            std::unique_lock<std::mutex> lock(grab.mutex);
+            double deadline = luavlc_now_ms() + _thumb_timeout_ms;
+            while(!grab.finished && !_thumb_pool.stopping && luavlc_now_ms() < deadline) {
+                grab.done.wait_for(lock, std::chrono::milliseconds(50));
+                if(libvlc_media_player_get_state(mp) == libvlc_Error)
+                    break;
+            }
+        }
+        libvlc_media_player_release(mp); // stops it, so vlc is done with grab after this
+        if(!grab.finished)
+            return false;
+
+        result->width = grab.width;
+        result->height = grab.height;
+        result->pixels = (unsigned char*)malloc(grab.pixels.size());
+        memcpy(result->pixels, grab.pixels.data(), grab.pixels.size());
+        return true;
+    }
+
+    struct LuaVLC_ThumbnailWait {
+        std::mutex mutex;
+        std::condition_variable done;
+        libvlc_picture_t* picture = nullptr;
+        bool finished = false;
+    };
+
+    static void thumbnail_generated_cb(const libvlc_event_t* event, void* opaque) {
+        LuaVLC_ThumbnailWait* wait = (LuaVLC_ThumbnailWait*)opaque;
+        static auto pictureRetain = (decltype(&libvlc_picture_retain))luavlc_vlc_symbol("libvlc_picture_retain");
+        std::lock_guard<std::mutex> lock(wait->mutex);
+        libvlc_picture_t* picture = event->u.media_thumbnail_generated.p_thumbnail;
+        if(picture != NULL && pictureRetain != NULL)
+            wait->picture = pictureRetain(picture);
+        wait->finished = true;
+        wait->done.notify_all();
+    }
+
+    static bool thumbnail_generate_v4(const LuaVLC_ThumbnailJob& job, LuaVLC_ThumbnailResult* result) {
+        static auto byTime = (decltype(&libvlc_media_thumbnail_request_by_time))luavlc_vlc_symbol("libvlc_media_thumbnail_request_by_time");
+        static auto byPos = (decltype(&libvlc_media_thumbnail_request_by_pos))luavlc_vlc_symbol("libvlc_media_thumbnail_request_by_pos");
+        static auto requestDestroy = (decltype(&libvlc_media_thumbnail_request_destroy))luavlc_vlc_symbol("libvlc_media_thumbnail_request_destroy");
+        static auto pictureRelease = (decltype(&libvlc_picture_release))luavlc_vlc_symbol("libvlc_picture_release");
+        static auto pictureBuffer = (decltype(&libvlc_picture_get_buffer))luavlc_vlc_symbol("libvlc_picture_get_buffer");
+        static auto pictureStride = (decltype(&libvlc_picture_get_stride))luavlc_vlc_symbol("libvlc_picture_get_stride");
+        static auto pictureWidth = (decltype(&libvlc_picture_get_width))luavlc_vlc_symbol("libvlc_picture_get_width");
+        static auto pictureHeight = (decltype(&libvlc_picture_get_height))luavlc_vlc_symbol("libvlc_picture_get_height");
+        if(byTime == NULL || byPos == NULL || requestDestroy == NULL || pictureRelease == NULL || pictureBuffer == NULL
+            || pictureStride == NULL || pictureWidth == NULL || pictureHeight == NULL)
+            return false;
+
+        libvlc_media_t* media = luavlc_media_new_path(job.path.c_str());
+        if(media == NULL || media == nullptr)
+            return false;
+
+        LuaVLC_ThumbnailWait wait;
+        libvlc_event_manager_t* events = libvlc_media_event_manager(media);
+        libvlc_event_attach(events, libvlc_MediaThumbnailGenerated, thumbnail_generated_cb, &wait);
+        libvlc_media_thumbnail_request_t* request = job.time >= 0.0
+            ? byTime(_instance, media, (libvlc_time_t)(job.time * 1000.0), libvlc_media_thumbnail_seek_precise, job.width, job.height, false, libvlc_picture_Argb, _thumb_timeout_ms)
+            : byPos(_instance, media, job.position, libvlc_media_thumbnail_seek_precise, job.width, job.height, false, libvlc_picture_Argb, _thumb_timeout_ms);
+        if(request != NULL) {
+            std::unique_lock<std::mutex> lock(wait.mutex);
+            double deadline = luavlc_now_ms() + _thumb_timeout_ms + 1000.0;
+            while(!wait.finished && !_thumb_pool.stopping && luavlc_now_ms() < deadline)
+                wait.done.wait_for(lock, std::chrono::milliseconds(50));
+            lock.unlock();
+            requestDestroy(request); // cancels it if it isn't done, no events after this
+        }
+        libvlc_event_detach(events, libvlc_MediaThumbnailGenerated, thumbnail_generated_cb, &wait);
+        libvlc_media_release(media);
+        if(wait.picture == nullptr)
+            return false;
+
+        // argb in memory order, flip it around to rgba
+        size_t size = 0;
+        const unsigned char* buffer = pictureBuffer(wait.picture, &size);
+        unsigned int stride = pictureStride(wait.picture);
+        result->width = pictureWidth(wait.picture);
+        result->height = pictureHeight(wait.picture);
+        bool valid = buffer != NULL && result->width > 0 && (size_t)stride * result->height <= size && stride >= result->width * 4;
+        if(valid) {
+            result->pixels = (unsigned char*)malloc((size_t)result->width * result->height * 4);
+            for(unsigned int y = 0; y < result->height; y++) {
+                const unsigned char* src = buffer + (size_t)y * stride;
+                unsigned char* dest = result->pixels + (size_t)y * result->width * 4;
+                for(unsigned int x = 0; x < result->width; x++) {
+                    dest[x * 4 + 0] = src[x * 4 + 1];
+                    dest[x * 4 + 1] = src[x * 4 + 2];
+                    dest[x * 4 + 2] = src[x * 4 + 3];
+                    dest[x * 4 + 3] = src[x * 4 + 0];
+                }
+            }
+        }
+        pictureRelease(wait.picture);
+        return valid;
+    }
+
+    // the cache file name covers the file (path, size, modification time) and what was asked for
+    static std::filesystem::path thumbnail_cache_path(const LuaVLC_ThumbnailJob& job) {
+        std::error_code error;
+        std::filesystem::path path = std::filesystem::u8path(job.path);
+        uint64_t size = std::filesystem::file_size(path, error);
+        if(error)
+            return std::filesystem::path();
+        int64_t mtime = (int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+        std::string key = job.path + "|" + std::to_string(size) + "|" + std::to_string(mtime) + "|" + std::to_string(job.time)
+            + "|" + std::to_string(job.position) + "|" + std::to_string(job.width) + "x" + std::to_string(job.height);
+        return _thumb_cache_dir / (url_cache_key(key.c_str()) + ".qoi");
+    }
+
+    static void thumbnail_work(const LuaVLC_ThumbnailJob& job, LuaVLC_ThumbnailResult* result) {
+        result->status = 1;
+        std::filesystem::path cacheDir;
+        {
+            std::lock_guard<std::mutex> lock(_thumb_pool.mutex);
+            cacheDir = _thumb_cache_dir;
+        }
+
+        std::filesystem::path cachePath = cacheDir.empty() ? cacheDir : thumbnail_cache_path(job);
+        if(!cachePath.empty()) {
+            std::ifstream file(cachePath, std::ios::binary);
+            if(file) {
+                std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+                result->pixels = qoi_decode(data.data(), data.size(), &result->width, &result->height);
+                if(result->pixels != NULL) {
+                    result->status = 0;
+                    result->cached = 1;
+                    return;
+                }
+            }
+        }
+        bool made = false;
+        if(_thumb_pool.waitForInstance())
+            made = luavlc_vlc_major() < 4 ? thumbnail_generate_v3(job, result) : thumbnail_generate_v4(job, result);
+        if(made) {
+            result->status = 0;
+            if(!cachePath.empty()) {
+                std::vector<unsigned char> encoded = qoi_encode(result->pixels, result->width, result->height);
+                std::ofstream(cachePath, std::ios::binary).write((const char*)encoded.data(), (std::streamsize)encoded.size());
+            }
+        } else if(result->pixels != NULL) {
+            free(result->pixels);
+            result->pixels = NULL;
+        }
+    }
+
+    static void thumbnail_shutdown() {
+        _thumb_pool.shutdown();
+        for(LuaVLC_ThumbnailResult& result : _thumb_pool.finished)
+            free(result.pixels);
+        _thumb_pool.finished.clear();
+    }
+
+    // workers is how many thumbnails get made at once, cacheDirectory can be NULL to not keep anything on disk
+    EXPORT_DLL void luavlc_thumbnail_configure(int workers, int timeoutMs, const char* cacheDirectory) {
+        std::lock_guard<std::mutex> lock(_thumb_pool.mutex);
+        _thumb_pool.maxWorkers = std::max(workers, 1);
+        _thumb_timeout_ms = timeoutMs > 0 ? timeoutMs : 10000;
+        _thumb_cache_dir.clear();
+        if(cacheDirectory != NULL) {
+            std::error_code error;
+            _thumb_cache_dir = std::filesystem::u8path(cacheDirectory);
+            std::filesystem::create_directories(_thumb_cache_dir, error);
+        }
+    }
+
+    // time in seconds, or < 0 to use position (0 - 1) instead, returns the id its result will have
+    EXPORT_DLL int luavlc_thumbnail_request(const char* path, double time, double position, unsigned int width, unsigned int height) {
+        return _thumb_pool.request({0, path, time, position, width, height});
+    }
+
+    // takes one finished thumbnail, returns false if there isn't one
+    EXPORT_DLL bool luavlc_thumbnail_poll(LuaVLC_ThumbnailResult* out) {
+        return _thumb_pool.poll(out);
+    }
+
+    EXPORT_DLL void luavlc_thumbnail_free_pixels(unsigned char* pixels) {
+        free(pixels);
+    }
+
+    // keyframe index, so scrubbing can land on keyframes and never has to decode a whole gop per seek
+    // built from the container's own index (mp4 stss, matroska cues) on a background thread, and cached on disk
+    enum {
+        LUAVLC_KEYFRAMES_NONE = 0,
+        LUAVLC_KEYFRAMES_BUILDING,
+        LUAVLC_KEYFRAMES_READY,
+        LUAVLC_KEYFRAMES_FAILED // not a container we can read, or it has no index (fragmented mp4, live mkv, etc)
+    };
+
+    struct LuaVLC_KeyframeIndex {
+        std::atomic<int> status{LUAVLC_KEYFRAMES_BUILDING};
+        bool allKeyframes = false; // intra-only video, every seek is as cheap as a fast one
+        std::vector<double> times; // presentation times in ms, sorted, only touch once status is READY
+    };
+
+    static const uint32_t KEYFRAME_CACHE_VERSION = 1;
+    static const uint64_t KEYFRAME_MAX_ELEMENT = 256ull << 20; // biggest moov/cues we'll load
+
+    struct LuaVLC_KeyframeJob {
+        int id;
+        std::string path;
+        std::shared_ptr<LuaVLC_KeyframeIndex> index;
+    };
+
+    static void keyframes_work(const LuaVLC_KeyframeJob& job, LuaVLC_NoResult* result);
+    // one at a time, it's mostly waiting on the disk
+    static LuaVLC_WorkerPool<LuaVLC_KeyframeJob> _kf_pool(keyframes_work, 1);
+    static std::filesystem::path _kf_cache_dir;
+
+    static inline uint32_t kf_be32(const unsigned char* p) {
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+    }
+
+    static inline uint64_t kf_be64(const unsigned char* p) {
+        return (uint64_t)kf_be32(p) << 32 | kf_be32(p + 4);
+    }
+
+    static bool kf_read(std::ifstream& file, uint64_t offset, void* out, size_t size) {
+        file.clear();
+        file.seekg((std::streamoff)offset);
+        return (bool)file.read((char*)out, (std::streamsize)size);
+    }
+
+    // finds the first box of a type in [data, data + size), starting the search at *pos
+    static bool mp4_find(const unsigned char* data, size_t size, const char* type, const unsigned char** out, size_t* outSize, size_t* pos = nullptr) {
+        size_t offset = pos != nullptr ? *pos : 0;
+        while(offset + 8 <= size) {
+            uint64_t boxSize = kf_be32(data + offset);
+            size_t header = 8;
+            if(boxSize == 1 && offset + 16 <= size) {
+                boxSize = kf_be64(data + offset + 8);
+                header = 16;
+            } else if(boxSize == 0) {
+                boxSize = size - offset;
+            }
+            if(boxSize < header || boxSize > size - offset)
+                return false;
+            if(memcmp(data + offset + 4, type, 4) == 0) {
+                *out = data + offset + header;
+                *outSize = (size_t)boxSize - header;
+                if(pos != nullptr)
+                    *pos = offset + (size_t)boxSize;
+                return true;
+            }
+            offset += (size_t)boxSize;
+        }
+        return false;
+    }
+
+    // full box with a u32 entry count, returns the entries or NULL if they don't fit
+    static const unsigned char* mp4_table(const unsigned char* box, size_t size, size_t entrySize, uint32_t* count) {
+        if(box == nullptr || size < 8)
+            return NULL;
+        *count = kf_be32(box + 4);
+        if((uint64_t)*count * entrySize > size - 8)
+            return NULL;
+        return box + 8;
+    }
+
+    static bool mp4_video_keyframes(const unsigned char* trak, size_t trakSize, LuaVLC_KeyframeIndex* index) {
+        const unsigned char *mdia, *hdlr, *mdhd, *minf, *stbl;
+        size_t mdiaSize, hdlrSize, mdhdSize, minfSize, stblSize;
+        if(!mp4_find(trak, trakSize, "mdia", &mdia, &mdiaSize) || !mp4_find(mdia, mdiaSize, "hdlr", &hdlr, &hdlrSize)
+            || hdlrSize < 12 || memcmp(hdlr + 8, "vide", 4) != 0)
+            return false;
+        if(!mp4_find(mdia, mdiaSize, "mdhd", &mdhd, &mdhdSize) || !mp4_find(mdia, mdiaSize, "minf", &minf, &minfSize)
+            || !mp4_find(minf, minfSize, "stbl", &stbl, &stblSize))
+            return false;
+        uint32_t timescale = mdhd[0] == 1 ? (mdhdSize >= 24 ? kf_be32(mdhd + 20) : 0) : (mdhdSize >= 16 ? kf_be32(mdhd + 12) : 0);
+        if(timescale == 0)
+            return false;
+
+        // the first non-empty edit says where presentation time 0 is in media time
+        int64_t mediaStart = 0;
+        const unsigned char *edts, *elst;
+        size_t edtsSize, elstSize;
+        if(mp4_find(trak, trakSize, "edts", &edts, &edtsSize) && mp4_find(edts, edtsSize, "elst", &elst, &elstSize)) {
+            uint32_t edits = 0;
+            bool wide = elst[0] == 1;
+            const unsigned char* entries = mp4_table(elst, elstSize, wide ? 20 : 12, &edits);
+            for(uint32_t i = 0; entries != NULL && i < edits; i++) {
+                const unsigned char* edit = entries + i * (wide ? 20 : 12);
+                int64_t mediaTime = wide ? (int64_t)kf_be64(edit + 8) : (int64_t)(int32_t)kf_be32(edit + 4);
+                if(mediaTime >= 0) {
+                    mediaStart = mediaTime;
+                    break;
+                }
+            }
+        }
+
+        const unsigned char *stts, *stss, *ctts;
+        size_t sttsSize, stssSize, cttsSize;
+        uint32_t sttsCount = 0, stssCount = 0, cttsCount = 0;
+        const unsigned char* durations = mp4_find(stbl, stblSize, "stts", &stts, &sttsSize) ? mp4_table(stts, sttsSize, 8, &sttsCount) : NULL;
+        if(durations == NULL || sttsCount == 0)
+            return false; // fragmented, the samples are in moofs we don't look at
+        if(!mp4_find(stbl, stblSize, "stss", &stss, &stssSize)) {
+            index->allKeyframes = true;
+            return true;
+        }
+        const unsigned char* syncSamples = mp4_table(stss, stssSize, 4, &stssCount);
+        const unsigned char* offsets = mp4_find(stbl, stblSize, "ctts", &ctts, &cttsSize) ? mp4_table(ctts, cttsSize, 8, &cttsCount) : NULL;
+        if(syncSamples == NULL)
+            return false;
+
+        // sync samples are sorted, so walk the duration and offset runs alongside them
+        uint32_t sttsRun = 0, cttsRun = 0;
+        uint64_t sttsFirst = 1, cttsFirst = 1; // first sample number of the current run
+        uint64_t runTime = 0; // decode time of sttsFirst
+        index->times.reserve(stssCount);
+        for(uint32_t i = 0; i < stssCount; i++) {
+            uint64_t sample = kf_be32(syncSamples + i * 4);
+            while(sttsRun < sttsCount && sample >= sttsFirst + kf_be32(durations + sttsRun * 8)) {
+                uint32_t count = kf_be32(durations + sttsRun * 8);
+                runTime += (uint64_t)count * kf_be32(durations + sttsRun * 8 + 4);
+                sttsFirst += count;
+                sttsRun++;
+            }
+            if(sttsRun == sttsCount)
+                break;
+            int64_t time = (int64_t)(runTime + (sample - sttsFirst) * kf_be32(durations + sttsRun * 8 + 4));
+            if(offsets != NULL) {
+                while(cttsRun < cttsCount && sample >= cttsFirst + kf_be32(offsets + cttsRun * 8)) {
+                    cttsFirst += kf_be32(offsets + cttsRun * 8);
+                    cttsRun++;
+                }
+                if(cttsRun < cttsCount) // signed in version 1, and everyone writes it signed anyways
+                    time += (int32_t)kf_be32(offsets + cttsRun * 8 + 4);
+            }
+            index->times.push_back((double)(time - mediaStart) * 1000.0 / timescale);
+        }
+        return !index->times.empty();
+    }
+
+    static bool mp4_keyframes(std::ifstream& file, uint64_t fileSize, LuaVLC_KeyframeIndex* index) {
+        // moov can be anywhere at the top level (usually the very start or end)
+        uint64_t offset = 0;
+        while(offset + 8 <= fileSize) {
+            unsigned char header[16];
+            if(!kf_read(file, offset, header, 8))
+                return false;
+            uint64_t size = kf_be32(header);
+            uint64_t headerSize = 8;
+            if(size == 1) {
+                if(!kf_read(file, offset + 8, header + 8, 8))
+                    return false;
+                size = kf_be64(header + 8);
+                headerSize = 16;
+            } else if(size == 0) {
+                size = fileSize - offset;
+            }
+            if(size < headerSize)
+                return false;
+            if(offset == 0 && memcmp(header + 4, "ftyp", 4) != 0)
+                return false;
+            if(memcmp(header + 4, "moov", 4) == 0) {
+                if(size - headerSize > KEYFRAME_MAX_ELEMENT)
+                    return false;
+                std::vector<unsigned char> moov((size_t)(size - headerSize));
+                if(!kf_read(file, offset + headerSize, moov.data(), moov.size()))
+                    return false;
+                const unsigned char* trak;
+                size_t trakSize, pos = 0;
+                while(mp4_find(moov.data(), moov.size(), "trak", &trak, &trakSize, &pos)) {
+                    if(mp4_video_keyframes(trak, trakSize, index))
+                        return true;
+                }
+                return false;
+            }
+            offset += size;
+        }
+        return false;
+    }
+
+    // ebml element ids keep their length marker, sizes don't, returns false when it's out of data
+    static bool ebml_header(const unsigned char* data, size_t size, size_t* pos, uint32_t* id, uint64_t* elementSize, bool* unknown) {
+        if(*pos >= size || data[*pos] == 0)
+            return false;
+        int idLength = 1;
+        while(idLength <= 4 && !(data[*pos] & (0x80 >> (idLength - 1))))
+            idLength++;
+        if(idLength > 4 || *pos + idLength >= size)
+            return false;
+        *id = 0;
+        for(int i = 0; i < idLength; i++)
+            *id = *id << 8 | data[*pos + i];
+        *pos += idLength;
+
+        unsigned char first = data[*pos];
+        int sizeLength = 1;
+        while(sizeLength <= 8 && !(first & (0x80 >> (sizeLength - 1))))
+            sizeLength++;
+        if(sizeLength > 8 || *pos + sizeLength > size)
+            return false;
+        uint64_t value = first & (0xFF >> sizeLength);
+        bool allOnes = value == (uint64_t)(0xFF >> sizeLength);
+        for(int i = 1; i < sizeLength; i++) {
+            value = value << 8 | data[*pos + i];
+            allOnes = allOnes && data[*pos + i] == 0xFF;
+        }
+        *pos += sizeLength;
+        *elementSize = value;
+        *unknown = allOnes;
+        return true;
+    }
+
+    // next child element of the one in [data, data + size)
+    static bool ebml_next(const unsigned char* data, size_t size, size_t* pos, uint32_t* id, const unsigned char** child, size_t* childSize) {
+        uint64_t elementSize;
+        bool unknown;
+        if(!ebml_header(data, size, pos, id, &elementSize, &unknown) || unknown || elementSize > size - *pos)
+            return false;
+        *child = data + *pos;
+        *childSize = (size_t)elementSize;
+        *pos += (size_t)elementSize;
+        return true;
+    }
+
+    static uint64_t ebml_uint(const unsigned char* data, size_t size) {
+        uint64_t value = 0;
+        for(size_t i = 0; i < size && i < 8; i++)
+            value = value << 8 | data[i];
+        return value;
+    }
+
+    static bool mkv_read_element(std::ifstream& file, uint64_t offset, uint64_t fileSize, uint32_t* id, uint64_t* dataOffset, uint64_t* size, bool* unknown) {
+        unsigned char header[12] = {};
+        size_t available = (size_t)std::min<uint64_t>(sizeof(header), fileSize - offset);
+        if(!kf_read(file, offset, header, available))
+            return false;
+        size_t pos = 0;
+        if(!ebml_header(header, available, &pos, id, size, unknown))
+            return false;
+        *dataOffset = offset + pos;
+        return true;
+    }
+
+    static bool mkv_load(std::ifstream& file, uint64_t offset, uint64_t size, std::vector<unsigned char>& out) {
+        if(size > KEYFRAME_MAX_ELEMENT)
+            return false;
+        out.resize((size_t)size);
+        return kf_read(file, offset, out.data(), out.size());
+    }
+
+    static bool mkv_keyframes(std::ifstream& file, uint64_t fileSize, LuaVLC_KeyframeIndex* index) {
+        uint32_t id;
+        uint64_t dataOffset, size;
+        bool unknown;
+        if(!mkv_read_element(file, 0, fileSize, &id, &dataOffset, &size, &unknown) || id != 0x1A45DFA3 || unknown)
+            return false;
+        uint64_t offset = dataOffset + size;
+        if(!mkv_read_element(file, offset, fileSize, &id, &dataOffset, &size, &unknown) || id != 0x18538067)
+            return false;
+        uint64_t segmentStart = dataOffset;
+        uint64_t segmentEnd = unknown ? fileSize : std::min(fileSize, dataOffset + size);
+
+        uint64_t timecodeScale = 1000000; // ns per cue time unit
+        std::vector<uint64_t> videoTracks;
+        std::vector<unsigned char> cues, element;
+        uint64_t cuesOffset = 0;
+        offset = segmentStart;
+        while(offset < segmentEnd && mkv_read_element(file, offset, fileSize, &id, &dataOffset, &size, &unknown) && !unknown) {
+            const unsigned char* child;
+            size_t childSize, pos = 0;
+            uint32_t childId;
+            if(id == 0x114D9B74 && mkv_load(file, dataOffset, size, element)) { // seek head, says where the cues are
+                const unsigned char* seek;
+                size_t seekSize;
+                while(ebml_next(element.data(), element.size(), &pos, &childId, &seek, &seekSize)) {
+                    size_t seekPos = 0;
+                    uint64_t seekId = 0, seekPosition = 0;
+                    while(ebml_next(seek, seekSize, &seekPos, &childId, &child, &childSize)) {
+                        if(childId == 0x53AB)
+                            seekId = ebml_uint(child, childSize);
+                        else if(childId == 0x53AC)
+                            seekPosition = ebml_uint(child, childSize);
+                    }
+                    if(seekId == 0x1C53BB6B && cuesOffset == 0)
+                        cuesOffset = segmentStart + seekPosition;
+                }
+            } else if(id == 0x1549A966 && mkv_load(file, dataOffset, size, element)) { // info
+                while(ebml_next(element.data(), element.size(), &pos, &childId, &child, &childSize)) {
+                    if(childId == 0x2AD7B1)
+                        timecodeScale = ebml_uint(child, childSize);
+                }
+            } else if(id == 0x1654AE6B && mkv_load(file, dataOffset, size, element)) { // tracks
+                const unsigned char* entry;
+                size_t entrySize;
+                while(ebml_next(element.data(), element.size(), &pos, &childId, &entry, &entrySize)) {
+                    size_t entryPos = 0;
+                    uint64_t number = 0, type = 0;
+                    while(ebml_next(entry, entrySize, &entryPos, &childId, &child, &childSize)) {
+                        if(childId == 0xD7)
+                            number = ebml_uint(child, childSize);
+                        else if(childId == 0x83)
+                            type = ebml_uint(child, childSize);
+                    }
+                    if(type == 1)
+                        videoTracks.push_back(number);
+                }
+            } else if(id == 0x1C53BB6B) {
+                mkv_load(file, dataOffset, size, cues);
+            } else if(id == 0x1F43B675) {
+                break; // clusters from here on, the seek head has to get us to the cues
+            }
+            offset = dataOffset + size;
+        }
+        if(cues.empty() && cuesOffset > segmentStart && cuesOffset < fileSize
+            && mkv_read_element(file, cuesOffset, fileSize, &id, &dataOffset, &size, &unknown) && id == 0x1C53BB6B && !unknown)
+            mkv_load(file, dataOffset, size, cues);
+        if(cues.empty())
+            return false;
+
+        const unsigned char* point;
+        size_t pointSize, pos = 0;
+        uint32_t childId;
+        while(ebml_next(cues.data(), cues.size(), &pos, &childId, &point, &pointSize)) {
+            if(childId != 0xBB)
+                continue;
+            const unsigned char* child;
+            size_t childSize, pointPos = 0;
+            uint64_t time = 0;
+            bool video = videoTracks.empty();
+            while(ebml_next(point, pointSize, &pointPos, &childId, &child, &childSize)) {
+                if(childId == 0xB3) {
+                    time = ebml_uint(child, childSize);
+                } else if(childId == 0xB7) {
+                    const unsigned char* position;
+                    size_t positionSize, positionPos = 0;
+                    while(ebml_next(child, childSize, &positionPos, &childId, &position, &positionSize)) {
+                        if(childId == 0xF7 && std::find(videoTracks.begin(), videoTracks.end(), ebml_uint(position, positionSize)) != videoTracks.end())
+                            video = true;
+                    }
+                }
+            }
+            if(video)
+                index->times.push_back((double)time * (double)timecodeScale / 1000000.0);
+        }
+        return !index->times.empty();
+    }
+
+    static std::filesystem::path keyframes_cache_path(const std::string& path) {
+        std::error_code error;
+        std::filesystem::path file = std::filesystem::u8path(path);
+        uint64_t size = std::filesystem::file_size(file, error);
+        if(error || _kf_cache_dir.empty())
+            return std::filesystem::path();
+        int64_t mtime = (int64_t)std::filesystem::last_write_time(file, error).time_since_epoch().count();
+        std::string key = path + "|" + std::to_string(size) + "|" + std::to_string(mtime);
+        return _kf_cache_dir / (url_cache_key(key.c_str()) + ".kfi");
+    }
+
+    static bool keyframes_cache_load(const std::filesystem::path& path, LuaVLC_KeyframeIndex* index) {
+        std::ifstream file(path, std::ios::binary);
+        uint32_t header[4];
+        if(!file || !file.read((char*)header, sizeof(header)) || memcmp(header, "LVKF", 4) != 0 || header[1] != KEYFRAME_CACHE_VERSION)
+            return false;
+        index->allKeyframes = header[2] != 0;
+        index->times.resize(header[3]);
+        return (bool)file.read((char*)index->times.data(), (std::streamsize)(index->times.size() * sizeof(double)));
+    }
+
+    static void keyframes_cache_store(const std::filesystem::path& path, const LuaVLC_KeyframeIndex* index) {
+        std::ofstream file(path, std::ios::binary);
+        uint32_t header[4] = {0, KEYFRAME_CACHE_VERSION, index->allKeyframes ? 1u : 0u, (uint32_t)index->times.size()};
+        memcpy(header, "LVKF", 4);
+        file.write((const char*)header, sizeof(header));
+        file.write((const char*)index->times.data(), (std::streamsize)(index->times.size() * sizeof(double)));
+    }
+
+    static void keyframes_build(const std::string& path, LuaVLC_KeyframeIndex* index) {
+        std::filesystem::path cachePath;
+        {
+            std::lock_guard<std::mutex> lock(_kf_pool.mutex);
+            cachePath = keyframes_cache_path(path);
+        }
+        if(!cachePath.empty() && keyframes_cache_load(cachePath, index)) {
+            index->status.store(LUAVLC_KEYFRAMES_READY, std::memory_order_release);
+            return;
+        }
+
+        std::ifstream file(std::filesystem::u8path(path), std::ios::binary);
+        std::error_code error;
+        uint64_t fileSize = std::filesystem::file_size(std::filesystem::u8path(path), error);
+        bool built = false;
+        if(file && !error) {
+            built = mp4_keyframes(file, fileSize, index);
+            if(!built && !index->allKeyframes) {
+                index->times.clear();
+                built = mkv_keyframes(file, fileSize, index);
+            }
+        }
+        if(!built) {
+            index->times.clear();
+            index->status.store(LUAVLC_KEYFRAMES_FAILED, std::memory_order_release);
+            return;
+        }
+        std::sort(index->times.begin(), index->times.end());
+        index->times.erase(std::unique(index->times.begin(), index->times.end()), index->times.end());
+        if(!cachePath.empty())
+            keyframes_cache_store(cachePath, index);
+        index->status.store(LUAVLC_KEYFRAMES_READY, std::memory_order_release);
+    }
+
+    static void keyframes_work(const LuaVLC_KeyframeJob& job, LuaVLC_NoResult* result) {
+        // skip it if the video's been released in the meantime
+        if(job.index.use_count() > 1)
+            keyframes_build(job.path, job.index.get());
+    }
+
+    static void keyframes_shutdown() {
+        _kf_pool.shutdown();
+    }
+
+    // where keyframe indexes get cached, NULL to not keep them on disk
+    EXPORT_DLL void luavlc_keyframes_configure(const char* cacheDirectory) {
+        std::lock_guard<std::mutex> lock(_kf_pool.mutex);
+        _kf_cache_dir.clear();
+        if(cacheDirectory != NULL) {
+            std::error_code error;
+            _kf_cache_dir = std::filesystem::u8path(cacheDirectory);
+            std::filesystem::create_directories(_kf_cache_dir, error);
+        }
+    }
+
+    // starts building the keyframe index of the file the video is playing, it's used as soon as it's done
+    EXPORT_DLL void luavlc_video_index_keyframes(LuaVLC_Video* video, const char* path) {
+        if(video == NULL || video == nullptr || path == NULL)
+            return;
+        std::shared_ptr<LuaVLC_KeyframeIndex> index = std::make_shared<LuaVLC_KeyframeIndex>();
+        std::atomic_store(&video->keyframes, index);
+        _kf_pool.request({0, path, index});
+    }
+
+    // copies up to max keyframe times (in ms) into out, returns how many there are in total
+    // or -1 if the index isn't ready (yet)
+    EXPORT_DLL int luavlc_video_keyframes(LuaVLC_Video* video, double* out, int max) {
+        std::shared_ptr<LuaVLC_KeyframeIndex> index = std::atomic_load(&video->keyframes);
+        if(index == nullptr || index->status.load(std::memory_order_acquire) != LUAVLC_KEYFRAMES_READY)
+            return -1;
+        int count = (int)index->times.size();
+        if(out != NULL)
+            memcpy(out, index->times.data(), sizeof(double) * std::min(count, std::max(max, 0)));
+        return count;
+    }
+
+    // nearest keyframe to timeMs, or -1 if there's no index to go by
+    static double keyframe_nearest(LuaVLC_Video* video, double timeMs) {
+        std::shared_ptr<LuaVLC_KeyframeIndex> index = std::atomic_load(&video->keyframes);
+        if(index == nullptr || index->status.load(std::memory_order_acquire) != LUAVLC_KEYFRAMES_READY)
+            return -1.0;
+        if(index->allKeyframes)
+            return timeMs;
+        const std::vector<double>& times = index->times;
+        auto after = std::lower_bound(times.begin(), times.end(), timeMs);
+        if(after == times.begin())
+            return *after;
+        if(after == times.end() || timeMs - *(after - 1) <= *after - timeMs)
+            return *(after - 1);
+        return *after;
+    }
+
+    static const double SCRUB_WAIT_MS = 250.0; // longest a scrub waits on the last seek before going anyways
+    static const double SEEK_LATENCY_LIMIT_MS = 10000.0; // anything slower is a seek that never showed a frame (stopped, ended...)
+
+    static void video_seek(LuaVLC_Video* video, double timeMs, int mode) {
+        libvlc_media_player_t* mp = video->mediaPlayer;
+        frame_cache_anchor(video, timeMs);
+        int state = (int)libvlc_media_player_get_state(mp);
+        if(state == libvlc_Playing || state == libvlc_Paused) {
+            video->seekStartMs.store(luavlc_now_ms(), std::memory_order_relaxed);
+            video->seekPending.store(mode, std::memory_order_release);
+        }
+        if(mode == LUAVLC_SEEK_FAST) {
+            double keyframe = keyframe_nearest(video, timeMs);
+            if(keyframe >= 0.0) {
+                // a precise seek right onto a keyframe has nothing to decode before it, this works on 3.0 too
+                // (1ms past it so rounding can't put us on the frame before, and back a whole gop)
+                frame_cache_anchor(video, keyframe);
+                luavlc_media_player_set_time(mp, (libvlc_time_t)std::ceil(keyframe) + 1, false);
+                return;
+            }
+        }
+        luavlc_media_player_set_time(mp, (libvlc_time_t)timeMs, mode == LUAVLC_SEEK_FAST);
+    }
+
+    static void seek_finished(LuaVLC_Video* video, int mode) {
+        double latency = luavlc_now_ms() - video->seekStartMs.load(std::memory_order_relaxed);
+        if(latency > SEEK_LATENCY_LIMIT_MS || mode < 0 || mode >= LUAVLC_SEEK_MODES)
+            return;
+        std::lock_guard<std::mutex> lock(video->seekMutex);
+        LuaVLC_SeekStats& stats = video->seekStats;
+        stats.count[mode]++;
+        stats.lastMs[mode] = latency;
+        stats.totalMs[mode] += latency;
+        stats.maxMs[mode] = std::max(stats.maxMs[mode], latency);
+    }
+
+    static void scrub_flush(LuaVLC_Video* video, double now) {
+        if(video->seekPending.load(std::memory_order_acquire) >= 0 && now - video->seekStartMs.load(std::memory_order_relaxed) < SCRUB_WAIT_MS)
+            return;
+        video->scrubTarget = video->scrubDeferred;
+        video->scrubDeferred = -1.0;
+        video_seek(video, video->scrubTarget, LUAVLC_SEEK_FAST);
+    }
+
+    // mode is LUAVLC_SEEK_*
+    EXPORT_DLL void luavlc_video_seek(LuaVLC_Video* video, double timeMs, int mode) {
+        if(video == NULL || video == nullptr || video->mediaPlayer == nullptr)
+            return;
+        video->scrubTarget = -1.0;
+        video->scrubDeferred = -1.0;
+        video_seek(video, std::max(timeMs, 0.0), mode);
+    }
+
+    // for dragging a timeline around: fast seeks while it's moving, only ever one in flight (newer ones
+    // replace whatever was waiting), and a precise seek when it's let go, returns the time it'll land on
+    EXPORT_DLL double luavlc_video_scrub(LuaVLC_Video* video, double timeMs, bool released) {
+        if(video == NULL || video == nullptr || video->mediaPlayer == nullptr)
+            return timeMs;
+        timeMs = std::max(timeMs, 0.0);
+        if(released) {
+            luavlc_video_seek(video, timeMs, LUAVLC_SEEK_PRECISE);
+            return timeMs;
+        }
+        double target = keyframe_nearest(video, timeMs);
+        if(target < 0.0)
+            target = timeMs;
+        if(target == video->scrubTarget || target == video->scrubDeferred) {
+            if(target == video->scrubTarget && video->scrubDeferred >= 0.0) {
+                std::lock_guard<std::mutex> lock(video->seekMutex);
+                video->seekStats.coalesced++;
+                video->scrubDeferred = -1.0;
+            }
+            return target;
+        }
+        if(video->scrubDeferred >= 0.0) {
+            std::lock_guard<std::mutex> lock(video->seekMutex);
+            video->seekStats.coalesced++;
+        }
+        video->scrubDeferred = target;
+        scrub_flush(video, luavlc_now_ms());
+        return target;
+    }
+
+    EXPORT_DLL void luavlc_video_seek_stats(LuaVLC_Video* video, LuaVLC_SeekStats* out) {
+        {
+            std::lock_guard<std::mutex> lock(video->seekMutex);
+            *out = video->seekStats;
+        }
+        std::shared_ptr<LuaVLC_KeyframeIndex> index = std::atomic_load(&video->keyframes);
+        out->keyframeIndex = index != nullptr ? index->status.load(std::memory_order_acquire) : LUAVLC_KEYFRAMES_NONE;
+        out->keyframes = out->keyframeIndex == LUAVLC_KEYFRAMES_READY ? (unsigned int)index->times.size() : 0;
+    }
+
+    // decoded frames kept around the playhead, so stepping back (or scrubbing a few frames) doesn't
+    // have to seek and decode a whole gop again. frames are stored as 4:2:0 yuv (3/8 the size of rgba)
+    // and keyed by frame number, the cache keeps its own frame clock since 3.0's get_time only
+    // updates every 250ms
+    typedef struct {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        uint64_t captured; // frames stored from the player itself
+        uint64_t lookahead; // frames stored by the lookahead worker
+        unsigned int frames;
+        uint64_t bytes;
+        uint64_t budget;
+        double frameMs;
+    } LuaVLC_FrameCacheStats;
+
+    struct LuaVLC_CachedFrame {
+        std::vector<unsigned char> yuv;
+        uint64_t lastUse = 0;
+    };
+
+    struct LuaVLC_FrameCache {
+        std::mutex mutex;
+        std::map<int64_t, LuaVLC_CachedFrame> frames; // frame number -> frame
+        LuaVLC_Video* video = nullptr;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        double frameMs = 0.0;
+        uint64_t budget = 0;
+        uint64_t bytes = 0;
+        uint64_t useClock = 0;
+        int64_t current = -1; // frame on screen, -1 if we don't know
+        bool detached = false; // a cached frame is showing, the player itself is somewhere else
+
+        // frame clock of the player, anchored by seeks and re-anchored if it drifts from vlc's time
+        bool anchored = false;
+        int64_t nextFrame = 0;
+
+        LuaVLC_FrameCacheStats stats = {};
+
+        // lookahead fills, decode [fillFrom, fillTo] on a hidden player of their own in _fill_pool
+        std::string path;
+        double lookaheadMs = 0.0;
+        std::condition_variable wake;
+        bool stopping = false;
+        bool filling = false; // a fill job is queued or running
+        bool fillRunning = false;
+        bool fillQueued = false;
+        int64_t fillFrom = 0;
+        int64_t fillTo = 0;
+    };
+
+    static inline unsigned char frame_clamp(int value) {
+        return (unsigned char)(value < 0 ? 0 : value > 255 ? 255 : value);
+    }
+
+    static inline size_t video_pitch(const LuaVLC_Video* video) {
+        return video->pitch != 0 ? video->pitch : (size_t)video->width * 4;
+    }
+
+    // bt.601 full range, 16.16 fixed point. pitch is the rgba's bytes per row
+    static void frame_rgba_to_yuv(const unsigned char* rgba, unsigned int width, unsigned int height, size_t pitch, unsigned char* yuv) {
+        unsigned int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+        unsigned char* yPlane = yuv;
+        unsigned char* uPlane = yuv + (size_t)width * height;
+        unsigned char* vPlane = uPlane + (size_t)chromaWidth * chromaHeight;
+        for(unsigned int y = 0; y < height; y++) {
+            const unsigned char* src = rgba + y * pitch;
+            unsigned char* dest = yPlane + (size_t)y * width;
+            for(unsigned int x = 0; x < width; x++)
+                dest[x] = (unsigned char)((19595 * src[x * 4] + 38470 * src[x * 4 + 1] + 7471 * src[x * 4 + 2] + 32768) >> 16);
+        }
+        for(unsigned int cy = 0; cy < chromaHeight; cy++) {
+            unsigned int y0 = cy * 2, y1 = std::min(y0 + 1, height - 1);
+            for(unsigned int cx = 0; cx < chromaWidth; cx++) {
+                unsigned int x0 = cx * 2, x1 = std::min(x0 + 1, width - 1);
+                const unsigned char* p[4] = {
+                    rgba + y0 * pitch + x0 * 4, rgba + y0 * pitch + x1 * 4,
+                    rgba + y1 * pitch + x0 * 4, rgba + y1 * pitch + x1 * 4
+                };
+                int r = (p[0][0] + p[1][0] + p[2][0] + p[3][0] + 2) >> 2;
+                int g = (p[0][1] + p[1][1] + p[2][1] + p[3][1] + 2) >> 2;
+                int b = (p[0][2] + p[1][2] + p[2][2] + p[3][2] + 2) >> 2;
+                uPlane[(size_t)cy * chromaWidth + cx] = frame_clamp(((-11059 * r - 21709 * g + 32768 * b + 32768) >> 16) + 128);
+                vPlane[(size_t)cy * chromaWidth + cx] = frame_clamp(((32768 * r - 27439 * g - 5329 * b + 32768) >> 16) + 128);
+            }
+        }
+    }
+
+    static void frame_yuv_to_rgba(const unsigned char* yuv, unsigned int width, unsigned int height, size_t pitch, unsigned char* rgba) {
+        unsigned int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+        const unsigned char* yPlane = yuv;
+        const unsigned char* uPlane = yuv + (size_t)width * height;
+        const unsigned char* vPlane = uPlane + (size_t)chromaWidth * chromaHeight;
+        for(unsigned int y = 0; y < height; y++) {
+            const unsigned char* yRow = yPlane + (size_t)y * width;
+            const unsigned char* uRow = uPlane + (size_t)(y / 2) * chromaWidth;
+            const unsigned char* vRow = vPlane + (size_t)(y / 2) * chromaWidth;
+            unsigned char* dest = rgba + y * pitch;
+            for(unsigned int x = 0; x < width; x++) {
+                int luma = yRow[x] << 16;
+                int u = uRow[x / 2] - 128, v = vRow[x / 2] - 128;
+                dest[x * 4 + 0] = frame_clamp((luma + 91881 * v + 32768) >> 16);
+                dest[x * 4 + 1] = frame_clamp((luma - 22554 * u - 46802 * v + 32768) >> 16);
+                dest[x * 4 + 2] = frame_clamp((luma + 116130 * u + 32768) >> 16);
+                dest[x * 4 + 3] = 255;
+            }
+        }
+    }
+
+    static size_t frame_yuv_size(unsigned int width, unsigned int height) {
+        return (size_t)width * height + (size_t)((width + 1) / 2) * ((height + 1) / 2) * 2;
+    }
+
+    // how long one frame is, from the selected video track's frame rate
+    static double frame_duration_ms(libvlc_media_player_t* mp) {
+        double fps = 0.0;
+        if(luavlc_vlc_major() < 4) {
+            typedef float (*get_fps_v3)(libvlc_media_player_t*);
+            static get_fps_v3 getFps = (get_fps_v3)luavlc_vlc_symbol("libvlc_media_player_get_fps");
+            if(getFps != NULL)
+                fps = getFps(mp);
+        } else {
+            static auto getSelected = (decltype(&libvlc_media_player_get_selected_track))luavlc_vlc_symbol("libvlc_media_player_get_selected_track");
+            static auto trackRelease = (decltype(&libvlc_media_track_release))luavlc_vlc_symbol("libvlc_media_track_release");
+            libvlc_media_track_t* track = getSelected != NULL && trackRelease != NULL ? getSelected(mp, libvlc_track_video) : NULL;
+            if(track != NULL) {
+                if(track->video != NULL && track->video->i_frame_rate_den != 0)
+                    fps = (double)track->video->i_frame_rate_num / track->video->i_frame_rate_den;
+                trackRelease(track);
+            }
+        }
+        return fps > 1.0 && fps < 1000.0 ? 1000.0 / fps : 0.0;
+    }
+
+    // call with the cache locked
+    static void frame_cache_insert(LuaVLC_FrameCache* cache, int64_t frame, const unsigned char* rgba, size_t pitch) {
+        LuaVLC_CachedFrame& entry = cache->frames[frame];
+        entry.lastUse = ++cache->useClock;
+        if(entry.yuv.empty()) {
+            size_t size = frame_yuv_size(cache->width, cache->height);
+            entry.yuv.resize(size);
+            cache->bytes += size;
+            memory_track(cache->video, LUAVLC_MEM_FRAME_CACHE, (int64_t)size);
+        }
+        frame_rgba_to_yuv(rgba, cache->width, cache->height, pitch, entry.yuv.data());
+
+        // least recently used goes first, the frame on screen never does
+        while(cache->bytes > cache->budget && cache->frames.size() > 1) {
+            auto oldest = cache->frames.end();
+            for(auto it = cache->frames.begin(); it != cache->frames.end(); ++it) {
+                if(it->first != cache->current && it->first != frame && (oldest == cache->frames.end() || it->second.lastUse < oldest->second.lastUse))
+                    oldest = it;
+            }
+            if(oldest == cache->frames.end())
+                break;
+            cache->bytes -= oldest->second.yuv.size();
+            memory_track(cache->video, LUAVLC_MEM_FRAME_CACHE, -(int64_t)oldest->second.yuv.size());
+            cache->frames.erase(oldest);
+            cache->stats.evictions++;
+        }
+    }
+
+    // how many frames our own count can be off from vlc's time before we believe vlc instead,
+    // 3.0's time lags by up to 250ms
+    static inline int64_t frame_cache_tolerance(double frameMs) {
+        return luavlc_vlc_major() < 4 ? (int64_t)(500.0 / frameMs) + 1 : 1;
+    }
+
+    static void frame_cache_capture(LuaVLC_Video* video) {
+        std::shared_ptr<LuaVLC_FrameCache> cache = std::atomic_load(&video->frameCache);
+        if(cache == nullptr || video->pixelBuffer == nullptr)
+            return;
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        if(cache->stopping || cache->width != video->width || cache->height != video->height || cache->width == 0 || cache->height == 0)
+            return;
+        if(cache->frameMs <= 0.0) {
+            cache->frameMs = frame_duration_ms(video->mediaPlayer);
+            if(cache->frameMs <= 0.0)
+                return;
+        }
+        double vlcTime = (double)libvlc_media_player_get_time(video->mediaPlayer);
+        int64_t vlcFrame = (int64_t)std::llround(vlcTime / cache->frameMs);
+        if(!cache->anchored || std::abs(cache->nextFrame - vlcFrame) > frame_cache_tolerance(cache->frameMs)) {
+            cache->nextFrame = vlcFrame;
+            cache->anchored = true;
+        }
+        int64_t frame = cache->nextFrame++;
+        frame_cache_insert(cache.get(), frame, video->pixelBuffer, video_pitch(video));
+        cache->current = frame;
+        cache->detached = false;
+        cache->stats.captured++;
+    }
+
+    // the next frame the player shows is the one at timeMs
+    static void frame_cache_anchor(LuaVLC_Video* video, double timeMs) {
+        std::shared_ptr<LuaVLC_FrameCache> cache = std::atomic_load(&video->frameCache);
+        if(cache == nullptr)
+            return;
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        cache->detached = false; // the player's going somewhere new, whatever the cache showed is old news
+        if(cache->frameMs > 0.0) {
+            cache->nextFrame = (int64_t)std::ceil(timeMs / cache->frameMs - 0.01);
+            cache->anchored = true;
+        }
+    }
+
+    struct LuaVLC_FrameCacheFill {
+        LuaVLC_FrameCache* cache;
+        libvlc_media_player_t* mp;
+        double frameMs;
+        std::vector<unsigned char> scratch;
+        int64_t nextFrame;
+        std::vector<int64_t> inserted; // frames this fill put in the cache
+        std::mutex mutex;
+        std::condition_variable done;
+        bool finished = false;
+    };
+
+    static unsigned frame_fill_setup_cb(void** opaque, char* chroma, unsigned* width, unsigned* height, unsigned* pitches, unsigned* lines) {
+        LuaVLC_FrameCacheFill* fill = (LuaVLC_FrameCacheFill*)*opaque;
+        memcpy(chroma, "RGBA", 4);
+        *width = fill->cache->width;
+        *height = fill->cache->height;
+        pitches[0] = *width * 4;
+        lines[0] = *height;
+        fill->scratch.resize((size_t)*width * *height * 4);
+        return 1;
+    }
+
+    static void* frame_fill_lock_cb(void* opaque, void** planes) {
+        planes[0] = ((LuaVLC_FrameCacheFill*)opaque)->scratch.data();
+        return NULL;
+    }
+
+    static void frame_fill_display_cb(void* opaque, void* picture) {
+        LuaVLC_FrameCacheFill* fill = (LuaVLC_FrameCacheFill*)opaque;
+        LuaVLC_FrameCache* cache = fill->cache;
+        bool finished;
+        {
+            std::lock_guard<std::mutex> lock(cache->mutex);
+            int64_t frame = fill->nextFrame++;
+            // the count assumes the first picture is exactly the start time, if vlc's time says otherwise
+            // every frame of this fill could be numbered wrong, so none of them get kept.
+            // 3.0 can still say 0 for the first few, those get checked by the ones after
+            double vlcTime = (double)libvlc_media_player_get_time(fill->mp);
+            if(vlcTime > 0.0 && std::abs(frame - (int64_t)std::llround(vlcTime / fill->frameMs)) > frame_cache_tolerance(fill->frameMs)) {
+                for(int64_t wrong : fill->inserted) {
+                    auto it = cache->frames.find(wrong);
+                    if(it == cache->frames.end())
+                        continue;
+                    memory_track(cache->video, LUAVLC_MEM_FRAME_CACHE, -(int64_t)it->second.yuv.size());
+                    cache->bytes -= it->second.yuv.size();
+                    cache->frames.erase(it);
+                    cache->stats.lookahead--;
+                }
+                fill->inserted.clear();
+                finished = true;
+            } else {
+                // whatever the player itself has is newer, don't touch it
+                if(cache->frames.find(frame) == cache->frames.end()) {
+                    frame_cache_insert(cache, frame, fill->scratch.data(), (size_t)cache->width * 4);
+                    fill->inserted.push_back(frame);
+                    cache->stats.lookahead++;
+                }
+                finished = cache->stopping || frame >= cache->fillTo || cache->fillQueued;
+            }
+        }
+        if(finished) {
+            std::lock_guard<std::mutex> lock(fill->mutex);
+            fill->finished = true;
+            fill->done.notify_all();
+        }
+    }
+
+    static void frame_cache_fill(LuaVLC_FrameCache* cache, int64_t from, int64_t to, double frameMs) {
+        libvlc_media_t* media = luavlc_media_new_path(cache->path.c_str());
+        if(media == NULL || media == nullptr)
+            return;
+        libvlc_media_add_option(media, ":no-audio");
+        libvlc_media_add_option(media, ":no-spu");
+        libvlc_media_add_option(media, (":start-time=" + std::to_string(from * frameMs / 1000.0)).c_str());
+        libvlc_media_player_t* mp = luavlc_media_player_new_from_media(media);
+        libvlc_media_release(media);
+        if(mp == NULL || mp == nullptr)
+            return;
+
+        LuaVLC_FrameCacheFill fill;
+        fill.cache = cache;
+        fill.mp = mp;
+        fill.frameMs = frameMs;
+        fill.nextFrame = from;
+        libvlc_video_set_callbacks(mp, frame_fill_lock_cb, NULL, frame_fill_display_cb, &fill);
+        libvlc_video_set_format_callbacks(mp, frame_fill_setup_cb, NULL);
+        libvlc_media_player_play(mp);
+        {
+            std::unique_lock<std::mutex> lock(fill.mutex);
+            // plays in real time, so give it as long as the range is plus some time to open
+            double deadline = luavlc_now_ms() + (double)(to - from + 1) * frameMs * 2.0 + 3000.0;
+            while(!fill.finished && luavlc_now_ms() < deadline) {
+                fill.done.wait_for(lock, std::chrono::milliseconds(50));
+                // stopped, ended (3.0's Ended is 4.0's Stopping) or failed
+                if(libvlc_media_player_get_state(mp) >= libvlc_Stopped)
+                    break;
+            }
+        }
+        libvlc_media_player_release(mp); // stops it, no callbacks after this
+    }
+
+    struct LuaVLC_FrameCacheJob {
+        int id;
+        std::shared_ptr<LuaVLC_FrameCache> cache;
+    };
+
+    static void frame_cache_work(const LuaVLC_FrameCacheJob& job, LuaVLC_NoResult* result);
+    static LuaVLC_WorkerPool<LuaVLC_FrameCacheJob> _fill_pool(frame_cache_work, 2);
+
+    // keeps going while requests come in, so a cache only ever has one fill job
+    static void frame_cache_work(const LuaVLC_FrameCacheJob& job, LuaVLC_NoResult* result) {
+        LuaVLC_FrameCache* cache = job.cache.get();
+        std::unique_lock<std::mutex> lock(cache->mutex);
+        cache->fillRunning = true;
+        while(cache->fillQueued && !cache->stopping && !_fill_pool.stopping) {
+            cache->fillQueued = false;
+            int64_t from = cache->fillFrom, to = cache->fillTo;
+            double frameMs = cache->frameMs;
+            // skip what's already there at the start, stepping back usually leaves a tail cached
+            while(from <= to && cache->frames.find(from) != cache->frames.end())
+                from++;
+            if(from > to || _instance == nullptr)
+                continue;
+            lock.unlock();
+            frame_cache_fill(cache, from, to, frameMs);
+            lock.lock();
+        }
+        cache->fillRunning = false;
+        cache->filling = false;
+        cache->wake.notify_all();
+    }
+
+    // call with the cache locked
+    static void frame_cache_request_fill(const std::shared_ptr<LuaVLC_FrameCache>& cache, int64_t from, int64_t to) {
+        if(cache->path.empty() || cache->lookaheadMs <= 0.0 || cache->stopping)
+            return;
+        cache->fillFrom = std::max<int64_t>(from, 0);
+        cache->fillTo = to;
+        cache->fillQueued = true;
+        // a running fill sees fillQueued and starts over on the new range
+        if(!cache->filling) {
+            cache->filling = true;
+            _fill_pool.request({0, cache});
+        }
+    }
+
+    static void frame_cache_shutdown() {
+        _fill_pool.shutdown();
+    }
+
+    static void frame_cache_stop(LuaVLC_Video* video) {
+        std::shared_ptr<LuaVLC_FrameCache> cache = std::atomic_exchange(&video->frameCache, std::shared_ptr<LuaVLC_FrameCache>());
+        if(cache == nullptr)
+            return;
+        // a queued fill bails out on stopping, a running one finishes its hidden player first
+        std::unique_lock<std::mutex> lock(cache->mutex);
+        cache->stopping = true;
+        cache->wake.wait(lock, [&cache]{ return !cache->fillRunning; });
+        // display_cb can still be in frame_cache_capture with its own reference, it bails out on stopping
+        memory_track(video, LUAVLC_MEM_FRAME_CACHE, -(int64_t)cache->bytes);
+        cache->bytes = 0;
+        cache->frames.clear();
+    }
+
+    // budgetBytes = 0 turns it off, lookaheadPath (a file on disk, can be NULL) lets a worker decode
+    // lookaheadMs worth of frames ahead of wherever stepping runs out of cached ones
+    // the video has to be showing frames at width x height already
+    EXPORT_DLL void luavlc_frame_cache_configure(LuaVLC_Video* video, uint64_t budgetBytes, const char* lookaheadPath, double lookaheadMs) {
+        if(video == NULL || video == nullptr)
+            return;
+        frame_cache_stop(video);
+        if(budgetBytes == 0 || video->width == 0 || video->height == 0)
+            return;
+        std::shared_ptr<LuaVLC_FrameCache> cache = std::make_shared<LuaVLC_FrameCache>();
+        cache->video = video;
+        cache->width = video->width;
+        cache->height = video->height;
+        cache->budget = budgetBytes;
+        cache->path = lookaheadPath != NULL ? lookaheadPath : "";
+        cache->lookaheadMs = lookaheadMs;
+        std::atomic_store(&video->frameCache, cache);
+    }
+
+    // only while paused and nothing's on its way, otherwise vlc could be decoding into the pixel buffer at the same time.
+    // a seek or next_frame while paused stays paused, but decodes a frame anyway
+    static bool frame_cache_can_show(LuaVLC_Video* video) {
+        return video->pixelBuffer != nullptr && libvlc_media_player_get_state(video->mediaPlayer) == libvlc_Paused &&
+            video->seekPending.load(std::memory_order_acquire) < 0 && !video->stepPending.load(std::memory_order_acquire);
+    }
+
+    // shows a cached frame in the pixel buffer, call with the cache locked
+    static double frame_cache_show_frame(LuaVLC_Video* video, LuaVLC_FrameCache* cache, int64_t frame) {
+        auto it = cache->frames.find(frame);
+        it->second.lastUse = ++cache->useClock;
+        frame_yuv_to_rgba(it->second.yuv.data(), cache->width, cache->height, video_pitch(video), video->pixelBuffer);
+        cache->current = frame;
+        cache->detached = true;
+        cache->stats.hits++;
+        dirty_track(video);
+        video->frameSequence.fetch_add(1, std::memory_order_release);
+        pbo_frame(video);
+        fields_track(video);
+        frc_push(video, true);
+        return frame * cache->frameMs;
+    }
+
+    // steps one frame forwards or backwards (direction is 1 or -1), out of the cache if it can,
+    // otherwise by seeking (or next_frame) and queueing up the lookahead worker.
+    // returns the time (ms) of the frame now on screen, or -1 if it has to be decoded first
+    EXPORT_DLL double luavlc_frame_cache_step(LuaVLC_Video* video, int direction) {
+        std::shared_ptr<LuaVLC_FrameCache> cache = std::atomic_load(&video->frameCache);
+        if(cache == nullptr || video->mediaPlayer == nullptr)
+            return -1.0;
+        std::unique_lock<std::mutex> lock(cache->mutex);
+        if(cache->current >= 0 && cache->frameMs > 0.0 && frame_cache_can_show(video)) {
+            int64_t target = cache->current + (direction < 0 ? -1 : 1);
+            if(target >= 0 && cache->frames.find(target) != cache->frames.end()) {
+                // keep the worker a window ahead of where we're going
+                int64_t window = (int64_t)(cache->lookaheadMs / cache->frameMs);
+                if(direction < 0 && cache->frames.find(target - window / 2) == cache->frames.end())
+                    frame_cache_request_fill(cache, target - window, target - 1);
+                return frame_cache_show_frame(video, cache.get(), target);
+            }
+        }
+        cache->stats.misses++;
+        int64_t current = cache->current;
+        double frameMs = cache->frameMs;
+        bool detached = cache->detached;
+        if(current >= 0 && frameMs > 0.0 && direction < 0) {
+            int64_t window = std::max<int64_t>((int64_t)(cache->lookaheadMs / frameMs), 1);
+            frame_cache_request_fill(cache, current - window, current - 2);
+        }
+        lock.unlock();
+
+        if(direction < 0 || detached) {
+            if(current < 0 || frameMs <= 0.0)
+                return -1.0;
+            int64_t target = std::max<int64_t>(current + (direction < 0 ? -1 : 1), 0);
+            luavlc_video_seek(video, target * frameMs, LUAVLC_SEEK_PRECISE);
+        } else {
+            video->stepPending.store(true, std::memory_order_release);
+            libvlc_media_player_next_frame(video->mediaPlayer);
+        }
+        return -1.0;
+    }
+
+    // shows the cached frame at timeMs if there is one (for small scrubs), returns its time or -1 if it isn't cached
+    // or the player isn't paused
+    EXPORT_DLL double luavlc_frame_cache_show(LuaVLC_Video* video, double timeMs) {
+        std::shared_ptr<LuaVLC_FrameCache> cache = std::atomic_load(&video->frameCache);
+        if(cache == nullptr || video->mediaPlayer == nullptr || !frame_cache_can_show(video))
+            return -1.0;
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        if(cache->frameMs <= 0.0)
+            return -1.0;
+        int64_t frame = (int64_t)(timeMs / cache->frameMs + 0.01);
+        if(cache->frames.find(frame) == cache->frames.end()) {
+            cache->stats.misses++;
+            return -1.0;
+        }
+        return frame_cache_show_frame(video, cache.get(), frame);
+    }
+
+    // puts the player back on the frame the cache is showing, before playing from there
+    EXPORT_DLL void luavlc_frame_cache_resume(LuaVLC_Video* video) {
+        std::shared_ptr<LuaVLC_FrameCache> cache = std::atomic_load(&video->frameCache);
+        if(cache == nullptr)
+            return;
+        std::unique_lock<std::mutex> lock(cache->mutex);
+        if(!cache->detached)
+            return;
+        cache->detached = false;
+        double time = cache->current * cache->frameMs;
+        lock.unlock();
+        luavlc_video_seek(video, time, LUAVLC_SEEK_PRECISE);
+    }
+
+    EXPORT_DLL bool luavlc_frame_cache_stats(LuaVLC_Video* video, LuaVLC_FrameCacheStats* out) {
+        std::shared_ptr<LuaVLC_FrameCache> cache = std::atomic_load(&video->frameCache);
+        if(cache == nullptr)
+            return false;
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        *out = cache->stats;
+        out->frames = (unsigned int)cache->frames.size();
+        out->bytes = cache->bytes;
+        out->budget = cache->budget;
+        out->frameMs = cache->frameMs;
+        return true;
+    }
+
+    // block compression of baked frames, so clips that stay resident take 1/4 - 1/8 of the vram (and upload bandwidth)
+    // bc1 (4 bits per pixel), bc7 mode 6 (8 bpp, much better quality) and etc1 (4 bpp, for gles/mobile)
+    enum {
+        LUAVLC_COMPRESS_NONE = 0,
+        LUAVLC_COMPRESS_BC1,
+        LUAVLC_COMPRESS_BC7,
+        LUAVLC_COMPRESS_ETC1
+    };
+
+    // quality 0 = bounding box endpoints, 1 = principal axis plus a least squares pass, 2 = keeps refining
+    // and tries every bc7 p-bit combination
+    static const int COMPRESS_QUALITY_MAX = 2;
+
+    // a 4x4 block, one plane per channel so the palette search works on 8 pixels at a time
+    struct alignas(16) LuaVLC_Block {
+        int16_t c[4][16];
+    };
+
+    static size_t compress_block_bytes(int format) {
+        return format == LUAVLC_COMPRESS_BC7 ? 16 : 8;
+    }
+
+    static size_t compress_frame_bytes(int format, unsigned int width, unsigned int height) {
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * compress_block_bytes(format);
+    }
+
+    // edge blocks repeat the last row/column
+    static void block_load(const unsigned char* rgba, unsigned int width, unsigned int height, unsigned int bx, unsigned int by, LuaVLC_Block* block) {
+        for(int i = 0; i < 16; i++) {
+            unsigned int x = std::min(bx * 4 + (i & 3), width - 1), y = std::min(by * 4 + (i >> 2), height - 1);
+            const unsigned char* p = rgba + ((size_t)y * width + x) * 4;
+            for(int ch = 0; ch < 4; ch++)
+                block->c[ch][i] = p[ch];
+        }
+    }
+
+    // finds the closest palette color for every pixel, returns the total squared error.
+    // channels = 3 ignores alpha. errors (can be NULL) gets each pixel's error
+#if LUAVLC_SSE2
+    static int block_match(const LuaVLC_Block* block, const int (*palette)[4], int count, int channels, unsigned char* indices, int* errors) {
+        int total = 0;
+        __m128i alphaMask = channels == 4 ? _mm_set1_epi16(-1) : _mm_setzero_si128();
+        for(int half = 0; half < 2; half++) {
+            __m128i r = _mm_load_si128((const __m128i*)&block->c[0][half * 8]);
+            __m128i g = _mm_load_si128((const __m128i*)&block->c[1][half * 8]);
+            __m128i b = _mm_load_si128((const __m128i*)&block->c[2][half * 8]);
+            __m128i a = _mm_and_si128(_mm_load_si128((const __m128i*)&block->c[3][half * 8]), alphaMask);
+            __m128i bestLo = _mm_set1_epi32(INT32_MAX), bestHi = bestLo;
+            __m128i indexLo = _mm_setzero_si128(), indexHi = indexLo;
+            for(int p = 0; p < count; p++) {
+                __m128i dr = _mm_sub_epi16(r, _mm_set1_epi16((short)palette[p][0]));
+                __m128i dg = _mm_sub_epi16(g, _mm_set1_epi16((short)palette[p][1]));
+                __m128i db = _mm_sub_epi16(b, _mm_set1_epi16((short)palette[p][2]));
+                __m128i da = _mm_sub_epi16(a, _mm_and_si128(_mm_set1_epi16((short)palette[p][3]), alphaMask));
+                // madd squares and adds pairs, so interleave r/g and b/a to get dr^2 + dg^2 + db^2 + da^2 per pixel
+                __m128i rgLo = _mm_unpacklo_epi16(dr, dg), rgHi = _mm_unpackhi_epi16(dr, dg);
+                __m128i baLo = _mm_unpacklo_epi16(db, da), baHi = _mm_unpackhi_epi16(db, da);
+                __m128i distLo = _mm_add_epi32(_mm_madd_epi16(rgLo, rgLo), _mm_madd_epi16(baLo, baLo));
+                __m128i distHi = _mm_add_epi32(_mm_madd_epi16(rgHi, rgHi), _mm_madd_epi16(baHi, baHi));
+                __m128i index = _mm_set1_epi32(p);
+                __m128i closerLo = _mm_cmplt_epi32(distLo, bestLo), closerHi = _mm_cmplt_epi32(distHi, bestHi);
+                bestLo = _mm_or_si128(_mm_and_si128(closerLo, distLo), _mm_andnot_si128(closerLo, bestLo));
+                bestHi = _mm_or_si128(_mm_and_si128(closerHi, distHi), _mm_andnot_si128(closerHi, bestHi));
+                indexLo = _mm_or_si128(_mm_and_si128(closerLo, index), _mm_andnot_si128(closerLo, indexLo));
+                indexHi = _mm_or_si128(_mm_and_si128(closerHi, index), _mm_andnot_si128(closerHi, indexHi));
+            }
+            alignas(16) int best[8], index[8];
+            _mm_store_si128((__m128i*)best, bestLo);
+            _mm_store_si128((__m128i*)(best + 4), bestHi);
+            _mm_store_si128((__m128i*)index, indexLo);
+            _mm_store_si128((__m128i*)(index + 4), indexHi);
+            for(int i = 0; i < 8; i++) {
+                indices[half * 8 + i] = (unsigned char)index[i];
+                if(errors != NULL)
+                    errors[half * 8 + i] = best[i];
+                total += best[i];
+            }
+        }
+        return total;
+    }
+#else
+    static int block_match(const LuaVLC_Block* block, const int (*palette)[4], int count, int channels, unsigned char* indices, int* errors) {
+        int total = 0;
+        for(int i = 0; i < 16; i++) {
+            int best = INT32_MAX, bestIndex = 0;
+            for(int p = 0; p < count; p++) {
+                int dist = 0;
+                for(int ch = 0; ch < channels; ch++) {
+                    int d = block->c[ch][i] - palette[p][ch];
+                    dist += d * d;
+                }
+                if(dist < best) {
+                    best = dist;
+                    bestIndex = p;
+                }
+            }
+            indices[i] = (unsigned char)bestIndex;
+            if(errors != NULL)
+                errors[i] = best;
+            total += best;
+        }
+        return total;
+    }
+#endif
+
+    // endpoints along the block's principal axis (or its bounding box), clamped to 0-255
+    static void block_endpoints(const LuaVLC_Block* block, int channels, bool principal, float* low, float* high) {
+        float mean[4] = {}, minimum[4], maximum[4];
+        for(int ch = 0; ch < channels; ch++) {
+            minimum[ch] = 255.0f;
+            maximum[ch] = 0.0f;
+            for(int i = 0; i < 16; i++) {
+                mean[ch] += block->c[ch][i];
+                minimum[ch] = std::min(minimum[ch], (float)block->c[ch][i]);
+                maximum[ch] = std::max(maximum[ch], (float)block->c[ch][i]);
+            }
+            mean[ch] /= 16.0f;
+        }
+        if(!principal) {
+            // pulled in a little, the extremes are usually outliers
+            for(int ch = 0; ch < channels; ch++) {
+                float inset = (maximum[ch] - minimum[ch]) / 16.0f;
+                low[ch] = minimum[ch] + inset;
+                high[ch] = maximum[ch] - inset;
+            }
+            return;
+        }
+
+        float covariance[4][4] = {};
+        for(int i = 0; i < 16; i++) {
+            for(int a = 0; a < channels; a++) {
+                for(int b = a; b < channels; b++)
+                    covariance[a][b] += (block->c[a][i] - mean[a]) * (block->c[b][i] - mean[b]);
+            }
+        }
+        for(int a = 0; a < channels; a++) {
+            for(int b = 0; b < a; b++)
+                covariance[a][b] = covariance[b][a];
+        }
+        float axis[4];
+        for(int ch = 0; ch < channels; ch++)
+            axis[ch] = maximum[ch] - minimum[ch];
+        for(int iteration = 0; iteration < 8; iteration++) {
+            float next[4] = {}, length = 0.0f;
+            for(int a = 0; a < channels; a++) {
+                for(int b = 0; b < channels; b++)
+                    next[a] += covariance[a][b] * axis[b];
+                length = std::max(length, std::fabs(next[a]));
+            }
+            if(length < 1e-6f)
+                break;
+            for(int ch = 0; ch < channels; ch++)
+                axis[ch] = next[ch] / length;
+        }
+        float lengthSquared = 0.0f;
+        for(int ch = 0; ch < channels; ch++)
+            lengthSquared += axis[ch] * axis[ch];
+        if(lengthSquared < 1e-6f) {
+            for(int ch = 0; ch < channels; ch++)
+                low[ch] = high[ch] = mean[ch];
+            return;
+        }
+        float projectionLow = 1e30f, projectionHigh = -1e30f;
+        for(int i = 0; i < 16; i++) {
+            float projection = 0.0f;
+            for(int ch = 0; ch < channels; ch++)
+                projection += (block->c[ch][i] - mean[ch]) * axis[ch];
+            projectionLow = std::min(projectionLow, projection);
+            projectionHigh = std::max(projectionHigh, projection);
+        }
+        for(int ch = 0; ch < channels; ch++) {
+            low[ch] = std::min(std::max(mean[ch] + axis[ch] * projectionLow / lengthSquared, 0.0f), 255.0f);
+            high[ch] = std::min(std::max(mean[ch] + axis[ch] * projectionHigh / lengthSquared, 0.0f), 255.0f);
+        }
+    }
+
+    // least squares endpoints for the given indices, weights[i] is where index i sits between low (0) and high (1)
+    static bool block_refine(const LuaVLC_Block* block, int channels, const unsigned char* indices, const float* weights, float* low, float* high) {
+        float alpha2 = 0.0f, beta2 = 0.0f, alphaBeta = 0.0f, alphaX[4] = {}, betaX[4] = {};
+        for(int i = 0; i < 16; i++) {
+            float beta = weights[indices[i]], alpha = 1.0f - beta;
+            alpha2 += alpha * alpha;
+            beta2 += beta * beta;
+            alphaBeta += alpha * beta;
+            for(int ch = 0; ch < channels; ch++) {
+                alphaX[ch] += alpha * block->c[ch][i];
+                betaX[ch] += beta * block->c[ch][i];
+            }
+        }
+        float det = alpha2 * beta2 - alphaBeta * alphaBeta;
+        if(std::fabs(det) < 1e-4f)
+            return false;
+        for(int ch = 0; ch < channels; ch++) {
+            low[ch] = std::min(std::max((alphaX[ch] * beta2 - betaX[ch] * alphaBeta) / det, 0.0f), 255.0f);
+            high[ch] = std::min(std::max((betaX[ch] * alpha2 - alphaX[ch] * alphaBeta) / det, 0.0f), 255.0f);
+        }
+        return true;
+    }
+
+    static inline uint16_t bc1_pack565(const float* color) {
+        int r = (int)(color[0] * 31.0f / 255.0f + 0.5f), g = (int)(color[1] * 63.0f / 255.0f + 0.5f), b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+        return (uint16_t)(r << 11 | g << 5 | b);
+    }
+
+    static void bc1_palette(uint16_t c0, uint16_t c1, int (*palette)[4]) {
+        int colors[2][3];
+        uint16_t packed[2] = {c0, c1};
+        for(int e = 0; e < 2; e++) {
+            int r = packed[e] >> 11, g = (packed[e] >> 5) & 63, b = packed[e] & 31;
+            colors[e][0] = r << 3 | r >> 2;
+            colors[e][1] = g << 2 | g >> 4;
+            colors[e][2] = b << 3 | b >> 2;
+        }
+        for(int ch = 0; ch < 3; ch++) {
+            palette[0][ch] = colors[0][ch];
+            palette[1][ch] = colors[1][ch];
+            if(c0 > c1) {
+                palette[2][ch] = (2 * colors[0][ch] + colors[1][ch]) / 3;
+                palette[3][ch] = (colors[0][ch] + 2 * colors[1][ch]) / 3;
+            } else {
+                palette[2][ch] = (colors[0][ch] + colors[1][ch]) / 2;
+                palette[3][ch] = 0;
+            }
+        }
+        for(int p = 0; p < 4; p++)
+            palette[p][3] = 255;
+    }
+
+    // tries the endpoints, keeps them in out if they beat bestError
+    static void bc1_try(const LuaVLC_Block* block, const float* low, const float* high, int* bestError, unsigned char* out, unsigned char* bestIndices) {
+        uint16_t c0 = bc1_pack565(high), c1 = bc1_pack565(low);
+        if(c0 < c1)
+            std::swap(c0, c1);
+        int palette[4][4];
+        unsigned char indices[16];
+        bc1_palette(c0, c1, palette);
+        // equal endpoints is 3 color mode, where index 3 is black
+        int error = block_match(block, palette, c0 == c1 ? 1 : 4, 3, indices, NULL);
+        if(error >= *bestError)
+            return;
+        *bestError = error;
+        uint32_t bits = 0;
+        for(int i = 0; i < 16; i++)
+            bits |= (uint32_t)indices[i] << (i * 2);
+        out[0] = (unsigned char)c0;
+        out[1] = (unsigned char)(c0 >> 8);
+        out[2] = (unsigned char)c1;
+        out[3] = (unsigned char)(c1 >> 8);
+        for(int b = 0; b < 4; b++)
+            out[4 + b] = (unsigned char)(bits >> (8 * b));
+        memcpy(bestIndices, indices, 16);
+    }
+
+    static void bc1_encode_block(const LuaVLC_Block* block, int quality, unsigned char* out) {
+        static const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f}; // index -> how far from low towards high
+        float low[4], high[4];
+        int bestError = INT32_MAX;
+        unsigned char indices[16];
+        block_endpoints(block, 3, quality > 0, low, high);
+        bc1_try(block, low, high, &bestError, out, indices);
+        if(quality >= 2) {
+            block_endpoints(block, 3, false, low, high);
+            bc1_try(block, low, high, &bestError, out, indices);
+        }
+        int passes = quality == 0 ? 0 : quality == 1 ? 1 : 4;
+        for(int pass = 0; pass < passes && bestError > 0; pass++) {
+            // index 0 is c0 (the high endpoint) in the block we wrote
+            if(!block_refine(block, 3, indices, weights, low, high))
+                break;
+            int before = bestError;
+            bc1_try(block, low, high, &bestError, out, indices);
+            if(bestError == before)
+                break;
+        }
+    }
+
+    static void bc1_decode_block(const unsigned char* in, unsigned char* rgba) {
+        int palette[4][4];
+        bc1_palette((uint16_t)(in[0] | in[1] << 8), (uint16_t)(in[2] | in[3] << 8), palette);
+        uint32_t bits = (uint32_t)in[4] | (uint32_t)in[5] << 8 | (uint32_t)in[6] << 16 | (uint32_t)in[7] << 24;
+        for(int i = 0; i < 16; i++) {
+            for(int ch = 0; ch < 4; ch++)
+                rgba[i * 4 + ch] = (unsigned char)palette[(bits >> (i * 2)) & 3][ch];
+        }
+    }
+
+    static const int BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    struct LuaVLC_BitWriter {
+        unsigned char* out;
+        int position = 0;
+        void write(uint32_t value, int bits) {
+            for(int i = 0; i < bits; i++, position++) {
+                if(value & (1u << i))
+                    out[position >> 3] |= (unsigned char)(1 << (position & 7));
+            }
+        }
+    };
+
+    static void bc7_palette(const int (*endpoints)[4], int (*palette)[4]) {
+        for(int p = 0; p < 16; p++) {
+            for(int ch = 0; ch < 4; ch++)
+                palette[p][ch] = ((64 - BC7_WEIGHTS[p]) * endpoints[0][ch] + BC7_WEIGHTS[p] * endpoints[1][ch] + 32) >> 6;
+        }
+    }
+
+    // quantizes both endpoints to 7 bits plus a p-bit (shared by all 4 channels of an endpoint)
+    static void bc7_quantize(const float* color, int pbit, int* quantized, int* expanded) {
+        for(int ch = 0; ch < 4; ch++) {
+            int value = (int)std::floor((color[ch] - pbit) / 2.0f + 0.5f);
+            quantized[ch] = std::min(std::max(value, 0), 127);
+            expanded[ch] = quantized[ch] << 1 | pbit;
+        }
+    }
+
+    static void bc7_try(const LuaVLC_Block* block, const float* low, const float* high, bool allPbits, int* bestError, unsigned char* out, unsigned char* bestIndices) {
+        for(int combination = 0; combination < 4; combination++) {
+            int pbits[2];
+            if(allPbits) {
+                pbits[0] = combination & 1;
+                pbits[1] = combination >> 1;
+            } else {
+                // the p-bit that's closest on average
+                if(combination > 0)
+                    break;
+                const float* colors[2] = {low, high};
+                for(int e = 0; e < 2; e++) {
+                    float error[2] = {};
+                    for(int p = 0; p < 2; p++) {
+                        int quantized[4], expanded[4];
+                        bc7_quantize(colors[e], p, quantized, expanded);
+                        for(int ch = 0; ch < 4; ch++)
+                            error[p] += (colors[e][ch] - expanded[ch]) * (colors[e][ch] - expanded[ch]);
+                    }
+                    pbits[e] = error[1] < error[0] ? 1 : 0;
+                }
+            }
+            int quantized[2][4], endpoints[2][4], palette[16][4];
+            bc7_quantize(low, pbits[0], quantized[0], endpoints[0]);
+            bc7_quantize(high, pbits[1], quantized[1], endpoints[1]);
+            bc7_palette(endpoints, palette);
+            unsigned char indices[16];
+            int error = block_match(block, palette, 16, 4, indices, NULL);
+            if(error >= *bestError)
+                continue;
+            *bestError = error;
+            memcpy(bestIndices, indices, 16);
+
+            // the first index only gets 3 bits, so its top bit has to be 0
+            int order[2] = {0, 1};
+            if(indices[0] >= 8) {
+                order[0] = 1;
+                order[1] = 0;
+                for(int i = 0; i < 16; i++)
+                    indices[i] = (unsigned char)(15 - indices[i]);
+            }
+            memset(out, 0, 16);
+            LuaVLC_BitWriter writer{out};
+            writer.write(1 << 6, 7); // mode 6
+            for(int ch = 0; ch < 4; ch++) {
+                writer.write((uint32_t)quantized[order[0]][ch], 7);
+                writer.write((uint32_t)quantized[order[1]][ch], 7);
+            }
+            writer.write((uint32_t)pbits[order[0]], 1);
+            writer.write((uint32_t)pbits[order[1]], 1);
+            for(int i = 0; i < 16; i++)
+                writer.write(indices[i], i == 0 ? 3 : 4);
+        }
+    }
+
+    static void bc7_encode_block(const LuaVLC_Block* block, int quality, unsigned char* out) {
+        static const float weights[16] = {0 / 64.0f, 4 / 64.0f, 9 / 64.0f, 13 / 64.0f, 17 / 64.0f, 21 / 64.0f, 26 / 64.0f, 30 / 64.0f,
+                                          34 / 64.0f, 38 / 64.0f, 43 / 64.0f, 47 / 64.0f, 51 / 64.0f, 55 / 64.0f, 60 / 64.0f, 64 / 64.0f};
+        float low[4], high[4];
+        int bestError = INT32_MAX;
+        unsigned char indices[16];
+        block_endpoints(block, 4, quality > 0, low, high);
+        bc7_try(block, low, high, quality >= 2, &bestError, out, indices);
+        int passes = quality == 0 ? 0 : quality == 1 ? 1 : 3;
+        for(int pass = 0; pass < passes && bestError > 0; pass++) {
+            // bestIndices are relative to (low, high), before any anchor swap
+            if(!block_refine(block, 4, indices, weights, low, high))
+                break;
+            int before = bestError;
+            bc7_try(block, low, high, quality >= 2, &bestError, out, indices);
+            if(bestError == before)
+                break;
+        }
+    }
+
+    static uint32_t bc7_read(const unsigned char* in, int* position, int bits) {
+        uint32_t value = 0;
+        for(int i = 0; i < bits; i++, (*position)++)
+            value |= (uint32_t)((in[*position >> 3] >> (*position & 7)) & 1) << i;
+        return value;
+    }
+
+    // only mode 6, which is all we write
+    static void bc7_decode_block(const unsigned char* in, unsigned char* rgba) {
+        int position = 0;
+        if(bc7_read(in, &position, 7) != 1 << 6) {
+            memset(rgba, 0, 64);
+            return;
+        }
+        int endpoints[2][4], palette[16][4];
+        for(int ch = 0; ch < 4; ch++) {
+            endpoints[0][ch] = (int)bc7_read(in, &position, 7) << 1;
+            endpoints[1][ch] = (int)bc7_read(in, &position, 7) << 1;
+        }
+        int p0 = (int)bc7_read(in, &position, 1), p1 = (int)bc7_read(in, &position, 1);
+        for(int ch = 0; ch < 4; ch++) {
+            endpoints[0][ch] |= p0;
+            endpoints[1][ch] |= p1;
+        }
+        bc7_palette(endpoints, palette);
+        for(int i = 0; i < 16; i++) {
+            uint32_t index = bc7_read(in, &position, i == 0 ? 3 : 4);
+            for(int ch = 0; ch < 4; ch++)
+                rgba[i * 4 + ch] = (unsigned char)palette[index][ch];
+        }
+    }
+
+    static const int ETC1_MODIFIERS[8][2] = {{2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+    // etc1 pixel indices go down columns, blocks are split into two 2x4 (flip = 0) or 4x2 (flip = 1) halves
+    static inline bool etc1_in_second(int i, int flip) {
+        return flip ? (i >> 2) >= 2 : (i & 3) >= 2;
+    }
+
+    static void etc1_palette(const int* base, int table, int (*palette)[4]) {
+        const int offsets[4] = {ETC1_MODIFIERS[table][0], ETC1_MODIFIERS[table][1], -ETC1_MODIFIERS[table][0], -ETC1_MODIFIERS[table][1]};
+        for(int p = 0; p < 4; p++) {
+            for(int ch = 0; ch < 3; ch++)
+                palette[p][ch] = std::min(std::max(base[ch] + offsets[p], 0), 255);
+            palette[p][3] = 255;
+        }
+    }
+
+    // best table for one half with the given (already expanded) base color, returns its error
+    static int etc1_half(const LuaVLC_Block* block, int flip, int half, const int* base, int* bestTable, unsigned char* bestIndices) {
+        int bestError = INT32_MAX;
+        for(int table = 0; table < 8; table++) {
+            int palette[4][4], errors[16], error = 0;
+            unsigned char indices[16];
+            etc1_palette(base, table, palette);
+            block_match(block, palette, 4, 3, indices, errors);
+            for(int i = 0; i < 16; i++) {
+                if(etc1_in_second(i, flip) == (half == 1))
+                    error += errors[i];
+            }
+            if(error < bestError) {
+                bestError = error;
+                *bestTable = table;
+                for(int i = 0; i < 16; i++) {
+                    if(etc1_in_second(i, flip) == (half == 1))
+                        bestIndices[i] = indices[i];
+                }
+            }
+        }
+        return bestError;
+    }
+
+    static void etc1_encode_block(const LuaVLC_Block* block, int quality, unsigned char* out) {
+        int bestError = INT32_MAX;
+        uint64_t bestBits = 0;
+        for(int flip = 0; flip < 2; flip++) {
+            float average[2][3] = {};
+            for(int i = 0; i < 16; i++) {
+                for(int ch = 0; ch < 3; ch++)
+                    average[etc1_in_second(i, flip) ? 1 : 0][ch] += block->c[ch][i] / 8.0f;
+            }
+            for(int differential = 0; differential < 2; differential++) {
+                int levels = differential ? 31 : 15;
+                int quantized[2][3];
+                for(int half = 0; half < 2; half++) {
+                    for(int ch = 0; ch < 3; ch++)
+                        quantized[half][ch] = std::min(std::max((int)(average[half][ch] * levels / 255.0f + 0.5f), 0), levels);
+                }
+                if(differential) {
+                    bool fits = true;
+                    for(int ch = 0; ch < 3; ch++)
+                        fits = fits && quantized[1][ch] - quantized[0][ch] >= -4 && quantized[1][ch] - quantized[0][ch] <= 3;
+                    if(!fits)
+                        continue;
+                }
+
+                unsigned char indices[16] = {};
+                int tables[2], error = 0;
+                for(int half = 0; half < 2; half++) {
+                    int base[3];
+                    for(int ch = 0; ch < 3; ch++)
+                        base[ch] = differential ? (quantized[half][ch] << 3 | quantized[half][ch] >> 2) : (quantized[half][ch] << 4 | quantized[half][ch]);
+                    unsigned char halfIndices[16];
+                    error += etc1_half(block, flip, half, base, &tables[half], halfIndices);
+                    for(int i = 0; i < 16; i++) {
+                        if(etc1_in_second(i, flip) == (half == 1))
+                            indices[i] = halfIndices[i];
+                    }
+                }
+                if(error >= bestError)
+                    continue;
+                bestError = error;
+
+                uint64_t bits = 0;
+                for(int ch = 0; ch < 3; ch++) {
+                    int shift = 59 - ch * 8;
+                    if(differential)
+                        bits |= (uint64_t)quantized[0][ch] << shift | (uint64_t)((quantized[1][ch] - quantized[0][ch]) & 7) << (shift - 3);
+                    else
+                        bits |= (uint64_t)quantized[0][ch] << (shift + 1) | (uint64_t)quantized[1][ch] << (shift - 3);
+                }
+                bits |= (uint64_t)tables[0] << 37 | (uint64_t)tables[1] << 34 | (uint64_t)differential << 33 | (uint64_t)flip << 32;
+                for(int i = 0; i < 16; i++) {
+                    // 0 = +small, 1 = +big, 2 = -small, 3 = -big
+                    int bit = (i & 3) * 4 + (i >> 2);
+                    bits |= (uint64_t)(indices[i] >> 1) << (16 + bit) | (uint64_t)(indices[i] & 1) << bit;
+                }
+                bestBits = bits;
+            }
+            // quality 0 only tries side by side halves. there's nothing left to search past that, 2 is the same as 1
+            if(quality == 0)
+                break;
+        }
+        for(int b = 0; b < 8; b++)
+            out[b] = (unsigned char)(bestBits >> (56 - 8 * b));
+    }
+
+    static void etc1_decode_block(const unsigned char* in, unsigned char* rgba) {
+        uint64_t bits = 0;
+        for(int b = 0; b < 8; b++)
+            bits = bits << 8 | in[b];
+        int flip = (int)(bits >> 32) & 1, differential = (int)(bits >> 33) & 1;
+        int tables[2] = {(int)(bits >> 37) & 7, (int)(bits >> 34) & 7};
+        int bases[2][3];
+        for(int ch = 0; ch < 3; ch++) {
+            int shift = 59 - ch * 8;
+            if(differential) {
+                int first = (int)(bits >> shift) & 31, delta = (int)(bits >> (shift - 3)) & 7;
+                int second = first + (delta >= 4 ? delta - 8 : delta);
+                bases[0][ch] = first << 3 | first >> 2;
+                bases[1][ch] = (second & 31) << 3 | (second & 31) >> 2;
+            } else {
+                int first = (int)(bits >> (shift + 1)) & 15, second = (int)(bits >> (shift - 3)) & 15;
+                bases[0][ch] = first << 4 | first;
+                bases[1][ch] = second << 4 | second;
+            }
+        }
+        for(int i = 0; i < 16; i++) {
+            int half = etc1_in_second(i, flip) ? 1 : 0, bit = (i & 3) * 4 + (i >> 2);
+            int index = (int)((bits >> (16 + bit)) & 1) << 1 | (int)((bits >> bit) & 1);
+            int palette[4][4];
+            etc1_palette(bases[half], tables[half], palette);
+            for(int ch = 0; ch < 4; ch++)
+                rgba[i * 4 + ch] = (unsigned char)palette[index][ch];
+        }
+    }
+
+    static void compress_frame(int format, int quality, const unsigned char* rgba, unsigned int width, unsigned int height, unsigned char* out) {
+        unsigned int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+        size_t blockBytes = compress_block_bytes(format);
+        LuaVLC_Block block;
+        for(unsigned int by = 0; by < blocksY; by++) {
+            for(unsigned int bx = 0; bx < blocksX; bx++) {
+                block_load(rgba, width, height, bx, by, &block);
+                unsigned char* dest = out + ((size_t)by * blocksX + bx) * blockBytes;
+                if(format == LUAVLC_COMPRESS_BC1)
+                    bc1_encode_block(&block, quality, dest);
+                else if(format == LUAVLC_COMPRESS_BC7)
+                    bc7_encode_block(&block, quality, dest);
+                else
+                    etc1_encode_block(&block, quality, dest);
+            }
+        }
+    }
+
+    static void decompress_frame(int format, const unsigned char* in, unsigned int width, unsigned int height, unsigned char* rgba) {
+        unsigned int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+        size_t blockBytes = compress_block_bytes(format);
+        unsigned char pixels[64];
+        for(unsigned int by = 0; by < blocksY; by++) {
+            for(unsigned int bx = 0; bx < blocksX; bx++) {
+                const unsigned char* src = in + ((size_t)by * blocksX + bx) * blockBytes;
+                if(format == LUAVLC_COMPRESS_BC1)
+                    bc1_decode_block(src, pixels);
+                else if(format == LUAVLC_COMPRESS_BC7)
+                    bc7_decode_block(src, pixels);
+                else
+                    etc1_decode_block(src, pixels);
+                for(int i = 0; i < 16; i++) {
+                    unsigned int x = bx * 4 + (i & 3), y = by * 4 + (i >> 2);
+                    if(x < width && y < height)
+                        memcpy(rgba + ((size_t)y * width + x) * 4, pixels + i * 4, 4);
+                }
+            }
+        }
+    }
+
+    // one compress_frames call, its frames get taken one at a time by the caller and the pool
+    struct LuaVLC_CompressBatch {
+        int format;
+        int quality;
+        const unsigned char* rgba;
+        unsigned int width;
+        unsigned int height;
+        size_t frames;
+        unsigned char* out;
+        std::atomic<size_t> next{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+        size_t done = 0;
+    };
+
+    struct LuaVLC_CompressJob {
+        int id;
+        std::shared_ptr<LuaVLC_CompressBatch> batch;
+    };
+
+    static void compress_work(const LuaVLC_CompressJob& job, LuaVLC_NoResult* result);
+    // the callers work on their own batches too, so this plus one keeps every core busy
+    static LuaVLC_WorkerPool<LuaVLC_CompressJob> _compress_pool(compress_work, (int)std::max(std::thread::hardware_concurrency(), 2u) - 1);
+
+    // a job that starts after the batch is done doesn't touch rgba or out, the caller may have freed them
+    static void compress_work(const LuaVLC_CompressJob& job, LuaVLC_NoResult* result) {
+        LuaVLC_CompressBatch* batch = job.batch.get();
+        size_t frameBytes = (size_t)batch->width * batch->height * 4, outBytes = compress_frame_bytes(batch->format, batch->width, batch->height);
+        for(size_t frame = batch->next++; frame < batch->frames; frame = batch->next++) {
+            compress_frame(batch->format, batch->quality, batch->rgba + frame * frameBytes, batch->width, batch->height, batch->out + frame * outBytes);
+            std::lock_guard<std::mutex> lock(batch->mutex);
+            if(++batch->done == batch->frames)
+                batch->finished.notify_all();
+        }
+    }
+
+    static void compress_shutdown() {
+        _compress_pool.shutdown();
+    }
+
+    // compresses frames spread over every core, out gets frames * compress_frame_bytes
+    static void compress_frames(int format, int quality, const unsigned char* rgba, unsigned int width, unsigned int height, size_t frames, unsigned char* out) {
+        if(frames == 0)
+            return;
+        std::shared_ptr<LuaVLC_CompressBatch> batch = std::make_shared<LuaVLC_CompressBatch>();
+        batch->format = format;
+        batch->quality = quality;
+        batch->rgba = rgba;
+        batch->width = width;
+        batch->height = height;
+        batch->frames = frames;
+        batch->out = out;
+        size_t helpers = std::min<size_t>((size_t)_compress_pool.maxWorkers, frames - 1);
+        for(size_t i = 0; i < helpers; i++)
+            _compress_pool.request({0, batch});
+        compress_work({0, batch}, NULL);
+        // frames the pool took might still be going
+        std::unique_lock<std::mutex> lock(batch->mutex);
+        batch->finished.wait(lock, [&batch]{ return batch->done == batch->frames; });
+    }
+
+    // the container love.image.newCompressedData reads: dds for bc1/bc7, pkm for etc1
+    // writes the header into out (at least 148 bytes) and returns its size
+    EXPORT_DLL int luavlc_compress_header(int format, unsigned int width, unsigned int height, unsigned char* out) {
+        auto le32 = [](unsigned char* p, uint32_t value) {
+            for(int b = 0; b < 4; b++)
+                p[b] = (unsigned char)(value >> (8 * b));
+        };
+        if(format == LUAVLC_COMPRESS_ETC1) {
+            memcpy(out, "PKM 10", 6);
+            uint16_t fields[5] = {0, (uint16_t)((width + 3) & ~3u), (uint16_t)((height + 3) & ~3u), (uint16_t)width, (uint16_t)height};
+            for(int i = 0; i < 5; i++) {
+                out[6 + i * 2] = (unsigned char)(fields[i] >> 8);
+                out[7 + i * 2] = (unsigned char)fields[i];
+            }
+            return 16;
+        }
+        memset(out, 0, 148);
+        memcpy(out, "DDS ", 4);
+        le32(out + 4, 124);
+        le32(out + 8, 0x1 | 0x2 | 0x4 | 0x1000 | 0x80000); // caps, height, width, pixel format, linear size
+        le32(out + 12, height);
+        le32(out + 16, width);
+        le32(out + 20, (uint32_t)compress_frame_bytes(format, width, height));
+        le32(out + 28, 1); // mipmaps
+        le32(out + 76, 32); // pixel format size
+        le32(out + 80, 0x4); // fourcc
+        memcpy(out + 84, format == LUAVLC_COMPRESS_BC7 ? "DX10" : "DXT1", 4);
+        le32(out + 108, 0x1000); // texture
+        if(format != LUAVLC_COMPRESS_BC7)
+            return 128;
+        le32(out + 128, 98); // DXGI_FORMAT_BC7_UNORM
+        le32(out + 132, 3); // 2d texture
+        le32(out + 140, 1); // array size
+        return 148;
+    }
 
-        libvlc_audio_set_callbacks(mp, audio_play, audio_pause, audio_resume, audio_flush, NULL, audio);
-        libvlc_audio_set_volume_callback(mp, audio_set_volume);
-        libvlc_audio_set_format_callbacks(mp, audio_setup, NULL);
+    typedef struct {
+        double milliseconds; // for all the frames
+        double megapixelsPerSecond;
+        double psnr; // in dB, over rgb
+        double ratio; // raw rgba size / compressed size
+    } LuaVLC_CompressBenchmark;
+
+    // compresses frames of a made up (but video-ish: gradients, noise and hard edges) image and decodes them again
+    EXPORT_DLL void luavlc_compress_benchmark(int format, int quality, unsigned int width, unsigned int height, int frames, LuaVLC_CompressBenchmark* out) {
+        memset(out, 0, sizeof(LuaVLC_CompressBenchmark));
+        if(format < LUAVLC_COMPRESS_BC1 || format > LUAVLC_COMPRESS_ETC1 || width == 0 || height == 0 || frames <= 0)
+            return;
+        quality = std::min(std::max(quality, 0), COMPRESS_QUALITY_MAX);
+        size_t frameBytes = (size_t)width * height * 4, outBytes = compress_frame_bytes(format, width, height);
+        std::vector<unsigned char> rgba(frameBytes * frames), compressed(outBytes * frames), decoded(frameBytes);
+        uint32_t seed = 12345;
+        for(int f = 0; f < frames; f++) {
+            for(unsigned int y = 0; y < height; y++) {
+                for(unsigned int x = 0; x < width; x++) {
+                    unsigned char* p = &rgba[f * frameBytes + ((size_t)y * width + x) * 4];
+                    seed = seed * 1664525u + 1013904223u;
+                    int noise = (int)(seed >> 28) - 8;
+                    bool edge = ((x + f * 3) / 37 + y / 29) % 5 == 0;
+                    p[0] = frame_clamp((int)(x * 255 / width) + noise + (edge ? 60 : 0));
+                    p[1] = frame_clamp((int)(y * 255 / height) + noise);
+                    p[2] = frame_clamp(128 + (int)(64 * std::sin((x + y + f) * 0.05)) + noise - (edge ? 60 : 0));
+                    p[3] = 255;
+                }
+            }
+        }
+        double start = luavlc_now_ms();
+        compress_frames(format, quality, rgba.data(), width, height, (size_t)frames, compressed.data());
+        out->milliseconds = luavlc_now_ms() - start;
+        out->megapixelsPerSecond = out->milliseconds > 0.0 ? (double)width * height * frames / 1000.0 / out->milliseconds : 0.0;
+        out->ratio = (double)frameBytes / outBytes;
+
+        double squared = 0.0;
+        for(int f = 0; f < frames; f++) {
+            decompress_frame(format, compressed.data() + f * outBytes, width, height, decoded.data());
+            const unsigned char* original = rgba.data() + f * frameBytes;
+            for(size_t i = 0; i < frameBytes; i++) {
+                if((i & 3) != 3) {
+                    double d = (double)original[i] - decoded[i];
+                    squared += d * d;
+                }
+            }
+        }
+        double mse = squared / ((double)width * height * 3 * frames);
+        out->psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+    }
+
+    // baked clips, short videos decoded once into plain frames so lua can loop them off the gpu
+    // without vlc (see lovevlc.bake). decoding runs on a hidden player in real time, so a pool
+    // of workers bakes a few at once
+    enum {
+        LUAVLC_BAKE_DONE = 0,
+        LUAVLC_BAKE_FAILED,
+        LUAVLC_BAKE_TOO_BIG // would go over the memory or length limit, nothing got decoded past that
+    };
+
+    typedef struct {
+        int id;
+        int status; // LUAVLC_BAKE_*
+        unsigned int width;
+        unsigned int height;
+        unsigned int frames;
+        double fps;
+        int format; // LUAVLC_COMPRESS_*, NONE is rgba
+        size_t frameBytes;
+        unsigned char* pixels; // frames * frameBytes, free with luavlc_bake_free_pixels
+    } LuaVLC_BakeResult;
+
+    struct LuaVLC_BakeJob {
+        int id;
+        std::string path;
+        unsigned int width; // either can be 0 to keep the aspect ratio
+        unsigned int height;
+        uint64_t maxBytes; // after compression
+        double maxSeconds;
+        int format; // LUAVLC_COMPRESS_*
+        int quality;
+    };
+
+    static void bake_work(const LuaVLC_BakeJob& job, LuaVLC_BakeResult* result);
+    static LuaVLC_WorkerPool<LuaVLC_BakeJob, LuaVLC_BakeResult> _bake_pool(bake_work, 2);
+
+    // compressed bakes hand decoded frames to the worker in chunks of about this much raw rgba,
+    // display_cb waits once two of them are waiting so raw frames never pile up past that
+    static const size_t BAKE_CHUNK_BYTES = 16 << 20;
+
+    struct LuaVLC_BakeCapture {
+        std::mutex mutex;
+        std::condition_variable done; // wakes the worker, when it's finished or a chunk is ready
+        std::condition_variable drained; // wakes display_cb, when the worker took the staged frames
+        unsigned int width = 0;
+        unsigned int height = 0;
+        int format = LUAVLC_COMPRESS_NONE;
+        int quality = 0;
+        std::vector<unsigned char> scratch;
+        unsigned char* pixels = nullptr; // rgba, or blocks for compressed bakes
+        size_t frames = 0;
+        size_t capacity = 0; // in frames
+        uint64_t maxBytes = 0; // of pixels
+        std::vector<unsigned char> staged; // raw frames waiting to get compressed
+        size_t stagedFrames = 0;
+        bool finished = false;
+        bool tooBig = false;
+    };
+
+    static size_t bake_chunk_frames(const LuaVLC_BakeCapture* capture) {
+        return std::max<size_t>(BAKE_CHUNK_BYTES / std::max<size_t>(capture->scratch.size(), 1), 1);
+    }
+
+    // makes room for frames frames in pixels, frameBytes each, call with the capture locked
+    static bool bake_reserve(LuaVLC_BakeCapture* capture, size_t frames, size_t frameBytes) {
+        if(frames <= capture->capacity)
+            return true;
+        // never past what the limit lets in, doubling could otherwise allocate close to twice of it
+        size_t capacity = (size_t)std::min<uint64_t>(std::max<size_t>({capture->capacity * 2, frames, 16}), capture->maxBytes / frameBytes);
+        unsigned char* pixels = capacity >= frames ? (unsigned char*)realloc(capture->pixels, capacity * frameBytes) : NULL;
+        if(pixels == NULL)
+            return false;
+        capture->pixels = pixels;
+        capture->capacity = capacity;
+        return true;
+    }
+
+    static void bake_too_big(LuaVLC_BakeCapture* capture) {
+        capture->tooBig = true;
+        capture->finished = true;
+        capture->done.notify_all();
+        capture->drained.notify_all();
+    }
+
+    static unsigned bake_setup_cb(void** opaque, char* chroma, unsigned* width, unsigned* height, unsigned* pitches, unsigned* lines) {
+        LuaVLC_BakeCapture* capture = (LuaVLC_BakeCapture*)*opaque;
+        thumbnail_fit(*width, *height, &capture->width, &capture->height);
+        memcpy(chroma, "RGBA", 4);
+        *width = capture->width;
+        *height = capture->height;
+        pitches[0] = capture->width * 4;
+        lines[0] = capture->height;
+        capture->scratch.resize((size_t)capture->width * capture->height * 4);
+        return 1;
+    }
+
+    static void* bake_lock_cb(void* opaque, void** planes) {
+        planes[0] = ((LuaVLC_BakeCapture*)opaque)->scratch.data();
+        return NULL;
+    }
+
+    static void bake_display_cb(void* opaque, void* picture) {
+        LuaVLC_BakeCapture* capture = (LuaVLC_BakeCapture*)opaque;
+        std::unique_lock<std::mutex> lock(capture->mutex);
+        if(capture->finished)
+            return;
+        size_t rawBytes = capture->scratch.size();
+        if(capture->format == LUAVLC_COMPRESS_NONE) {
+            if((uint64_t)(capture->frames + 1) * rawBytes > capture->maxBytes || !bake_reserve(capture, capture->frames + 1, rawBytes)) {
+                bake_too_big(capture);
+                return;
+            }
+            memcpy(capture->pixels + capture->frames * rawBytes, capture->scratch.data(), rawBytes);
+            capture->frames++;
+            return;
+        }
+
+        // the budget is for the compressed frames, the raw ones only wait here until the worker gets to them
+        size_t chunk = bake_chunk_frames(capture);
+        capture->drained.wait(lock, [capture, chunk]{ return capture->finished || capture->stagedFrames < chunk * 2; });
+        if(capture->finished)
+            return;
+        size_t frameBytes = compress_frame_bytes(capture->format, capture->width, capture->height);
+        if((uint64_t)(capture->frames + capture->stagedFrames + 1) * frameBytes > capture->maxBytes) {
+            bake_too_big(capture);
+            return;
+        }
+        if(capture->staged.empty())
+            capture->staged.reserve(chunk * 2 * rawBytes);
+        capture->staged.insert(capture->staged.end(), capture->scratch.begin(), capture->scratch.end());
+        capture->stagedFrames++;
+        if(capture->stagedFrames >= chunk)
+            capture->done.notify_all();
+    }
+
+    // compresses whatever is staged onto the end of pixels, on the bake worker.
+    // the capture is locked going in and coming out, but not while compressing
+    static void bake_compress_staged(LuaVLC_BakeCapture* capture, std::unique_lock<std::mutex>& lock, int quality) {
+        if(capture->stagedFrames == 0 || capture->tooBig)
+            return;
+        std::vector<unsigned char> raw;
+        raw.swap(capture->staged);
+        size_t count = capture->stagedFrames, first = capture->frames;
+        size_t frameBytes = compress_frame_bytes(capture->format, capture->width, capture->height);
+        // display_cb checks the budget against frames, so they count as soon as they're taken
+        capture->stagedFrames = 0;
+        capture->frames += count;
+        if(!bake_reserve(capture, capture->frames, frameBytes)) {
+            bake_too_big(capture);
+            return;
+        }
+        capture->drained.notify_all();
+        unsigned char* out = capture->pixels + first * frameBytes;
+        lock.unlock();
+        compress_frames(capture->format, quality, raw.data(), capture->width, capture->height, count, out);
+        lock.lock();
+    }
+
+    static void bake_clip(const LuaVLC_BakeJob& job, LuaVLC_BakeResult* result) {
+        // throw out anything that's obviously too big before decoding a single frame of it
+        LuaVLC_ProbeResult probe = {};
+        probe_media(job.path, &probe, _bake_pool.stopping);
+        if(probe.status != LUAVLC_PROBE_DONE)
+            return;
+        if(probe.duration > 0.0 && probe.width > 0 && probe.height > 0) {
+            unsigned int width = job.width, height = job.height;
+            thumbnail_fit(probe.width, probe.height, &width, &height);
+            double frames = std::ceil(probe.duration * (probe.fps > 0.0 ? probe.fps : 30.0));
+            double frameBytes = job.format != LUAVLC_COMPRESS_NONE ? (double)compress_frame_bytes(job.format, width, height) : (double)width * height * 4;
+            if(probe.duration > job.maxSeconds || frames * frameBytes > (double)job.maxBytes) {
+                result->status = LUAVLC_BAKE_TOO_BIG;
+                return;
+            }
+        }
+
+        libvlc_media_t* media = luavlc_media_new_path(job.path.c_str());
+        if(media == NULL || media == nullptr)
+            return;
+        libvlc_media_add_option(media, ":no-audio");
+        libvlc_media_add_option(media, ":no-spu");
+        libvlc_media_player_t* mp = luavlc_media_player_new_from_media(media);
+        libvlc_media_release(media);
+        if(mp == NULL || mp == nullptr)
+            return;
+
+        LuaVLC_BakeCapture capture;
+        capture.width = job.width;
+        capture.height = job.height;
+        capture.format = job.format;
+        capture.maxBytes = job.maxBytes;
+        libvlc_video_set_callbacks(mp, bake_lock_cb, NULL, bake_display_cb, &capture);
+        libvlc_video_set_format_callbacks(mp, bake_setup_cb, NULL);
+        libvlc_media_player_play(mp);
+        {
+            std::unique_lock<std::mutex> lock(capture.mutex);
+            double deadline = luavlc_now_ms() + job.maxSeconds * 1000.0 + 5000.0;
+            while(!capture.finished && !_bake_pool.stopping && luavlc_now_ms() < deadline) {
+                capture.done.wait_for(lock, std::chrono::milliseconds(20));
+                if(capture.stagedFrames >= bake_chunk_frames(&capture))
+                    bake_compress_staged(&capture, lock, job.quality);
+                // stopped, ended (3.0's Ended is 4.0's Stopping) or failed
+                if(libvlc_media_player_get_state(mp) >= libvlc_Stopped)
+                    break;
+            }
+            // a display_cb waiting for room would hold up the release below
+            capture.finished = true;
+            capture.drained.notify_all();
+        }
+        double frameMs = frame_duration_ms(mp);
+        libvlc_media_player_release(mp);
+        {
+            std::unique_lock<std::mutex> lock(capture.mutex);
+            bake_compress_staged(&capture, lock, job.quality);
+        }
+
+        if(capture.tooBig || capture.frames == 0) {
+            free(capture.pixels);
+            result->status = capture.tooBig ? LUAVLC_BAKE_TOO_BIG : LUAVLC_BAKE_FAILED;
+            return;
+        }
+        result->format = job.format;
+        result->frameBytes = job.format != LUAVLC_COMPRESS_NONE ? compress_frame_bytes(job.format, capture.width, capture.height) : (size_t)capture.width * capture.height * 4;
+        result->status = LUAVLC_BAKE_DONE;
+        result->width = capture.width;
+        result->height = capture.height;
+        result->frames = (unsigned int)capture.frames;
+        result->fps = frameMs > 0.0 ? 1000.0 / frameMs : probe.fps > 0.0 ? probe.fps : probe.duration > 0.0 ? capture.frames / probe.duration : 30.0;
+        result->pixels = capture.pixels;
+    }
+
+    static void bake_work(const LuaVLC_BakeJob& job, LuaVLC_BakeResult* result) {
+        result->status = LUAVLC_BAKE_FAILED;
+        if(_bake_pool.waitForInstance())
+            bake_clip(job, result);
+    }
+
+    static void bake_shutdown() {
+        _bake_pool.shutdown();
+        for(LuaVLC_BakeResult& result : _bake_pool.finished)
+            free(result.pixels);
+        _bake_pool.finished.clear();
+    }
+
+    // how many clips get baked at once
+    EXPORT_DLL void luavlc_bake_configure(int workers) {
+        std::lock_guard<std::mutex> lock(_bake_pool.mutex);
+        _bake_pool.maxWorkers = std::max(workers, 1);
+    }
+
+    // clips longer than maxSeconds or bigger than maxBytes decoded come back as LUAVLC_BAKE_TOO_BIG,
+    // format (LUAVLC_COMPRESS_*) block compresses the frames in chunks while it decodes, maxBytes is
+    // what they take up compressed.
+    // returns the id its result will have
+    EXPORT_DLL int luavlc_bake_request(const char* path, unsigned int width, unsigned int height, uint64_t maxBytes, double maxSeconds, int format, int quality) {
+        if(format < LUAVLC_COMPRESS_NONE || format > LUAVLC_COMPRESS_ETC1)
+            format = LUAVLC_COMPRESS_NONE;
+        return _bake_pool.request({0, path, width, height, maxBytes, maxSeconds, format, std::min(std::max(quality, 0), COMPRESS_QUALITY_MAX)});
+    }
+
+    // takes one finished clip, returns false if there isn't one
+    EXPORT_DLL bool luavlc_bake_poll(LuaVLC_BakeResult* out) {
+        return _bake_pool.poll(out);
+    }
+
+    EXPORT_DLL void luavlc_bake_free_pixels(unsigned char* pixels) {
+        free(pixels);
+    }
+
+    // dirty region tracking, for screencasts/slideshows/ui recordings where most of the frame stays the same.
+    // display_cb compares every new frame with a copy of the last one in bands of rows, and lua only
+    // uploads the bands that changed (or nothing at all for a repeated frame)
+    static const unsigned int DIRTY_BAND_ROWS = 16;
+    static const int DIRTY_MAX_RANGES = 32; // past this many separate ranges lua just uploads everything
+
+    typedef struct {
+        uint64_t frames;
+        uint64_t identical; // frames where nothing changed
+        uint64_t dirtyRows; // rows that changed, over every frame
+        uint64_t totalRows;
+    } LuaVLC_DirtyStats;
+
+    struct LuaVLC_DirtyTracker {
+        std::mutex mutex;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        std::vector<unsigned char> previous; // tightly packed, width * 4 per row
+        std::vector<unsigned char> pending; // one per band, changed since lua last took them
+        bool primed = false; // previous holds a real frame
+        LuaVLC_DirtyStats stats = {};
+    };
+
+    // whether length bytes of a and b differ, 64 bytes at a time
+#if LUAVLC_SSE2
+    static bool dirty_differs(const unsigned char* a, const unsigned char* b, size_t length) {
+        size_t i = 0;
+        for(; i + 64 <= length; i += 64) {
+            __m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+            __m128i e1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i + 16)), _mm_loadu_si128((const __m128i*)(b + i + 16)));
+            __m128i e2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i + 32)), _mm_loadu_si128((const __m128i*)(b + i + 32)));
+            __m128i e3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i + 48)), _mm_loadu_si128((const __m128i*)(b + i + 48)));
+            if(_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(e0, e1), _mm_and_si128(e2, e3))) != 0xFFFF)
+                return true;
+        }
+        return memcmp(a + i, b + i, length - i) != 0;
+    }
+#else
+    static bool dirty_differs(const unsigned char* a, const unsigned char* b, size_t length) {
+        return memcmp(a, b, length) != 0;
+    }
+#endif
+
+    // runs on vlc's thread right after a frame lands in the pixel buffer (and after frame cache steps)
+    static void dirty_track(LuaVLC_Video* video) {
+        std::shared_ptr<LuaVLC_DirtyTracker> tracker = std::atomic_load(&video->dirty);
+        if(tracker == nullptr || video->pixelBuffer == nullptr)
+            return;
+        std::lock_guard<std::mutex> lock(tracker->mutex);
+        if(tracker->width != video->width || tracker->height != video->height)
+            return;
+        size_t rowBytes = (size_t)tracker->width * 4, pitch = video_pitch(video);
+        unsigned int bands = (unsigned int)tracker->pending.size(), dirtyRows = 0;
+        for(unsigned int band = 0; band < bands; band++) {
+            unsigned int first = band * DIRTY_BAND_ROWS, last = std::min(first + DIRTY_BAND_ROWS, tracker->height);
+            bool changed = !tracker->primed;
+            for(unsigned int row = first; row < last && !changed; row++)
+                changed = dirty_differs(video->pixelBuffer + row * pitch, &tracker->previous[row * rowBytes], rowBytes);
+            if(!changed)
+                continue;
+            for(unsigned int row = first; row < last; row++)
+                memcpy(&tracker->previous[row * rowBytes], video->pixelBuffer + row * pitch, rowBytes);
+            tracker->pending[band] = 1;
+            dirtyRows += last - first;
+        }
+        tracker->primed = true;
+        tracker->stats.frames++;
+        tracker->stats.dirtyRows += dirtyRows;
+        tracker->stats.totalRows += tracker->height;
+        if(dirtyRows == 0)
+            tracker->stats.identical++;
+    }
+
+    // turns tracking on (or off) for the size the video is showing frames at right now,
+    // everything counts as changed until the first frame after this
+    EXPORT_DLL void luavlc_dirty_configure(LuaVLC_Video* video, bool enabled) {
+        if(video == NULL || video == nullptr)
+            return;
+        std::shared_ptr<LuaVLC_DirtyTracker> old = std::atomic_load(&video->dirty);
+        if(old != nullptr)
+            memory_track(video, LUAVLC_MEM_FRAME, -(int64_t)old->previous.size());
+        std::shared_ptr<LuaVLC_DirtyTracker> tracker;
+        if(enabled && video->width > 0 && video->height > 0) {
+            tracker = std::make_shared<LuaVLC_DirtyTracker>();
+            tracker->width = video->width;
+            tracker->height = video->height;
+            tracker->previous.resize((size_t)video->width * video->height * 4);
+            tracker->pending.assign((video->height + DIRTY_BAND_ROWS - 1) / DIRTY_BAND_ROWS, 1);
+            memory_track(video, LUAVLC_MEM_FRAME, (int64_t)tracker->previous.size());
+        }
+        std::atomic_store(&video->dirty, tracker);
+    }
+
+    // takes the rows that changed since the last call, as (first row, row count) pairs in ranges.
+    // returns how many pairs, 0 if nothing changed, or -1 if everything should be uploaded
+    // (tracking is off, or there's more than max ranges)
+    EXPORT_DLL int luavlc_dirty_take(LuaVLC_Video* video, unsigned int* ranges, int max) {
+        std::shared_ptr<LuaVLC_DirtyTracker> tracker = std::atomic_load(&video->dirty);
+        if(tracker == nullptr)
+            return -1;
+        std::lock_guard<std::mutex> lock(tracker->mutex);
+        int count = 0;
+        bool overflow = false;
+        unsigned int bands = (unsigned int)tracker->pending.size();
+        for(unsigned int band = 0; band < bands; band++) {
+            if(!tracker->pending[band])
+                continue;
+            unsigned int first = band;
+            while(band + 1 < bands && tracker->pending[band + 1])
+                band++;
+            if(count == max) {
+                overflow = true;
+                continue;
+            }
+            ranges[count * 2] = first * DIRTY_BAND_ROWS;
+            ranges[count * 2 + 1] = std::min((band + 1) * DIRTY_BAND_ROWS, tracker->height) - first * DIRTY_BAND_ROWS;
+            count++;
+        }
+        std::fill(tracker->pending.begin(), tracker->pending.end(), 0);
+        return overflow ? -1 : count;
+    }
+
+    EXPORT_DLL bool luavlc_dirty_stats(LuaVLC_Video* video, LuaVLC_DirtyStats* out) {
+        std::shared_ptr<LuaVLC_DirtyTracker> tracker = std::atomic_load(&video->dirty);
+        if(tracker == nullptr)
+            return false;
+        std::lock_guard<std::mutex> lock(tracker->mutex);
+        *out = tracker->stats;
+        return true;
+    }
+
+    // async texture uploads thru a ring of persistently mapped pixel buffer objects. a worker copies every
+    // finished frame into a free slot, and the main thread only has to tell gl to update the texture
+    // from it (which the driver does whenever it gets to it) instead of replacePixels copying the whole
+    // frame synchronously. only for desktop gl 4.4+ (or ARB_buffer_storage) on a real gpu, lua falls back
+    // to replacePixels everywhere else
+#if _WIN32
+    #define LUAVLC_GLAPI APIENTRY
+#else
+    #define LUAVLC_GLAPI
+#endif
+    typedef unsigned int LuaVLC_GLenum;
+    typedef unsigned int LuaVLC_GLuint;
+    typedef int LuaVLC_GLint;
+    typedef struct __GLsync* LuaVLC_GLsync;
+
+    enum {
+        LUAVLC_GL_TEXTURE_2D = 0x0DE1,
+        LUAVLC_GL_TEXTURE_WIDTH = 0x1000,
+        LUAVLC_GL_TEXTURE_HEIGHT = 0x1001,
+        LUAVLC_GL_UNSIGNED_BYTE = 0x1401,
+        LUAVLC_GL_RGBA = 0x1908,
+        LUAVLC_GL_RENDERER = 0x1F01,
+        LUAVLC_GL_VERSION = 0x1F02,
+        LUAVLC_GL_UNPACK_ROW_LENGTH = 0x0CF2,
+        LUAVLC_GL_UNPACK_SKIP_ROWS = 0x0CF3,
+        LUAVLC_GL_UNPACK_SKIP_PIXELS = 0x0CF4,
+        LUAVLC_GL_UNPACK_ALIGNMENT = 0x0CF5,
+        LUAVLC_GL_TEXTURE_BINDING_2D = 0x8069,
+        LUAVLC_GL_TEXTURE0 = 0x84C0,
+        LUAVLC_GL_ACTIVE_TEXTURE = 0x84E0,
+        LUAVLC_GL_PIXEL_UNPACK_BUFFER = 0x88EC,
+        LUAVLC_GL_PIXEL_UNPACK_BUFFER_BINDING = 0x88EF,
+        LUAVLC_GL_NUM_EXTENSIONS = 0x821D,
+        LUAVLC_GL_EXTENSIONS = 0x1F03,
+        LUAVLC_GL_SYNC_GPU_COMMANDS_COMPLETE = 0x9117,
+        LUAVLC_GL_ALREADY_SIGNALED = 0x911A,
+        LUAVLC_GL_CONDITION_SATISFIED = 0x911C,
+        LUAVLC_GL_MAP_WRITE_BIT = 0x0002,
+        LUAVLC_GL_MAP_PERSISTENT_BIT = 0x0040,
+        LUAVLC_GL_MAP_COHERENT_BIT = 0x0080
+    };
+
+    static struct {
+        const unsigned char* (LUAVLC_GLAPI *GetString)(LuaVLC_GLenum);
+        const unsigned char* (LUAVLC_GLAPI *GetStringi)(LuaVLC_GLenum, LuaVLC_GLuint);
+        void (LUAVLC_GLAPI *GetIntegerv)(LuaVLC_GLenum, LuaVLC_GLint*);
+        void (LUAVLC_GLAPI *GenBuffers)(int, LuaVLC_GLuint*);
+        void (LUAVLC_GLAPI *DeleteBuffers)(int, const LuaVLC_GLuint*);
+        void (LUAVLC_GLAPI *BindBuffer)(LuaVLC_GLenum, LuaVLC_GLuint);
+        void (LUAVLC_GLAPI *BufferStorage)(LuaVLC_GLenum, ptrdiff_t, const void*, unsigned int);
+        void* (LUAVLC_GLAPI *MapBufferRange)(LuaVLC_GLenum, ptrdiff_t, ptrdiff_t, unsigned int);
+        unsigned char (LUAVLC_GLAPI *UnmapBuffer)(LuaVLC_GLenum);
+        void (LUAVLC_GLAPI *BindTexture)(LuaVLC_GLenum, LuaVLC_GLuint);
+        void (LUAVLC_GLAPI *ActiveTexture)(LuaVLC_GLenum);
+        unsigned char (LUAVLC_GLAPI *IsTexture)(LuaVLC_GLuint);
+        void (LUAVLC_GLAPI *GetTexLevelParameteriv)(LuaVLC_GLenum, LuaVLC_GLint, LuaVLC_GLenum, LuaVLC_GLint*);
+        void (LUAVLC_GLAPI *PixelStorei)(LuaVLC_GLenum, LuaVLC_GLint);
+        void (LUAVLC_GLAPI *TexSubImage2D)(LuaVLC_GLenum, LuaVLC_GLint, LuaVLC_GLint, LuaVLC_GLint, int, int, LuaVLC_GLenum, LuaVLC_GLenum, const void*);
+        LuaVLC_GLsync (LUAVLC_GLAPI *FenceSync)(LuaVLC_GLenum, unsigned int);
+        LuaVLC_GLenum (LUAVLC_GLAPI *ClientWaitSync)(LuaVLC_GLsync, unsigned int, uint64_t);
+        void (LUAVLC_GLAPI *DeleteSync)(LuaVLC_GLsync);
+    } _gl;
+    static int _gl_state = 0; // 0 = not loaded, 1 = usable, -1 = not usable
+
+    // love's gl context, thru sdl (3 for love 12, 2 for 11)
+    static void* gl_proc(const char* name) {
+        typedef void* (*get_proc_address)(const char*);
+        static get_proc_address getProcAddress = nullptr;
+        if(getProcAddress == nullptr) {
+        #if _WIN32
+            HMODULE sdl = GetModuleHandleA("SDL3.dll");
+            if(sdl == NULL)
+                sdl = GetModuleHandleA("SDL2.dll");
+            getProcAddress = sdl != NULL ? (get_proc_address)(void*)GetProcAddress(sdl, "SDL_GL_GetProcAddress") : nullptr;
+        #else
+            getProcAddress = (get_proc_address)dlsym(RTLD_DEFAULT, "SDL_GL_GetProcAddress");
+        #endif
+            if(getProcAddress == nullptr)
+                return NULL;
+        }
+        return getProcAddress(name);
+    }
+
+    // has to be called on the thread with love's gl context (the main one)
+    // returns whether async uploads work, and why not in reason if they don't
+    EXPORT_DLL bool luavlc_gl_load(const char** reason) {
+        static const char* failure = "";
+        if(_gl_state == 0) {
+            _gl_state = -1;
+            #define LUAVLC_GL_LOAD(name) *(void**)&_gl.name = gl_proc("gl" #name)
+            LUAVLC_GL_LOAD(GetString); LUAVLC_GL_LOAD(GetStringi); LUAVLC_GL_LOAD(GetIntegerv);
+            LUAVLC_GL_LOAD(GenBuffers); LUAVLC_GL_LOAD(DeleteBuffers); LUAVLC_GL_LOAD(BindBuffer);
+            LUAVLC_GL_LOAD(BufferStorage); LUAVLC_GL_LOAD(MapBufferRange); LUAVLC_GL_LOAD(UnmapBuffer);
+            LUAVLC_GL_LOAD(BindTexture); LUAVLC_GL_LOAD(ActiveTexture); LUAVLC_GL_LOAD(IsTexture);
+            LUAVLC_GL_LOAD(GetTexLevelParameteriv); LUAVLC_GL_LOAD(PixelStorei); LUAVLC_GL_LOAD(TexSubImage2D);
+            LUAVLC_GL_LOAD(FenceSync); LUAVLC_GL_LOAD(ClientWaitSync); LUAVLC_GL_LOAD(DeleteSync);
+            #undef LUAVLC_GL_LOAD
+
+            void** functions = (void**)&_gl;
+            bool complete = true;
+            for(size_t i = 0; i < sizeof(_gl) / sizeof(void*); i++)
+                complete = complete && functions[i] != NULL;
+            const char* version = complete ? (const char*)_gl.GetString(LUAVLC_GL_VERSION) : NULL;
+            const char* renderer = complete ? (const char*)_gl.GetString(LUAVLC_GL_RENDERER) : NULL;
+            if(!complete || version == NULL || renderer == NULL) {
+                failure = "no OpenGL context (or it's missing buffer storage/sync objects)";
+            } else if(strncmp(version, "OpenGL ES", 9) == 0) {
+                failure = "OpenGL ES";
+            } else if(strstr(renderer, "llvmpipe") != NULL || strstr(renderer, "softpipe") != NULL || strstr(renderer, "SwiftShader") != NULL ||
+                      strstr(renderer, "GDI Generic") != NULL || strstr(renderer, "Software Rasterizer") != NULL) {
+                // nothing's asynchronous about a software renderer, it'd just be an extra copy
+                failure = "software renderer";
+            } else {
+                int major = 0, minor = 0;
+                sscanf(version, "%d.%d", &major, &minor);
+                bool storage = major > 4 || (major == 4 && minor >= 4);
+                LuaVLC_GLint count = 0;
+                _gl.GetIntegerv(LUAVLC_GL_NUM_EXTENSIONS, &count);
+                for(LuaVLC_GLint i = 0; i < count && !storage; i++) {
+                    const char* extension = (const char*)_gl.GetStringi(LUAVLC_GL_EXTENSIONS, (LuaVLC_GLuint)i);
+                    storage = extension != NULL && strcmp(extension, "GL_ARB_buffer_storage") == 0;
+                }
+                if(storage)
+                    _gl_state = 1;
+                else
+                    failure = "no ARB_buffer_storage";
+            }
+        }
+        if(reason != NULL)
+            *reason = _gl_state == 1 ? "" : failure;
+        return _gl_state == 1;
+    }
+
+    // the 2d texture love last bound to unit 0, for finding out an Image's name right after drawing it
+    EXPORT_DLL unsigned int luavlc_gl_bound_texture(void) {
+        if(_gl_state != 1)
+            return 0;
+        LuaVLC_GLint active = 0, texture = 0;
+        _gl.GetIntegerv(LUAVLC_GL_ACTIVE_TEXTURE, &active);
+        _gl.ActiveTexture(LUAVLC_GL_TEXTURE0);
+        _gl.GetIntegerv(LUAVLC_GL_TEXTURE_BINDING_2D, &texture);
+        _gl.ActiveTexture((LuaVLC_GLenum)active);
+        return (unsigned int)texture;
+    }
+
+    static const int PBO_SLOTS = 3;
+
+    enum {
+        LUAVLC_PBO_FREE = 0,
+        LUAVLC_PBO_FILLING, // the worker is copying into it
+        LUAVLC_PBO_READY, // has a frame that hasn't been uploaded yet
+        LUAVLC_PBO_UPLOADING // gl is reading from it, until its fence signals
+    };
+
+    typedef struct {
+        uint64_t copied; // frames the worker copied into a slot
+        uint64_t uploaded;
+        uint64_t dropped; // frames that came in while every slot was busy
+        double copyMs; // total, on the worker
+        double submitMs; // total, on the main thread
+    } LuaVLC_PboStats;
+
+    struct LuaVLC_PboStream {
+        LuaVLC_Video* video = nullptr;
+        std::mutex mutex; // held by the worker while it copies, so the mapping can't go away under it
+        unsigned int width = 0;
+        unsigned int height = 0;
+        size_t frameBytes = 0;
+        LuaVLC_GLuint buffer = 0;
+        LuaVLC_GLuint texture = 0;
+        unsigned char* mapped = nullptr;
+        std::atomic<int> state[PBO_SLOTS];
+        uint64_t sequence[PBO_SLOTS] = {}; // which frame each slot has, newer is bigger
+        LuaVLC_GLsync fences[PBO_SLOTS] = {};
+        uint64_t frames = 0;
+        std::atomic<bool> pending{false};
+        LuaVLC_PboStats stats = {};
+    };
+
+    struct LuaVLC_PboJob {
+        int id;
+        std::shared_ptr<LuaVLC_PboStream> stream;
+    };
+
+    static void pbo_work(const LuaVLC_PboJob& job, LuaVLC_NoResult* result);
+    // a video only ever has one copy queued (see pending), the second worker is for the next video
+    static LuaVLC_WorkerPool<LuaVLC_PboJob> _pbo_pool(pbo_work, 2);
+
+    static void pbo_copy(LuaVLC_PboStream* stream) {
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        LuaVLC_Video* video = stream->video;
+        if(stream->mapped == nullptr || video == nullptr || video->pixelBuffer == nullptr || video->width != stream->width || video->height != stream->height)
+            return;
+        int slot = -1;
+        for(int i = 0; i < PBO_SLOTS && slot < 0; i++) {
+            int expected = LUAVLC_PBO_FREE;
+            if(stream->state[i].compare_exchange_strong(expected, LUAVLC_PBO_FILLING))
+                slot = i;
+        }
+        if(slot < 0) {
+            stream->stats.dropped++;
+            return;
+        }
+        double start = luavlc_now_ms();
+        size_t rowBytes = (size_t)stream->width * 4, pitch = video_pitch(video);
+        unsigned char* dest = stream->mapped + slot * stream->frameBytes;
+        if(pitch == rowBytes) {
+            memcpy(dest, video->pixelBuffer, stream->frameBytes);
+        } else {
+            for(unsigned int row = 0; row < stream->height; row++)
+                memcpy(dest + row * rowBytes, video->pixelBuffer + row * pitch, rowBytes);
+        }
+        stream->sequence[slot] = ++stream->frames;
+        stream->state[slot].store(LUAVLC_PBO_READY, std::memory_order_release);
+        // anything older that never got uploaded is stale now
+        for(int i = 0; i < PBO_SLOTS; i++) {
+            int expected = LUAVLC_PBO_READY;
+            if(i != slot && stream->sequence[i] < stream->sequence[slot])
+                stream->state[i].compare_exchange_strong(expected, LUAVLC_PBO_FREE);
+        }
+        stream->stats.copied++;
+        stream->stats.copyMs += luavlc_now_ms() - start;
+    }
+
+    static void pbo_work(const LuaVLC_PboJob& job, LuaVLC_NoResult* result) {
+        job.stream->pending = false;
+        pbo_copy(job.stream.get());
+    }
+
+    // called on vlc's thread every time a new frame is in the pixel buffer
+    static void pbo_frame(LuaVLC_Video* video) {
+        std::shared_ptr<LuaVLC_PboStream> stream = std::atomic_load(&video->pbo);
+        if(stream == nullptr || stream->pending.exchange(true))
+            return;
+        _pbo_pool.request({0, stream});
+    }
+
+    // lua holds raw pointers, these keep the streams alive until luavlc_pbo_destroy
+    static std::mutex _pbo_streams_mutex;
+    static std::unordered_map<LuaVLC_PboStream*, std::shared_ptr<LuaVLC_PboStream>> _pbo_streams;
+
+    static void pbo_shutdown() {
+        _pbo_pool.shutdown();
+    }
+
+    // gl state love keeps its own copy of, everything gets put back the way it was
+    struct LuaVLC_GLSaved {
+        LuaVLC_GLint active, texture, unpackBuffer, alignment, rowLength, skipRows, skipPixels;
+
+        void save() {
+            _gl.GetIntegerv(LUAVLC_GL_ACTIVE_TEXTURE, &active);
+            _gl.ActiveTexture(LUAVLC_GL_TEXTURE0);
+            _gl.GetIntegerv(LUAVLC_GL_TEXTURE_BINDING_2D, &texture);
+            _gl.GetIntegerv(LUAVLC_GL_PIXEL_UNPACK_BUFFER_BINDING, &unpackBuffer);
+            _gl.GetIntegerv(LUAVLC_GL_UNPACK_ALIGNMENT, &alignment);
+            _gl.GetIntegerv(LUAVLC_GL_UNPACK_ROW_LENGTH, &rowLength);
+            _gl.GetIntegerv(LUAVLC_GL_UNPACK_SKIP_ROWS, &skipRows);
+            _gl.GetIntegerv(LUAVLC_GL_UNPACK_SKIP_PIXELS, &skipPixels);
+        }
+
+        void restore() {
+            _gl.PixelStorei(LUAVLC_GL_UNPACK_ALIGNMENT, alignment);
+            _gl.PixelStorei(LUAVLC_GL_UNPACK_ROW_LENGTH, rowLength);
+            _gl.PixelStorei(LUAVLC_GL_UNPACK_SKIP_ROWS, skipRows);
+            _gl.PixelStorei(LUAVLC_GL_UNPACK_SKIP_PIXELS, skipPixels);
+            _gl.BindBuffer(LUAVLC_GL_PIXEL_UNPACK_BUFFER, (LuaVLC_GLuint)unpackBuffer);
+            _gl.BindTexture(LUAVLC_GL_TEXTURE_2D, (LuaVLC_GLuint)texture);
+            _gl.ActiveTexture((LuaVLC_GLenum)active);
+        }
+    };
+
+    // sets up async uploads from the video's pixel buffer into texture (a gl texture name, the same
+    // size as the video). main thread only. returns NULL if it can't be done, use replacePixels then
+    EXPORT_DLL LuaVLC_PboStream* luavlc_pbo_create(LuaVLC_Video* video, unsigned int texture) {
+        if(video == NULL || video == nullptr || video->width == 0 || video->height == 0 || texture == 0 || !luavlc_gl_load(NULL) || !_gl.IsTexture(texture))
+            return NULL;
+
+        LuaVLC_GLSaved saved;
+        saved.save();
+        _gl.BindTexture(LUAVLC_GL_TEXTURE_2D, texture);
+        LuaVLC_GLint width = 0, height = 0;
+        _gl.GetTexLevelParameteriv(LUAVLC_GL_TEXTURE_2D, 0, LUAVLC_GL_TEXTURE_WIDTH, &width);
+        _gl.GetTexLevelParameteriv(LUAVLC_GL_TEXTURE_2D, 0, LUAVLC_GL_TEXTURE_HEIGHT, &height);
+        std::shared_ptr<LuaVLC_PboStream> stream;
+        // guards against love binding something else than what we thought
+        if((unsigned int)width == video->width && (unsigned int)height == video->height) {
+            stream = std::make_shared<LuaVLC_PboStream>();
+            stream->video = video;
+            stream->width = video->width;
+            stream->height = video->height;
+            stream->frameBytes = (size_t)video->width * video->height * 4;
+            stream->texture = texture;
+            for(int i = 0; i < PBO_SLOTS; i++)
+                stream->state[i] = LUAVLC_PBO_FREE;
+            unsigned int flags = LUAVLC_GL_MAP_WRITE_BIT | LUAVLC_GL_MAP_PERSISTENT_BIT | LUAVLC_GL_MAP_COHERENT_BIT;
+            ptrdiff_t size = (ptrdiff_t)(stream->frameBytes * PBO_SLOTS);
+            _gl.GenBuffers(1, &stream->buffer);
+            _gl.BindBuffer(LUAVLC_GL_PIXEL_UNPACK_BUFFER, stream->buffer);
+            _gl.BufferStorage(LUAVLC_GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+            stream->mapped = (unsigned char*)_gl.MapBufferRange(LUAVLC_GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+            if(stream->mapped == nullptr) {
+                _gl.DeleteBuffers(1, &stream->buffer);
+                stream.reset();
+            }
+        }
+        saved.restore();
+        if(stream == nullptr)
+            return NULL;
+
+        memory_track(video, LUAVLC_MEM_TEXTURE, (int64_t)(stream->frameBytes * PBO_SLOTS));
+        {
+            std::lock_guard<std::mutex> lock(_pbo_streams_mutex);
+            _pbo_streams[stream.get()] = stream;
+        }
+        std::atomic_store(&video->pbo, stream);
+        // the frame that's already there
+        pbo_frame(video);
+        return stream.get();
+    }
+
+    // lets gl pick up the newest copied frame, if there is one. main thread only, call it every frame
+    // the video gets drawn. returns whether the texture is getting a new frame
+    EXPORT_DLL bool luavlc_pbo_upload(LuaVLC_PboStream* stream) {
+        if(stream == NULL || stream == nullptr || stream->mapped == nullptr)
+            return false;
+        int newest = -1;
+        for(int i = 0; i < PBO_SLOTS; i++) {
+            int state = stream->state[i].load(std::memory_order_acquire);
+            if(state == LUAVLC_PBO_UPLOADING) {
+                LuaVLC_GLenum result = _gl.ClientWaitSync(stream->fences[i], 0, 0);
+                if(result == LUAVLC_GL_ALREADY_SIGNALED || result == LUAVLC_GL_CONDITION_SATISFIED) {
+                    _gl.DeleteSync(stream->fences[i]);
+                    stream->fences[i] = nullptr;
+                    stream->state[i].store(LUAVLC_PBO_FREE, std::memory_order_release);
+                }
+            } else if(state == LUAVLC_PBO_READY && (newest < 0 || stream->sequence[i] > stream->sequence[newest])) {
+                newest = i;
+            }
+        }
+        int expected = LUAVLC_PBO_READY;
+        if(newest < 0 || !stream->state[newest].compare_exchange_strong(expected, LUAVLC_PBO_UPLOADING))
+            return false;
+
+        double start = luavlc_now_ms();
+        LuaVLC_GLSaved saved;
+        saved.save();
+        _gl.BindTexture(LUAVLC_GL_TEXTURE_2D, stream->texture);
+        _gl.BindBuffer(LUAVLC_GL_PIXEL_UNPACK_BUFFER, stream->buffer);
+        _gl.PixelStorei(LUAVLC_GL_UNPACK_ALIGNMENT, 4);
+        _gl.PixelStorei(LUAVLC_GL_UNPACK_ROW_LENGTH, 0);
+        _gl.PixelStorei(LUAVLC_GL_UNPACK_SKIP_ROWS, 0);
+        _gl.PixelStorei(LUAVLC_GL_UNPACK_SKIP_PIXELS, 0);
+        // with a pixel unpack buffer bound the pointer is an offset into it
+        _gl.TexSubImage2D(LUAVLC_GL_TEXTURE_2D, 0, 0, 0, (int)stream->width, (int)stream->height, LUAVLC_GL_RGBA, LUAVLC_GL_UNSIGNED_BYTE,
+            (const void*)(uintptr_t)(newest * stream->frameBytes));
+        stream->fences[newest] = _gl.FenceSync(LUAVLC_GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        saved.restore();
+        stream->stats.uploaded++;
+        stream->stats.submitMs += luavlc_now_ms() - start;
+        return true;
+    }
+
+    // for videos freed without destroying their stream first. the stream stays around (see _pbo_streams)
+    // so luavlc_pbo_destroy can still clean up the gl objects, the worker won't copy out of a video that's gone
+    // and the memory it counted goes back with the video
+    static void pbo_detach(LuaVLC_Video* video) {
+        std::shared_ptr<LuaVLC_PboStream> stream = std::atomic_load(&video->pbo);
+        if(stream == nullptr)
+            return;
+        std::atomic_store(&video->pbo, std::shared_ptr<LuaVLC_PboStream>());
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        stream->video = nullptr;
+    }
+
+    // main thread only, the stream can't be used after this
+    EXPORT_DLL void luavlc_pbo_destroy(LuaVLC_PboStream* stream) {
+        if(stream == NULL || stream == nullptr)
+            return;
+        // keeps it alive until the end of this, a queued copy can still hold a reference after
+        std::shared_ptr<LuaVLC_PboStream> owned;
+        {
+            std::lock_guard<std::mutex> lock(_pbo_streams_mutex);
+            auto it = _pbo_streams.find(stream);
+            if(it == _pbo_streams.end())
+                return;
+            owned = std::move(it->second);
+            _pbo_streams.erase(it);
+        }
+        LuaVLC_Video* video;
+        {
+            // waits for a copy that's still going
+            std::lock_guard<std::mutex> lock(stream->mutex);
+            // null if the video was freed first (pbo_detach)
+            video = stream->video;
+            if(video != nullptr) {
+                std::shared_ptr<LuaVLC_PboStream> expected = owned;
+                std::atomic_compare_exchange_strong(&video->pbo, &expected, std::shared_ptr<LuaVLC_PboStream>());
+            }
+            LuaVLC_GLSaved saved;
+            saved.save();
+            _gl.BindBuffer(LUAVLC_GL_PIXEL_UNPACK_BUFFER, stream->buffer);
+            _gl.UnmapBuffer(LUAVLC_GL_PIXEL_UNPACK_BUFFER);
+            saved.restore();
+            // gl keeps the buffer alive until uploads still reading from it are done
+            _gl.DeleteBuffers(1, &stream->buffer);
+            for(int i = 0; i < PBO_SLOTS; i++) {
+                if(stream->fences[i] != nullptr)
+                    _gl.DeleteSync(stream->fences[i]);
+            }
+            stream->mapped = nullptr;
+            stream->video = nullptr;
+        }
+        if(video != nullptr)
+            memory_track(video, LUAVLC_MEM_TEXTURE, -(int64_t)(stream->frameBytes * PBO_SLOTS));
+    }
+
+    EXPORT_DLL bool luavlc_pbo_stats(LuaVLC_PboStream* stream, LuaVLC_PboStats* out) {
+        if(stream == NULL || stream == nullptr)
+            return false;
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        *out = stream->stats;
+        return true;
+    }
+
+    // frame rate conversion, for 24/25/30 fps videos on 60/120/144hz screens. display_cb copies every frame into a
+    // small queue of lua's images, stamped with when it's due, and every draw picks the frame(s) for that moment
+    // instead of whatever came in last. vmem doesn't hand out pts, but vlc calls display_cb right when a frame is
+    // due, so those times snapped to the frame duration are the pts on our clock. drawing runs one frame behind
+    // so there's a frame on either side of the time being shown to blend between
+    static const int FRC_SLOTS = 4; // two lua is showing, one being written, one spare
+
+    typedef struct {
+        uint64_t frames; // frames that came in
+        uint64_t presents;
+        uint64_t blended; // presents that mixed two frames
+        uint64_t repeats; // presents that showed the same lone frame as the one before
+        uint64_t skipped; // frames that got written over without ever being shown
+        uint64_t underruns; // frames still on screen after the next one was due
+        uint64_t cuts; // seeks, steps and stalls, which are never blended across
+        double frameMs; // measured time between frames
+        double judderMs; // standard deviation of how far the picture on screen is from where it should be in time
+        double blendWeight; // average weight of the second frame, over blended presents
+    } LuaVLC_FrcStats;
+
+    typedef struct {
+        int first; // slot to draw
+        int second; // slot to blend over it, -1 for none
+        float weight; // of second
+        uint64_t firstSerial; // changes whenever a slot gets a new frame, so lua knows what to upload
+        uint64_t secondSerial;
+    } LuaVLC_FrcPick;
+
+    struct LuaVLC_FrcSlot {
+        unsigned char* pixels = nullptr; // lua's ImageData
+        uint64_t serial = 0; // 0 while empty or being written
+        double pts = 0.0;
+        bool cut = false; // not blended with the frame before it
+        bool shown = false;
+        bool late = false; // already counted as an underrun
+    };
+
+    struct LuaVLC_FrameQueue {
+        std::mutex copyMutex; // held for a whole copy, so turning the queue off waits for one that's going
+        std::mutex mutex; // for everything else
+        bool active = true;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        LuaVLC_FrcSlot slots[FRC_SLOTS];
+        int pinned[2] = {-1, -1}; // what the last pick handed lua, left alone until the next pick
+        uint64_t nextSerial = 1;
+        double lastPts = -1.0;
+        double frameMs = 0.0; // starts at the track's frame rate, then follows what actually comes in
+        bool nominalChecked = false;
+        uint64_t shownFirst = 0; // serials of the last pick
+        uint64_t shownSecond = 0;
+        double errorSum = 0.0;
+        double errorSquares = 0.0;
+        uint64_t errorCount = 0;
+        double weightSum = 0.0;
+        LuaVLC_FrcStats stats = {};
+    };
+
+    // runs on vlc's thread right after a frame lands in the pixel buffer, cut for seeks and frame cache steps
+    static void frc_push(LuaVLC_Video* video, bool cut) {
+        std::shared_ptr<LuaVLC_FrameQueue> queue = std::atomic_load(&video->frameQueue);
+        if(queue == nullptr || video->pixelBuffer == nullptr)
+            return;
+        double now = luavlc_now_ms();
+        std::lock_guard<std::mutex> copyLock(queue->copyMutex);
+        if(!queue->active || queue->width != video->width || queue->height != video->height)
+            return;
+        if(!queue->nominalChecked && video->mediaPlayer != nullptr) {
+            queue->nominalChecked = true;
+            queue->frameMs = frame_duration_ms(video->mediaPlayer);
+        }
+
+        // the oldest slot lua isn't holding on to
+        LuaVLC_FrcSlot* slot = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            for(int i = 0; i < FRC_SLOTS; i++) {
+                if(i == queue->pinned[0] || i == queue->pinned[1])
+                    continue;
+                if(slot == nullptr || queue->slots[i].serial < slot->serial)
+                    slot = &queue->slots[i];
+            }
+            if(slot->serial != 0 && !slot->shown)
+                queue->stats.skipped++;
+            slot->serial = 0;
+        }
+        size_t rowBytes = (size_t)queue->width * 4, pitch = video_pitch(video);
+        if(pitch == rowBytes) {
+            memcpy(slot->pixels, video->pixelBuffer, rowBytes * queue->height);
+        } else {
+            for(unsigned int row = 0; row < queue->height; row++)
+                memcpy(slot->pixels + row * rowBytes, video->pixelBuffer + row * pitch, rowBytes);
+        }
+
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        double pts = now;
+        if(queue->lastPts < 0.0) {
+            cut = true;
+        } else {
+            double gap = now - queue->lastPts;
+            if(queue->frameMs <= 0.0) {
+                if(gap > 0.0 && gap < 250.0)
+                    queue->frameMs = gap;
+            } else if(gap > queue->frameMs * 3.0) {
+                cut = true; // stalled, paused or buffering
+            } else {
+                // follows rate changes and streams whose real frame rate isn't the one in the header
+                if(gap > 0.0)
+                    queue->frameMs += (gap - queue->frameMs) * 0.05;
+                // keeps to the grid unless vlc is clearly somewhere else (dropped frames, early frames)
+                double predicted = queue->lastPts + queue->frameMs;
+                if(fabs(now - predicted) < queue->frameMs * 0.5)
+                    pts = predicted + (now - predicted) * 0.1;
+            }
+        }
+        if(pts <= queue->lastPts)
+            pts = queue->lastPts + 0.001;
+        slot->serial = queue->nextSerial++;
+        slot->pts = pts;
+        slot->cut = cut;
+        slot->shown = false;
+        slot->late = false;
+        queue->lastPts = pts;
+        queue->stats.frames++;
+        if(cut)
+            queue->stats.cuts++;
+    }
+
+    // lua's images to copy frames into, FRC_SLOTS of them at the size the video is showing frames at right now,
+    // or NULL to turn it off. turning it off waits for a copy that's still going, so the images can be freed after
+    EXPORT_DLL void luavlc_frc_configure(LuaVLC_Video* video, unsigned char** slots) {
+        if(video == NULL || video == nullptr)
+            return;
+        std::shared_ptr<LuaVLC_FrameQueue> old = std::atomic_load(&video->frameQueue);
+        std::shared_ptr<LuaVLC_FrameQueue> queue;
+        if(slots != NULL && slots != nullptr && video->width > 0 && video->height > 0) {
+            queue = std::make_shared<LuaVLC_FrameQueue>();
+            queue->width = video->width;
+            queue->height = video->height;
+            for(int i = 0; i < FRC_SLOTS; i++)
+                queue->slots[i].pixels = slots[i];
+        }
+        std::atomic_store(&video->frameQueue, queue);
+        if(old != nullptr) {
+            std::lock_guard<std::mutex> copyLock(old->copyMutex);
+            old->active = false;
+        }
+    }
+
+    static void frc_detach(LuaVLC_Video* video) {
+        luavlc_frc_configure(video, NULL);
+    }
+
+    // picks what to draw right now, returns false if there's no frame yet. with blend off it's the frame
+    // that's due, with it on the second frame gets mixed over the first by how close to it the time is
+    EXPORT_DLL bool luavlc_frc_pick(LuaVLC_Video* video, bool blend, LuaVLC_FrcPick* out) {
+        std::shared_ptr<LuaVLC_FrameQueue> queue = std::atomic_load(&video->frameQueue);
+        if(queue == nullptr)
+            return false;
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        double time = luavlc_now_ms() - queue->frameMs;
+        int a = -1, b = -1, oldest = -1;
+        for(int i = 0; i < FRC_SLOTS; i++) {
+            const LuaVLC_FrcSlot& slot = queue->slots[i];
+            if(slot.serial == 0)
+                continue;
+            if(slot.pts <= time && (a < 0 || slot.pts > queue->slots[a].pts))
+                a = i;
+            if(slot.pts > time && (b < 0 || slot.pts < queue->slots[b].pts))
+                b = i;
+            if(oldest < 0 || slot.pts < queue->slots[oldest].pts)
+                oldest = i;
+        }
+        if(oldest < 0)
+            return false;
+
+        float weight = 0.0f;
+        if(a < 0) {
+            // only frames that aren't due yet, right after it got turned on
+            a = oldest;
+            b = -1;
+        } else if(b < 0) {
+            LuaVLC_FrcSlot& slot = queue->slots[a];
+            if(time > slot.pts + queue->frameMs && !slot.late) {
+                slot.late = true;
+                queue->stats.underruns++;
+            }
+        } else {
+            const LuaVLC_FrcSlot &first = queue->slots[a], &second = queue->slots[b];
+            if(!second.cut) {
+                double t = (time - first.pts) / (second.pts - first.pts);
+                weight = blend ? (float)std::min(std::max(t, 0.0), 1.0) : 0.0f;
+                double error = (time - first.pts) - weight * (second.pts - first.pts);
+                queue->errorSum += error;
+                queue->errorSquares += error * error;
+                queue->errorCount++;
+            }
+        }
+        // less than a step of 8 bit color either way isn't worth the second texture
+        if(weight >= 254.5f / 255.0f) {
+            a = b;
+            weight = 0.0f;
+        }
+        if(weight < 0.5f / 255.0f)
+            b = -1;
+
+        out->first = a;
+        out->second = b;
+        out->weight = b >= 0 ? weight : 0.0f;
+        out->firstSerial = queue->slots[a].serial;
+        out->secondSerial = b >= 0 ? queue->slots[b].serial : 0;
+        queue->slots[a].shown = true;
+        if(b >= 0) {
+            queue->slots[b].shown = true;
+            queue->stats.blended++;
+            queue->weightSum += weight;
+        } else if(out->firstSerial == queue->shownFirst && queue->shownSecond == 0) {
+            queue->stats.repeats++;
+        }
+        queue->shownFirst = out->firstSerial;
+        queue->shownSecond = out->secondSerial;
+        queue->pinned[0] = a;
+        queue->pinned[1] = b;
+        queue->stats.presents++;
+        return true;
+    }
+
+    EXPORT_DLL bool luavlc_frc_stats(LuaVLC_Video* video, LuaVLC_FrcStats* out) {
+        std::shared_ptr<LuaVLC_FrameQueue> queue = std::atomic_load(&video->frameQueue);
+        if(queue == nullptr)
+            return false;
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        *out = queue->stats;
+        out->frameMs = queue->frameMs;
+        if(queue->errorCount > 1) {
+            double mean = queue->errorSum / queue->errorCount;
+            out->judderMs = sqrt(std::max(queue->errorSquares / queue->errorCount - mean * mean, 0.0));
+        }
+        out->blendWeight = queue->stats.blended > 0 ? queue->weightSum / queue->stats.blended : 0.0;
+        return true;
+    }
+
+    // interlace detection for the deinterlacing shader. vlc's own deinterlacer gets turned off, so frames come in with
+    // both fields woven together (even rows top field, odd rows bottom). libvlc doesn't tell us which frames are
+    // interlaced or which field comes first, so display_cb works it out from a sample of the rows of every frame
+    static const unsigned int FIELD_SAMPLE_ROWS = 4; // every 4th pair of rows
+    static const unsigned int FIELD_SAMPLE_COLUMNS = 4; // every 4th pixel of those
+    static const int FIELD_COMB_THRESHOLD = 15 * 15; // a row this much brighter or darker than both of its neighbours is combed
+    static const float FIELD_INTERLACED_FRACTION = 0.02f; // of combed samples for the frame to count as interlaced
+    static const int FIELD_HOLD_FRAMES = 60; // still frames don't comb, so it stays interlaced for this long after
+
+    typedef struct {
+        unsigned int frameSequence; // the frame this is about
+        float combing; // fraction of sampled pixels that looked combed
+        int interlaced; // combed, or was in the last FIELD_HOLD_FRAMES frames
+        int topFieldFirst;
+        float orderConfidence; // 0 (no idea, assumes top first) to 1
+        double frameMs; // measured time between frames, a field is half of it
+        double sinceFrameMs; // how long ago the frame came in
+    } LuaVLC_FieldInfo;
+
+    struct LuaVLC_FieldDetector {
+        std::mutex mutex;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        std::vector<unsigned char> previous; // luma of the sampled rows of the last frame, top then bottom row of each pair
+        bool primed = false;
+        int hold = 0;
+        double order = 0.0; // smoothed, above 0 is top field first
+        double lastMs = 0.0;
+        LuaVLC_FieldInfo info = {};
+    };
+
+    static inline int field_luma(const unsigned char* pixel) {
+        return (pixel[0] + pixel[1] * 2 + pixel[2]) >> 2;
+    }
+
+    // runs on vlc's thread right after a frame lands in the pixel buffer (and after frame cache steps)
+    static void fields_track(LuaVLC_Video* video) {
+        std::shared_ptr<LuaVLC_FieldDetector> detector = std::atomic_load(&video->fields);
+        if(detector == nullptr || video->pixelBuffer == nullptr)
+            return;
+        double now = luavlc_now_ms();
+        std::lock_guard<std::mutex> lock(detector->mutex);
+        if(detector->width != video->width || detector->height != video->height || detector->height < 3)
+            return;
+        size_t pitch = video_pitch(video);
+        unsigned int columns = (detector->width + FIELD_SAMPLE_COLUMNS - 1) / FIELD_SAMPLE_COLUMNS;
+        uint64_t samples = 0, combed = 0, toTop = 0, toBottom = 0;
+        unsigned char* previous = detector->previous.data();
+        // rows y - 1 and y + 1 are the top field, y is the bottom one
+        for(unsigned int y = 1; y + 1 < detector->height; y += FIELD_SAMPLE_ROWS * 2) {
+            const unsigned char* above = video->pixelBuffer + (y - 1) * pitch;
+            const unsigned char* row = video->pixelBuffer + y * pitch;
+            const unsigned char* below = video->pixelBuffer + (y + 1) * pitch;
+            for(unsigned int i = 0; i < columns; i++, previous += 2) {
+                size_t x = (size_t)i * FIELD_SAMPLE_COLUMNS * 4;
+                int a = field_luma(above + x), b = field_luma(row + x), c = field_luma(below + x);
+                if((a - b) * (c - b) > FIELD_COMB_THRESHOLD)
+                    combed++;
+                // the field that comes second is closer in time to the next frame's first field than the other way around
+                if(detector->primed) {
+                    toTop += abs(previous[1] - a);
+                    toBottom += abs(previous[0] - b);
+                }
+                previous[0] = (unsigned char)a;
+                previous[1] = (unsigned char)b;
+                samples++;
+            }
+        }
+        LuaVLC_FieldInfo& info = detector->info;
+        info.frameSequence = video->frameSequence.load(std::memory_order_acquire);
+        info.combing = samples > 0 ? (float)combed / samples : 0.0f;
+        if(info.combing >= FIELD_INTERLACED_FRACTION) {
+            detector->hold = FIELD_HOLD_FRAMES;
+            // only moving pictures say anything about the field order
+            if(toTop + toBottom > 0)
+                detector->order += (((double)toBottom - (double)toTop) / (double)(toTop + toBottom) - detector->order) * 0.1;
+        } else if(detector->hold > 0) {
+            detector->hold--;
+        }
+        info.interlaced = detector->hold > 0;
+        info.topFieldFirst = detector->order >= 0.0;
+        info.orderConfidence = (float)std::min(fabs(detector->order), 1.0);
+        double gap = now - detector->lastMs;
+        if(detector->primed && gap > 0.0 && gap < 250.0)
+            info.frameMs = info.frameMs > 0.0 ? info.frameMs + (gap - info.frameMs) * 0.1 : gap;
+        detector->lastMs = now;
+        detector->primed = true;
+    }
+
+    // turns detection on (or off) for the size the video is showing frames at right now
+    EXPORT_DLL void luavlc_fields_configure(LuaVLC_Video* video, bool enabled) {
+        if(video == NULL || video == nullptr)
+            return;
+        std::shared_ptr<LuaVLC_FieldDetector> detector;
+        if(enabled && video->width > 0 && video->height > 0) {
+            detector = std::make_shared<LuaVLC_FieldDetector>();
+            detector->width = video->width;
+            detector->height = video->height;
+            unsigned int pairs = (video->height - 2) / (FIELD_SAMPLE_ROWS * 2) + 1;
+            detector->previous.resize((size_t)pairs * ((video->width + FIELD_SAMPLE_COLUMNS - 1) / FIELD_SAMPLE_COLUMNS) * 2);
+        }
+        std::atomic_store(&video->fields, detector);
+    }
+
+    // what the detector made of the last frame, false when it's off
+    EXPORT_DLL bool luavlc_fields_info(LuaVLC_Video* video, LuaVLC_FieldInfo* out) {
+        std::shared_ptr<LuaVLC_FieldDetector> detector = std::atomic_load(&video->fields);
+        if(detector == nullptr)
+            return false;
+        std::lock_guard<std::mutex> lock(detector->mutex);
+        *out = detector->info;
+        out->sinceFrameMs = detector->primed ? luavlc_now_ms() - detector->lastMs : 0.0;
+        return true;
+    }
+
+    // libvlc_video_set_deinterlace is (mp, mode) on 3.0, where NULL turns it off, and (mp, state, mode) on 4.0.
+    // 3.0 can't go back to deciding by itself (state -1), so that turns it off there too
+    EXPORT_DLL void luavlc_video_set_deinterlace(libvlc_media_player_t* mp, int state, const char* mode) {
+        if(luavlc_vlc_major() < 4) {
+            typedef void (*set_deinterlace_v3)(libvlc_media_player_t*, const char*);
+            static set_deinterlace_v3 setDeinterlace = (set_deinterlace_v3)luavlc_vlc_symbol("libvlc_video_set_deinterlace");
+            if(setDeinterlace != NULL)
+                setDeinterlace(mp, state > 0 ? (mode != NULL ? mode : "blend") : NULL);
+        } else {
+            static auto setDeinterlace = (decltype(&libvlc_video_set_deinterlace))luavlc_vlc_symbol("libvlc_video_set_deinterlace");
+            if(setDeinterlace != NULL)
+                setDeinterlace(mp, state, mode);
+        }
     }
 }
\ No newline at end of file
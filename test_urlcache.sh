@@ -0,0 +1,29 @@
+#!/bin/sh
+# plays a video from a local stand-in http server (http_standin.py) thru the url cache twice, using
+# the driver in tests/urlcache. the first run has to leave a complete entry behind and the second has to come out of it
+# without asking the server for anything
+# usage: ./test_urlcache.sh path/to/short/video [port]
+export LOVEVLC_LIB_DIRECTORY="lib/linux"
+PORT="${2:-8765}"
+CACHE="$(mktemp -d)"
+LOG="$(mktemp)"
+python3 http_standin.py "$1" "$PORT" > "$LOG" &
+SERVER=$!
+trap 'kill $SERVER; rm -rf "$CACHE" "$LOG"' EXIT
+sleep 1
+
+URL="http://127.0.0.1:$PORT/video"
+love tests/urlcache "$URL" "$CACHE" 60 || exit 1
+FIRST=$(grep -c "^GET" "$LOG")
+if [ "$FIRST" -eq 0 ] || ! ls "$CACHE"/*.bin > /dev/null 2>&1; then
+    echo "FAIL: first run didn't leave a cached copy behind ($FIRST requests)"
+    exit 1
+fi
+
+love tests/urlcache "$URL" "$CACHE" 5 | tee /dev/stderr | grep -q "hits=[1-9]" || { echo "FAIL: second run missed the cache"; exit 1; }
+SECOND=$(grep -c "^GET" "$LOG")
+if [ "$SECOND" -ne "$FIRST" ]; then
+    echo "FAIL: second run still made $((SECOND - FIRST)) requests"
+    exit 1
+fi
+echo "OK: $FIRST requests, then none"
@@ -0,0 +1,9 @@
+function love.conf(t)
+    t.identity = "LoveVLCTest"
+    t.version = "12.0"
+
+    t.window.title = "LÖVE VLC url cache test"
+    t.window.width = 320
+    t.window.height = 180
+    t.window.vsync = false
+end
@@ -0,0 +1,56 @@
+-- driver for test_urlcache.sh, run it from the repository root:
+-- love tests/urlcache <url> <cache directory> [seconds]
+-- plays the url thru the url cache until it ends (or for that many seconds), prints the cache stats and quits
+
+-- the library is in the working directory (the repository root), outside of this game's own source
+package.path = "./?.lua;" .. package.path
+local lovevlc = require("init")
+_G.LOVEVLC_PARENT = ""
+
+local handle = require("util.handle")
+
+local url = nil
+local quitAfter = 10
+local video = nil --- @type love.Video
+local startedPlaying = false
+
+function love.load(gameArgs)
+    if not gameArgs[1] or not gameArgs[2] then
+        error("Usage: love tests/urlcache <url> <cache directory> [seconds]")
+    end
+    url = gameArgs[1]
+    lovevlc.setURLCache({directory = gameArgs[2]})
+    quitAfter = tonumber(gameArgs[3]) or quitAfter
+    handle.initasync()
+end
+
+function love.update(dt)
+    if not video then
+        if handle.instance then
+            video = love.graphics.newVideo(url, {audio = false})
+            video:play()
+        end
+        return
+    end
+    quitAfter = quitAfter - dt
+    local playing = video:isPlaying()
+    startedPlaying = startedPlaying or playing
+    if quitAfter <= 0 or (startedPlaying and not playing) then
+        local stats = lovevlc.getURLCacheStats()
+        print(("urlcache hits=%d misses=%d downloaded=%d files=%d"):format(stats.hits, stats.misses, stats.downloaded, stats.files))
+        love.event.quit()
+    end
+end
+
+function love.draw()
+    if video then
+        love.graphics.draw(video, 0, 0, 0, love.graphics.getWidth() / video:getWidth(), love.graphics.getHeight() / video:getHeight())
+    end
+end
+
+function love.quit()
+    if video then
+        video:release()
+    end
+    handle.quit()
+end
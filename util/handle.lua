@@ -9,9 +9,33 @@ handle.instance = nil
 --- Whether or not the VLC instance is currently loading
 handle.loading = false
 
---- Creates a new vlc instance without creating
---- a reference to it in this class, instead directly returning the instance
-function handle.create()
+--- How long the last `handle.create` call took, in milliseconds
+--- 
+--- `libraries` and `cdefs` come from requiring LoveVLC, `arguments` is building the
+--- argument list, `instance` is the time spent inside `libvlc_new` (the plugin bank)
+--- and `total` is the sum of everything above
+handle.timings = nil
+
+-- options which pick a single module, so an allow-list can end with "none"
+local MODULE_SELECTORS = {"demux", "codec", "access"}
+
+--- Builds the argument list passed to `libvlc_new`
+--- 
+--- `options.pluginCache` loads plugins straight from a prebuilt `plugins.dat`
+--- (made with `vlc-cache-gen` or `options.resetPluginCache`) instead of scanning the plugin folder
+--- 
+--- `options.modules` is an allow-list of modules, for example `{demux = {"mp4", "mkv"}, codec = {"avcodec"}}`,
+--- anything not listed won't be probed when opening media
+--- 
+--- `options.modules.videoFilters`/`options.modules.audioFilters` aren't allow-lists, they're filter chains
+--- forced onto every video (`--video-filter`) and every audio track (`--audio-filter`), leave them out for none
+--- 
+--- `options.args` are extra arguments appended as-is
+--- 
+--- @param options? table
+--- @return string[]
+function handle.getArguments(options)
+    options = options or {}
     local args = {
         "--ignore-config",
         "--drop-late-frames",
@@ -29,27 +53,95 @@ function handle.create()
         "--no-xlib",
         "--verbose=-1"
     }
+    if options.pluginCache then
+        table.insert(args, "--plugins-cache")
+        table.insert(args, "--no-plugins-scan")
+    end
+    if options.resetPluginCache then
+        table.insert(args, "--reset-plugins-cache")
+    end
+    local modules = options.modules
+    if modules then
+        for i = 1, #MODULE_SELECTORS do
+            local name = MODULE_SELECTORS[i]
+            if modules[name] and #modules[name] > 0 then
+                table.insert(args, "--" .. name .. "=" .. table.concat(modules[name], ",") .. ",none")
+            end
+        end
+        if modules.videoFilters and #modules.videoFilters > 0 then
+            table.insert(args, "--video-filter=" .. table.concat(modules.videoFilters, ":"))
+        end
+        if modules.audioFilters and #modules.audioFilters > 0 then
+            table.insert(args, "--audio-filter=" .. table.concat(modules.audioFilters, ":"))
+        end
+    end
+    if options.args then
+        for i = 1, #options.args do
+            table.insert(args, options.args[i])
+        end
+    end
+    return args
+end
+
+--- Creates a new vlc instance without creating
+--- a reference to it in this class, instead directly returning the instance
+--- 
+--- @param options? table See `handle.getArguments`
+--- @return table timings See `handle.timings`
+function handle.create(options)
+    local clock = love.timer and love.timer.getTime or os.clock
+    local start = clock()
+
+    local args = handle.getArguments(options)
     local argsPtr = ffi.new("const char *[?]", #args)
     for i = 1, #args do
         argsPtr[i - 1] = ffi.cast("const char *", args[i])
     end
-    libvlcWrapper.luavlc_init_vlc(#args, argsPtr)
+    local argsTime = (clock() - start) * 1000.0
+
+    local initTimings = ffi.new("LuaVLC_InitTimings")
+    libvlcWrapper.luavlc_init_vlc_timed(#args, argsPtr, initTimings)
+
+    local loadTimings = _G.LOVEVLC_LOAD_TIMINGS or {libraries = 0, cdefs = 0}
+    handle.timings = {
+        libraries = loadTimings.libraries,
+        cdefs = loadTimings.cdefs,
+        arguments = argsTime,
+        instance = initTimings.newMs,
+        total = loadTimings.libraries + loadTimings.cdefs + argsTime + initTimings.totalMs
+    }
+    return handle.timings
 end
 
 --- Creates a new vlc instance and creates
 --- a reference to it in this class (`handle.instance`)
-function handle.init()
+--- 
+--- @param options? table See `handle.getArguments`
+--- @return table timings See `handle.timings`
+function handle.init(options)
+    if rawget(handle, "instance") then
+        return handle.timings
+    end
+    -- an initasync that's still going gets waited for (and its instance used) by luavlc_init_vlc_timed
     handle.loading = true
     
-    handle.create()
+    local timings = handle.create(options)
     handle.instance = libvlcWrapper.luavlc_get_vlc_instance()
 
     handle.loading = false
+    return timings
 end
 
---- Creates a new vlc instance asynchronously
+--- Creates a new vlc instance asynchronously on a native thread
 --- and creates a reference to it in this class afterwards
-function handle.initasync()
+--- 
+--- `options.warmup` can be a path to a short clip, it gets played with no outputs
+--- once the instance exists so the demux/codec plugins it uses are already loaded
+--- 
+--- Check `handle.instance` (or call `handle.poll`) to know when it's done
+--- 
+--- @param options? table See `handle.getArguments`
+function handle.initasync(options)
     if handle.loading then
         print("VLC is already loading!")
         return
@@ -58,33 +150,72 @@ function handle.initasync()
         print("VLC is already initialized!")
         return
     end
+    options = options or {}
     handle.loading = true
-    local thread = love.thread.newThread([[
-        require("love.event")
-        local parent, libdir, plugindir, hp = ...
-        
-        _G.LOVEVLC_LIB_DIRECTORY = libdir
-        _G.LOVEVLC_PLUGIN_DIRECTORY = plugindir
-
-        require(parent)
-        _G.LOVEVLC_PARENT = parent
-
-        local handle = require(hp)
-        handle.create()
-        love.event.push("vlcinit")
-    ]])
-    love.handlers.vlcinit = function()
-        handle.instance = libvlcWrapper.luavlc_get_vlc_instance()
-        ffi.gc(handle.instance, nil)
+
+    local args = handle.getArguments(options)
+    local argsPtr = ffi.new("const char *[?]", #args)
+    for i = 1, #args do
+        argsPtr[i - 1] = ffi.cast("const char *", args[i])
+    end
+    if not libvlcWrapper.luavlc_init_vlc_async(#args, argsPtr, options.warmup) then
+        -- a sync init (or another initasync) got there first
+        handle.loading = false
+        print(libvlcWrapper.luavlc_vlc_state() == 1 and "VLC is already loading!" or "VLC is already initialized!")
     end
-    thread:start(_G.LOVEVLC_PARENT, _G.LOVEVLC_LIB_DIRECTORY, _G.LOVEVLC_PLUGIN_DIRECTORY, (_G.LOVEVLC_PARENT and (_G.LOVEVLC_PARENT .. ".") or "") .. "util.handle")
+end
+
+--- Checks whether or not an asynchronous `handle.initasync` call has finished,
+--- this is cheap enough to call every frame
+--- 
+--- Reading `handle.instance` while VLC is loading calls this for you
+--- 
+--- @return boolean
+function handle.poll()
+    if not rawget(handle, "loading") then
+        return rawget(handle, "instance") ~= nil
+    end
+    local state = libvlcWrapper.luavlc_vlc_state()
+    if state == 2 or state == -1 then
+        handle.loading = false
+
+        local initTimings = ffi.new("LuaVLC_InitTimings")
+        libvlcWrapper.luavlc_get_init_timings(initTimings)
+
+        local loadTimings = _G.LOVEVLC_LOAD_TIMINGS or {libraries = 0, cdefs = 0}
+        handle.timings = {
+            libraries = loadTimings.libraries,
+            cdefs = loadTimings.cdefs,
+            arguments = 0,
+            instance = initTimings.newMs,
+            warmup = initTimings.warmupMs,
+            total = loadTimings.libraries + loadTimings.cdefs + initTimings.totalMs
+        }
+        if state == 2 then
+            handle.instance = libvlcWrapper.luavlc_get_vlc_instance()
+        else
+            print("VLC failed to initialize!")
+        end
+    end
+    return rawget(handle, "instance") ~= nil
 end
 
 function handle.quit()
     if not handle.instance then
         return
     end
-    libvlc.libvlc_release(handle.instance)
+    libvlcWrapper.luavlc_free_vlc()
+    handle.instance = nil
 end
 
+-- lets `handle.instance` be polled while vlc is loading asynchronously
+setmetatable(handle, {
+    __index = function(t, k)
+        if k == "instance" and rawget(t, "loading") then
+            t.poll()
+            return rawget(t, "instance")
+        end
+    end
+})
+
 return handle
\ No newline at end of file